@@ -2,20 +2,13 @@
 #include <stdbool.h>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
+#include "sudoku_output.h"
+#include "sudoku_stats.h"
 
 #define N 25  
 #define SUBGRID 5  
 
-// Pritn the grid
-void printGrid(int grid[N][N]) {
-    for (int row = 0; row < N; row++) {
-        for (int col = 0; col < N; col++) {
-            printf("%d ", grid[row][col]);
-        }
-        printf("\n");
-    }
-}
-
 // Check if a number is valid in a given cell
 bool isValid(int grid[N][N], int row, int col, int num) {
     for (int i = 0; i < N; i++) {
@@ -31,8 +24,10 @@ bool isValid(int grid[N][N], int row, int col, int num) {
     return true;
 }
 
-// Brute-force function that systematically fills empty cells
-bool bruteForceSolve(int grid[N][N]) {
+// Brute-force function that systematically fills empty cells.
+// depth is the number of placements above this call.
+bool bruteForceSolve(int grid[N][N], int depth) {
+    STATS_NODE(depth);
     int row, col;
     bool isEmpty = false;
 
@@ -48,17 +43,22 @@ bool bruteForceSolve(int grid[N][N]) {
     }
 
     // If no empty cells are left, the Sudoku is solved
-    if (!isEmpty) return true;
+    if (!isEmpty) {
+        STATS_SOLUTION();
+        return true;
+    }
 
     // Try numbers from 1-N in order
     for (int num = 1; num <= N; num++) {
+        STATS_CHECK();
         if (isValid(grid, row, col, num)) {
             grid[row][col] = num;
 
-            if (bruteForceSolve(grid)) return true; // Recursively continue
+            if (bruteForceSolve(grid, depth + 1)) return true; // Recursively continue
 
             // If placing num didn't lead to a solution, reset and try next
             grid[row][col] = 0;
+            STATS_BACKTRACK();
         }
     }
 
@@ -66,7 +66,15 @@ bool bruteForceSolve(int grid[N][N]) {
 }
 
 // Driver function
-int main() {
+int main(int argc, char *argv[]) {
+    output_options_t options = {0};
+    for (int i = 1; i < argc; i++) {
+        if (!output_parse_option(&options, argv[i])) {
+            fprintf(stderr, "Usage: %s " OUTPUT_USAGE "\n", argv[0]);
+            return 1;
+        }
+    }
+
 int grid[N][N] = {
 
     {0, 2, 3, 4, 5, 6, 7, 8, 0, 10, 11, 0, 13, 14, 15, 16, 0, 18, 19, 20, 21, 22, 23, 0, 25},
@@ -99,21 +107,28 @@ int grid[N][N] = {
 
 
 
-    printf("Original 25x25 Sudoku Puzzle:\n");
-    printGrid(grid);
+    int puzzle[N][N];
+    memcpy(puzzle, grid, sizeof(puzzle));
+    output_grid(&options, "Original 25x25 Sudoku Puzzle:", &grid[0][0], N);
 
     clock_t start = clock();
+    STATS_START();
 
-    if (bruteForceSolve(grid)) {
+    int status = 0;
+    if (bruteForceSolve(grid, 0)) {
         clock_t end = clock();
         double time_taken = ((double)(end - start)) / CLOCKS_PER_SEC * 1000;
-        printf("\nSolved 25x25 Sudoku:\n");
-        printGrid(grid);
+        if (!options.quiet)
+            printf("\n");
+        if (!output_solution(&options, "Solved 25x25 Sudoku:", &puzzle[0][0], &grid[0][0], N, SUBGRID))
+            return 1;
         printf("\nTime taken: %.3f milliseconds\n", time_taken);
     } else {
         printf("\nNo solution exists.\n");
+        status = 1;
     }
+    STATS_PRINT("brute force");
 
-    return 0;
+    return status;
 }
 
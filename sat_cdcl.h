@@ -0,0 +1,942 @@
+#ifndef SAT_CDCL_H
+#define SAT_CDCL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sudoku_stats.h"
+
+// In-process CDCL SAT solver with an IPASIR-style incremental interface.
+//
+// The solver is a small MiniSat-style design: two watched literals with
+// blockers, VSIDS branching with phase saving, first-UIP learning with local
+// minimisation, Luby restarts and LBD-based learnt clause reduction.
+//
+// Incremental use follows IPASIR: clauses are added literal by literal with
+// ipasir_add (0 ends a clause), literals passed to ipasir_assume hold only
+// for the next ipasir_solve call, and everything learnt stays in the solver
+// between calls. The Sudoku solvers load the structural CNF once and pass the
+// givens as assumptions, so later solves start from what was learnt before.
+//
+// A few extensions beyond IPASIR support parallel use: satConfigure picks the
+// seed, restart policy and initial polarity, and satSetImport lets a solver
+// pull in clauses that other instances exported through ipasir_set_learn.
+//
+// With -DSOLVER_STATS the search also feeds sudoku_stats.h: decisions count
+// as nodes at their decision level, conflicts as backtracks, and every
+// literal taken off the trail as a propagation.
+
+typedef struct {
+    int size;
+    int lbd;
+    float activity;
+    unsigned learnt : 1;
+    unsigned deleted : 1;
+    int lits[];
+} sat_clause_t;
+
+typedef enum { SAT_RESTART_LUBY, SAT_RESTART_GLUCOSE } sat_restart_t;
+typedef enum { SAT_PHASE_FALSE, SAT_PHASE_TRUE, SAT_PHASE_RANDOM } sat_phase_t;
+
+// Search settings. Portfolio workers (sat_portfolio.h) differ in these so
+// they explore different parts of the search on the same formula.
+typedef struct {
+    unsigned long long seed; // 0 keeps the deterministic variable order
+    sat_restart_t restarts;  // Luby sequence, or Glucose-style on LBD averages
+    sat_phase_t phase;       // initial polarity, phase saving takes over later
+} sat_config_t;
+
+typedef struct {
+    sat_clause_t *clause;
+    int blocker; // some other literal of the clause; if true the clause is skipped
+} sat_watch_t;
+
+typedef struct {
+    sat_watch_t *data;
+    int size;
+    int cap;
+} sat_watch_list_t;
+
+typedef struct {
+    int num_vars;
+    int cap_vars;
+
+    // Per variable, indexed 1..num_vars
+    signed char *value; // 1 true, -1 false, 0 unassigned
+    int *level;
+    sat_clause_t **reason;
+    double *activity;
+    signed char *phase;  // saved polarity
+    signed char *seen;
+    signed char *model;  // assignment of the last satisfiable solve
+    signed char *failed; // assumptions in the last final conflict, 1 positive, 2 negative
+    int *heap;           // VSIDS order, max-heap on activity
+    int *heap_pos;       // -1 if not in the heap
+    int heap_size;
+    int *level_stamp;    // scratch for LBD computation
+
+    // Per literal, indexed by satLitIndex
+    sat_watch_list_t *watches;
+
+    int *trail;
+    int trail_size;
+    int *trail_lim;
+    int num_levels;
+    int qhead;
+
+    sat_clause_t **clauses;
+    int num_clauses;
+    int cap_clauses;
+    sat_clause_t **learnts;
+    int num_learnts;
+    int cap_learnts;
+
+    int *adding; // clause being built by ipasir_add
+    int adding_size;
+    int adding_cap;
+    int *assumptions;
+    int num_assumptions;
+    int cap_assumptions;
+    int *learnt_buf; // scratch for analyze
+    int stamp;
+
+    int ok; // 0 once the clause set itself is unsatisfiable
+    sat_config_t config;
+    unsigned long long rng;
+    double lbd_fast; // moving averages of learnt clause LBD for restarts
+    double lbd_slow;
+    double var_inc;
+    double clause_inc;
+    long next_reduce;
+    int num_reduces;
+    int simp_trail; // level-0 trail size at the last satSimplify
+
+    long conflicts;
+    long decisions;
+    long propagations;
+
+    int (*terminate)(void *data);
+    void *terminate_data;
+    void (*learn)(void *data, int *clause); // sees learnt clauses up to learn_max
+    void *learn_data;
+    int learn_max;
+    int *learn_clause;
+    const int *(*import)(void *data, int *size); // clauses from other solvers
+    void *import_data;
+} sat_solver_t;
+
+#define SAT_VAR_DECAY 0.95
+#define SAT_CLAUSE_DECAY 0.999
+#define SAT_RESTART_FIRST 100
+#define SAT_REDUCE_FIRST 2000
+#define SAT_REDUCE_INC 300
+#define SAT_GLUCOSE_MIN_CONFLICTS 50
+#define SAT_GLUCOSE_K 0.8
+
+static inline int satLitIndex(int lit) {
+    return lit > 0 ? 2 * lit : -2 * lit + 1;
+}
+
+static inline int satLitValue(const sat_solver_t *s, int lit) {
+    int v = s->value[lit > 0 ? lit : -lit];
+    return lit > 0 ? v : -v;
+}
+
+// xorshift64*, only used when a seed is configured
+static inline unsigned long long satRandom(sat_solver_t *s) {
+    s->rng ^= s->rng >> 12;
+    s->rng ^= s->rng << 25;
+    s->rng ^= s->rng >> 27;
+    return s->rng * 0x2545F4914F6CDD1DULL;
+}
+
+static inline void *satRealloc(void *p, size_t size) {
+    p = realloc(p, size);
+    if (!p) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    return p;
+}
+
+// ---------------------------------------------------------------------------
+// VSIDS heap
+
+static inline void satHeapUp(sat_solver_t *s, int i) {
+    int v = s->heap[i];
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (s->activity[s->heap[parent]] >= s->activity[v])
+            break;
+        s->heap[i] = s->heap[parent];
+        s->heap_pos[s->heap[i]] = i;
+        i = parent;
+    }
+    s->heap[i] = v;
+    s->heap_pos[v] = i;
+}
+
+static inline void satHeapDown(sat_solver_t *s, int i) {
+    int v = s->heap[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= s->heap_size)
+            break;
+        if (child + 1 < s->heap_size && s->activity[s->heap[child + 1]] > s->activity[s->heap[child]])
+            child++;
+        if (s->activity[s->heap[child]] <= s->activity[v])
+            break;
+        s->heap[i] = s->heap[child];
+        s->heap_pos[s->heap[i]] = i;
+        i = child;
+    }
+    s->heap[i] = v;
+    s->heap_pos[v] = i;
+}
+
+static inline void satHeapInsert(sat_solver_t *s, int v) {
+    if (s->heap_pos[v] >= 0)
+        return;
+    s->heap[s->heap_size] = v;
+    s->heap_pos[v] = s->heap_size++;
+    satHeapUp(s, s->heap_pos[v]);
+}
+
+static inline int satHeapPop(sat_solver_t *s) {
+    int v = s->heap[0];
+    s->heap_pos[v] = -1;
+    if (--s->heap_size > 0) {
+        s->heap[0] = s->heap[s->heap_size];
+        s->heap_pos[s->heap[0]] = 0;
+        satHeapDown(s, 0);
+    }
+    return v;
+}
+
+static inline void satBumpVar(sat_solver_t *s, int v) {
+    if ((s->activity[v] += s->var_inc) > 1e100) {
+        for (int i = 1; i <= s->num_vars; i++)
+            s->activity[i] *= 1e-100;
+        s->var_inc *= 1e-100;
+    }
+    if (s->heap_pos[v] >= 0)
+        satHeapUp(s, s->heap_pos[v]);
+}
+
+static inline void satBumpClause(sat_solver_t *s, sat_clause_t *c) {
+    if ((c->activity += s->clause_inc) > 1e20) {
+        for (int i = 0; i < s->num_learnts; i++)
+            s->learnts[i]->activity *= 1e-20;
+        s->clause_inc *= 1e-20;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Variables, clauses and the trail
+
+static inline void satEnsureVars(sat_solver_t *s, int v) {
+    if (v <= s->num_vars)
+        return;
+    if (v > s->cap_vars) {
+        int cap = s->cap_vars ? s->cap_vars : 64;
+        while (cap < v)
+            cap *= 2;
+        size_t n = cap + 1;
+        size_t old_lits = s->cap_vars ? 2 * (s->cap_vars + 1) : 0;
+        s->value = satRealloc(s->value, n);
+        s->level = satRealloc(s->level, n * sizeof(int));
+        s->reason = satRealloc(s->reason, n * sizeof(sat_clause_t *));
+        s->activity = satRealloc(s->activity, n * sizeof(double));
+        s->phase = satRealloc(s->phase, n);
+        s->seen = satRealloc(s->seen, n);
+        s->model = satRealloc(s->model, n);
+        s->failed = satRealloc(s->failed, n);
+        s->heap = satRealloc(s->heap, n * sizeof(int));
+        s->heap_pos = satRealloc(s->heap_pos, n * sizeof(int));
+        s->level_stamp = satRealloc(s->level_stamp, n * sizeof(int));
+        s->trail = satRealloc(s->trail, n * sizeof(int));
+        s->trail_lim = satRealloc(s->trail_lim, n * sizeof(int));
+        s->learnt_buf = satRealloc(s->learnt_buf, n * sizeof(int));
+        s->watches = satRealloc(s->watches, 2 * n * sizeof(sat_watch_list_t));
+        memset(&s->watches[old_lits], 0, (2 * n - old_lits) * sizeof(sat_watch_list_t));
+        s->cap_vars = cap;
+    }
+    for (int i = s->num_vars + 1; i <= v; i++) {
+        s->value[i] = 0;
+        s->level[i] = 0;
+        s->reason[i] = NULL;
+        s->activity[i] = s->config.seed ? (satRandom(s) % 1024) * 1e-6 : 0;
+        if (s->config.phase == SAT_PHASE_RANDOM)
+            s->phase[i] = satRandom(s) & 1 ? 1 : -1;
+        else
+            s->phase[i] = s->config.phase == SAT_PHASE_TRUE ? 1 : -1;
+        s->seen[i] = 0;
+        s->model[i] = 0;
+        s->failed[i] = 0;
+        s->heap_pos[i] = -1;
+        s->level_stamp[i] = 0;
+        satHeapInsert(s, i);
+    }
+    s->num_vars = v;
+}
+
+static inline void satWatch(sat_solver_t *s, int lit, sat_clause_t *c, int blocker) {
+    sat_watch_list_t *ws = &s->watches[satLitIndex(lit)];
+    if (ws->size == ws->cap) {
+        ws->cap = ws->cap ? 2 * ws->cap : 4;
+        ws->data = satRealloc(ws->data, ws->cap * sizeof(sat_watch_t));
+    }
+    ws->data[ws->size].clause = c;
+    ws->data[ws->size].blocker = blocker;
+    ws->size++;
+}
+
+static inline sat_clause_t *satNewClause(sat_solver_t *s, const int *lits, int size, int learnt) {
+    sat_clause_t *c = malloc(sizeof(sat_clause_t) + size * sizeof(int));
+    if (!c) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    c->size = size;
+    c->lbd = 0;
+    c->activity = 0;
+    c->learnt = learnt;
+    c->deleted = 0;
+    memcpy(c->lits, lits, size * sizeof(int));
+
+    sat_clause_t ***list = learnt ? &s->learnts : &s->clauses;
+    int *count = learnt ? &s->num_learnts : &s->num_clauses;
+    int *cap = learnt ? &s->cap_learnts : &s->cap_clauses;
+    if (*count == *cap) {
+        *cap = *cap ? 2 * *cap : 1024;
+        *list = satRealloc(*list, *cap * sizeof(sat_clause_t *));
+    }
+    (*list)[(*count)++] = c;
+
+    satWatch(s, c->lits[0], c, c->lits[1]);
+    satWatch(s, c->lits[1], c, c->lits[0]);
+    return c;
+}
+
+static inline void satAssign(sat_solver_t *s, int lit, sat_clause_t *reason) {
+    int v = lit > 0 ? lit : -lit;
+    s->value[v] = lit > 0 ? 1 : -1;
+    s->level[v] = s->num_levels;
+    s->reason[v] = reason;
+    s->trail[s->trail_size++] = lit;
+}
+
+static inline void satNewLevel(sat_solver_t *s) {
+    s->trail_lim[s->num_levels++] = s->trail_size;
+}
+
+static inline void satCancelUntil(sat_solver_t *s, int level) {
+    if (s->num_levels <= level)
+        return;
+    for (int i = s->trail_size - 1; i >= s->trail_lim[level]; i--) {
+        int v = s->trail[i] > 0 ? s->trail[i] : -s->trail[i];
+        s->phase[v] = s->value[v];
+        s->value[v] = 0;
+        s->reason[v] = NULL;
+        satHeapInsert(s, v);
+    }
+    s->trail_size = s->trail_lim[level];
+    s->qhead = s->trail_size;
+    s->num_levels = level;
+}
+
+// Unit propagation over the watched literals. Returns the conflicting
+// clause, or NULL if everything propagated.
+static inline sat_clause_t *satPropagate(sat_solver_t *s) {
+    while (s->qhead < s->trail_size) {
+        int false_lit = -s->trail[s->qhead++];
+        sat_watch_list_t *ws = &s->watches[satLitIndex(false_lit)];
+        int i = 0, j = 0;
+        s->propagations++;
+        STATS_PROPAGATION();
+
+        while (i < ws->size) {
+            sat_watch_t w = ws->data[i];
+            if (satLitValue(s, w.blocker) == 1) {
+                ws->data[j++] = ws->data[i++];
+                continue;
+            }
+
+            // Keep the false literal in position 1
+            sat_clause_t *c = w.clause;
+            if (c->lits[0] == false_lit) {
+                c->lits[0] = c->lits[1];
+                c->lits[1] = false_lit;
+            }
+            i++;
+
+            int first = c->lits[0];
+            if (first != w.blocker && satLitValue(s, first) == 1) {
+                ws->data[j].clause = c;
+                ws->data[j++].blocker = first;
+                continue;
+            }
+
+            // Look for a new literal to watch
+            int found = 0;
+            for (int k = 2; k < c->size; k++) {
+                if (satLitValue(s, c->lits[k]) != -1) {
+                    c->lits[1] = c->lits[k];
+                    c->lits[k] = false_lit;
+                    satWatch(s, c->lits[1], c, first);
+                    found = 1;
+                    break;
+                }
+            }
+            if (found)
+                continue;
+
+            // Unit or conflicting
+            ws->data[j].clause = c;
+            ws->data[j++].blocker = first;
+            if (satLitValue(s, first) == -1) {
+                while (i < ws->size)
+                    ws->data[j++] = ws->data[i++];
+                ws->size = j;
+                s->qhead = s->trail_size;
+                return c;
+            }
+            satAssign(s, first, c);
+        }
+        ws->size = j;
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Conflict analysis
+
+static inline int satComputeLbd(sat_solver_t *s, const int *lits, int size) {
+    int lbd = 0;
+    s->stamp++;
+    for (int i = 0; i < size; i++) {
+        int l = s->level[lits[i] > 0 ? lits[i] : -lits[i]];
+        if (s->level_stamp[l] != s->stamp) {
+            s->level_stamp[l] = s->stamp;
+            lbd++;
+        }
+    }
+    return lbd;
+}
+
+// First-UIP learning. Fills s->learnt_buf with the asserting literal first
+// and the literal of the backjump level second; returns the clause size.
+static inline int satAnalyze(sat_solver_t *s, sat_clause_t *confl, int *bt_level) {
+    int *learnt = s->learnt_buf;
+    int size = 1, path = 0, p = 0;
+    int index = s->trail_size - 1;
+
+    do {
+        if (confl->learnt)
+            satBumpClause(s, confl);
+        for (int j = p == 0 ? 0 : 1; j < confl->size; j++) {
+            int q = confl->lits[j];
+            int v = q > 0 ? q : -q;
+            if (!s->seen[v] && s->level[v] > 0) {
+                satBumpVar(s, v);
+                s->seen[v] = 1;
+                if (s->level[v] >= s->num_levels)
+                    path++;
+                else
+                    learnt[size++] = q;
+            }
+        }
+        while (!s->seen[s->trail[index] > 0 ? s->trail[index] : -s->trail[index]])
+            index--;
+        p = s->trail[index--];
+        confl = s->reason[p > 0 ? p : -p];
+        s->seen[p > 0 ? p : -p] = 0;
+        path--;
+    } while (path > 0);
+    learnt[0] = -p;
+
+    // Drop literals implied by the rest of the clause. Redundant literals are
+    // marked 2 first and only removed afterwards, so seen is cleared for all.
+    for (int i = 1; i < size; i++) {
+        int v = learnt[i] > 0 ? learnt[i] : -learnt[i];
+        sat_clause_t *r = s->reason[v];
+        int redundant = r != NULL;
+        for (int k = 1; r && k < r->size && redundant; k++) {
+            int u = r->lits[k] > 0 ? r->lits[k] : -r->lits[k];
+            if (!s->seen[u] && s->level[u] > 0)
+                redundant = 0;
+        }
+        if (redundant)
+            s->seen[v] = 2;
+    }
+    int kept = 1;
+    for (int i = 1; i < size; i++) {
+        int v = learnt[i] > 0 ? learnt[i] : -learnt[i];
+        if (s->seen[v] == 1)
+            learnt[kept++] = learnt[i];
+        s->seen[v] = 0;
+    }
+    size = kept;
+
+    // Put the highest remaining level in position 1
+    *bt_level = 0;
+    for (int i = 1; i < size; i++) {
+        int l = s->level[learnt[i] > 0 ? learnt[i] : -learnt[i]];
+        if (l > *bt_level) {
+            *bt_level = l;
+            int tmp = learnt[1];
+            learnt[1] = learnt[i];
+            learnt[i] = tmp;
+        }
+    }
+    return size;
+}
+
+// Collect the assumptions responsible for assumption p being false
+static inline void satAnalyzeFinal(sat_solver_t *s, int p) {
+    int v = p > 0 ? p : -p;
+    memset(s->failed, 0, s->num_vars + 1);
+    s->failed[v] = p > 0 ? 1 : 2;
+    if (s->num_levels == 0)
+        return;
+
+    s->seen[v] = 1;
+    for (int i = s->trail_size - 1; i >= s->trail_lim[0]; i--) {
+        int x = s->trail[i] > 0 ? s->trail[i] : -s->trail[i];
+        if (!s->seen[x])
+            continue;
+        sat_clause_t *r = s->reason[x];
+        if (r == NULL) {
+            s->failed[x] |= s->trail[i] > 0 ? 1 : 2;
+        } else {
+            for (int k = 1; k < r->size; k++) {
+                int u = r->lits[k] > 0 ? r->lits[k] : -r->lits[k];
+                if (s->level[u] > 0)
+                    s->seen[u] = 1;
+            }
+        }
+        s->seen[x] = 0;
+    }
+    s->seen[v] = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Clause database
+
+static inline int satClauseLocked(const sat_solver_t *s, const sat_clause_t *c) {
+    int v = c->lits[0] > 0 ? c->lits[0] : -c->lits[0];
+    return s->reason[v] == c && satLitValue(s, c->lits[0]) == 1;
+}
+
+static inline int satCompareLearnts(const void *a, const void *b) {
+    const sat_clause_t *x = *(sat_clause_t *const *)a, *y = *(sat_clause_t *const *)b;
+    if (x->lbd != y->lbd)
+        return x->lbd < y->lbd ? -1 : 1;
+    return x->activity > y->activity ? -1 : x->activity < y->activity;
+}
+
+// Drop the watches of every clause marked deleted
+static inline void satDetachDeleted(sat_solver_t *s) {
+    for (int l = 2; l < 2 * (s->num_vars + 1); l++) {
+        sat_watch_list_t *ws = &s->watches[l];
+        int j = 0;
+        for (int i = 0; i < ws->size; i++) {
+            if (!ws->data[i].clause->deleted)
+                ws->data[j++] = ws->data[i];
+        }
+        ws->size = j;
+    }
+}
+
+// Free the clauses marked deleted and compact the list. Their watches must
+// already be gone.
+static inline void satFreeDeleted(sat_clause_t **list, int *count) {
+    int kept = 0;
+    for (int i = 0; i < *count; i++) {
+        if (list[i]->deleted)
+            free(list[i]);
+        else
+            list[kept++] = list[i];
+    }
+    *count = kept;
+}
+
+// Delete the worse half of the learnt clauses, keeping glue clauses
+// (LBD <= 2) and clauses that are currently reasons
+static inline void satReduceDb(sat_solver_t *s) {
+    qsort(s->learnts, s->num_learnts, sizeof(sat_clause_t *), satCompareLearnts);
+    for (int i = s->num_learnts / 2; i < s->num_learnts; i++) {
+        sat_clause_t *c = s->learnts[i];
+        if (c->lbd > 2 && !satClauseLocked(s, c))
+            c->deleted = 1;
+    }
+
+    satDetachDeleted(s);
+    satFreeDeleted(s->learnts, &s->num_learnts);
+    s->num_reduces++;
+    s->next_reduce = s->conflicts + SAT_REDUCE_FIRST + (long)SAT_REDUCE_INC * s->num_reduces;
+}
+
+static inline int satClauseSatisfied(const sat_solver_t *s, const sat_clause_t *c) {
+    for (int i = 0; i < c->size; i++) {
+        if (satLitValue(s, c->lits[i]) == 1)
+            return 1;
+    }
+    return 0;
+}
+
+// Delete every clause satisfied at decision level 0, original or learnt.
+// satAddClause only drops such clauses on insertion, so without this the
+// clauses retired by a later unit (e.g. activation literals of incremental
+// callers) would stay watched forever. Level-0 literals never need a reason
+// again, so their reasons are cleared before the clauses are freed.
+static inline void satSimplify(sat_solver_t *s) {
+    if (!s->ok || s->num_levels > 0 || s->trail_size == s->simp_trail)
+        return;
+    if (satPropagate(s)) {
+        s->ok = 0;
+        return;
+    }
+
+    for (int i = 0; i < s->trail_size; i++) {
+        int v = s->trail[i] > 0 ? s->trail[i] : -s->trail[i];
+        s->reason[v] = NULL;
+    }
+    for (int i = 0; i < s->num_clauses; i++)
+        s->clauses[i]->deleted = satClauseSatisfied(s, s->clauses[i]);
+    for (int i = 0; i < s->num_learnts; i++)
+        s->learnts[i]->deleted = satClauseSatisfied(s, s->learnts[i]);
+
+    satDetachDeleted(s);
+    satFreeDeleted(s->clauses, &s->num_clauses);
+    satFreeDeleted(s->learnts, &s->num_learnts);
+    s->simp_trail = s->trail_size;
+}
+
+// ---------------------------------------------------------------------------
+// Search
+
+static inline double satLuby(double y, int x) {
+    int size = 1, seq = 0;
+    while (size < x + 1) {
+        seq++;
+        size = 2 * size + 1;
+    }
+    while (size - 1 != x) {
+        size = (size - 1) >> 1;
+        seq--;
+        x = x % size;
+    }
+    double r = 1;
+    while (seq-- > 0)
+        r *= y;
+    return r;
+}
+
+static inline int satPickBranch(sat_solver_t *s) {
+    while (s->heap_size > 0) {
+        int v = satHeapPop(s);
+        if (s->value[v] == 0)
+            return s->phase[v] > 0 ? v : -v;
+    }
+    return 0;
+}
+
+// Luby restarts after max_conflicts; Glucose restarts once the recent
+// learnt clauses are clearly worse than the average so far
+static inline int satRestartDue(const sat_solver_t *s, long conflicts, long max_conflicts) {
+    if (s->config.restarts == SAT_RESTART_GLUCOSE)
+        return conflicts >= SAT_GLUCOSE_MIN_CONFLICTS && s->lbd_fast * SAT_GLUCOSE_K > s->lbd_slow;
+    return max_conflicts >= 0 && conflicts >= max_conflicts;
+}
+
+static inline void satUpdateLbd(sat_solver_t *s, int lbd) {
+    if (s->conflicts == 1) {
+        s->lbd_fast = lbd;
+        s->lbd_slow = lbd;
+    }
+    s->lbd_fast += (lbd - s->lbd_fast) / 32;
+    s->lbd_slow += (lbd - s->lbd_slow) / 4096;
+}
+
+// Search until a model, a proof of unsatisfiability (under the current
+// assumptions) or a restart. Returns 10, 20 or 0.
+static inline int satSearch(sat_solver_t *s, long max_conflicts) {
+    long conflicts = 0;
+
+    for (;;) {
+        sat_clause_t *confl = satPropagate(s);
+        if (confl) {
+            s->conflicts++;
+            conflicts++;
+            STATS_BACKTRACK();
+            if (s->num_levels == 0) {
+                s->ok = 0;
+                return 20;
+            }
+
+            int bt_level;
+            int size = satAnalyze(s, confl, &bt_level);
+            satCancelUntil(s, bt_level);
+            if (s->learn && size <= s->learn_max) {
+                memcpy(s->learn_clause, s->learnt_buf, size * sizeof(int));
+                s->learn_clause[size] = 0;
+                s->learn(s->learn_data, s->learn_clause);
+            }
+            if (size == 1) {
+                satAssign(s, s->learnt_buf[0], NULL);
+                satUpdateLbd(s, 1);
+            } else {
+                sat_clause_t *c = satNewClause(s, s->learnt_buf, size, 1);
+                c->lbd = satComputeLbd(s, c->lits, size);
+                satBumpClause(s, c);
+                satAssign(s, c->lits[0], c);
+                satUpdateLbd(s, c->lbd);
+            }
+            s->var_inc /= SAT_VAR_DECAY;
+            s->clause_inc /= SAT_CLAUSE_DECAY;
+            continue;
+        }
+
+        if (satRestartDue(s, conflicts, max_conflicts) ||
+            (s->terminate && s->terminate(s->terminate_data))) {
+            satCancelUntil(s, 0);
+            return 0;
+        }
+        if (s->conflicts >= s->next_reduce)
+            satReduceDb(s);
+
+        // Assumptions occupy the first decision levels
+        int next = 0;
+        while (s->num_levels < s->num_assumptions) {
+            int p = s->assumptions[s->num_levels];
+            if (satLitValue(s, p) == 1) {
+                satNewLevel(s);
+            } else if (satLitValue(s, p) == -1) {
+                satAnalyzeFinal(s, p);
+                return 20;
+            } else {
+                next = p;
+                break;
+            }
+        }
+        if (next == 0) {
+            s->decisions++;
+            next = satPickBranch(s);
+            if (next == 0) {
+                STATS_SOLUTION();
+                return 10;
+            }
+            STATS_NODE(s->num_levels + 1);
+        }
+        satNewLevel(s);
+        satAssign(s, next, NULL);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// IPASIR interface
+
+static inline const char *ipasir_signature(void) {
+    return "sudoku-cdcl";
+}
+
+static inline void *ipasir_init(void) {
+    sat_solver_t *s = calloc(1, sizeof(sat_solver_t));
+    if (!s) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    s->ok = 1;
+    s->var_inc = 1;
+    s->clause_inc = 1;
+    s->next_reduce = SAT_REDUCE_FIRST;
+    return s;
+}
+
+static inline void ipasir_release(void *solver) {
+    sat_solver_t *s = solver;
+    for (int i = 0; i < s->num_clauses; i++)
+        free(s->clauses[i]);
+    for (int i = 0; i < s->num_learnts; i++)
+        free(s->learnts[i]);
+    for (int l = 0; s->watches && l < 2 * (s->cap_vars + 1); l++)
+        free(s->watches[l].data);
+    free(s->clauses);
+    free(s->learnts);
+    free(s->watches);
+    free(s->value);
+    free(s->level);
+    free(s->reason);
+    free(s->activity);
+    free(s->phase);
+    free(s->seen);
+    free(s->model);
+    free(s->failed);
+    free(s->heap);
+    free(s->heap_pos);
+    free(s->level_stamp);
+    free(s->trail);
+    free(s->trail_lim);
+    free(s->learnt_buf);
+    free(s->adding);
+    free(s->assumptions);
+    free(s->learn_clause);
+    free(s);
+}
+
+// Add a finished clause at decision level 0. Learnt clauses (imported from
+// another solver) may be deleted again by satReduceDb.
+static inline void satAddClause(sat_solver_t *s, int *lits, int size, int learnt) {
+    int kept = 0;
+    for (int i = 0; i < size; i++) {
+        int v = lits[i] > 0 ? lits[i] : -lits[i];
+        int sign = lits[i] > 0 ? 1 : -1;
+        if (s->seen[v] == sign || satLitValue(s, lits[i]) == -1)
+            continue; // duplicate or already false
+        if (s->seen[v] == -sign || satLitValue(s, lits[i]) == 1)
+            kept = -1; // tautology or already satisfied
+        if (kept < 0)
+            break;
+        s->seen[v] = sign;
+        lits[kept++] = lits[i];
+    }
+    for (int i = 0; i < size; i++)
+        s->seen[lits[i] > 0 ? lits[i] : -lits[i]] = 0;
+
+    if (kept < 0)
+        return;
+    if (kept == 0) {
+        s->ok = 0;
+    } else if (kept == 1) {
+        satAssign(s, lits[0], NULL);
+        if (satPropagate(s))
+            s->ok = 0;
+    } else {
+        sat_clause_t *c = satNewClause(s, lits, kept, learnt);
+        c->lbd = kept;
+    }
+}
+
+// Add the clauses other solvers have shared since the last restart
+static inline void satImport(sat_solver_t *s) {
+    const int *lits;
+    int size;
+    while (s->ok && (lits = s->import(s->import_data, &size)) != NULL) {
+        int known = 1;
+        for (int i = 0; i < size; i++) {
+            if ((lits[i] > 0 ? lits[i] : -lits[i]) > s->num_vars)
+                known = 0;
+        }
+        if (!known)
+            continue;
+        memcpy(s->learnt_buf, lits, size * sizeof(int));
+        satAddClause(s, s->learnt_buf, size, 1);
+    }
+}
+
+static inline void ipasir_add(void *solver, int lit_or_zero) {
+    sat_solver_t *s = solver;
+    if (lit_or_zero != 0) {
+        satEnsureVars(s, lit_or_zero > 0 ? lit_or_zero : -lit_or_zero);
+        if (s->adding_size == s->adding_cap) {
+            s->adding_cap = s->adding_cap ? 2 * s->adding_cap : 16;
+            s->adding = satRealloc(s->adding, s->adding_cap * sizeof(int));
+        }
+        s->adding[s->adding_size++] = lit_or_zero;
+        return;
+    }
+    if (s->ok)
+        satAddClause(s, s->adding, s->adding_size, 0);
+    s->adding_size = 0;
+}
+
+static inline void ipasir_assume(void *solver, int lit) {
+    sat_solver_t *s = solver;
+    satEnsureVars(s, lit > 0 ? lit : -lit);
+    if (s->num_assumptions == s->cap_assumptions) {
+        s->cap_assumptions = s->cap_assumptions ? 2 * s->cap_assumptions : 64;
+        s->assumptions = satRealloc(s->assumptions, s->cap_assumptions * sizeof(int));
+    }
+    s->assumptions[s->num_assumptions++] = lit;
+}
+
+// Returns 10 (satisfiable), 20 (unsatisfiable under the assumptions) or 0
+// (interrupted by the terminate callback)
+static inline int ipasir_solve(void *solver) {
+    sat_solver_t *s = solver;
+    int status = 0;
+    if (s->num_vars > 0)
+        memset(s->failed, 0, s->num_vars + 1);
+
+    satSimplify(s);
+    if (!s->ok) {
+        status = 20;
+    } else {
+        for (int restarts = 0; status == 0; restarts++) {
+            status = satSearch(s, (long)(satLuby(2, restarts) * SAT_RESTART_FIRST));
+            if (status == 0 && s->terminate && s->terminate(s->terminate_data))
+                break;
+            if (status == 0 && s->import) {
+                satImport(s);
+                if (!s->ok)
+                    status = 20;
+            }
+        }
+    }
+
+    if (status == 10 && s->num_vars > 0)
+        memcpy(s->model, s->value, s->num_vars + 1);
+    satCancelUntil(s, 0);
+    s->num_assumptions = 0;
+    return status;
+}
+
+// lit if lit is true in the last model, -lit if false, 0 if unknown
+static inline int ipasir_val(void *solver, int lit) {
+    sat_solver_t *s = solver;
+    int v = lit > 0 ? lit : -lit;
+    if (v > s->num_vars || s->model[v] == 0)
+        return 0;
+    return (s->model[v] > 0) == (lit > 0) ? lit : -lit;
+}
+
+// 1 if assumption lit was part of the reason the last solve was unsatisfiable
+static inline int ipasir_failed(void *solver, int lit) {
+    sat_solver_t *s = solver;
+    int v = lit > 0 ? lit : -lit;
+    return v <= s->num_vars && (s->failed[v] & (lit > 0 ? 1 : 2)) != 0;
+}
+
+static inline void ipasir_set_terminate(void *solver, void *data, int (*terminate)(void *data)) {
+    sat_solver_t *s = solver;
+    s->terminate = terminate;
+    s->terminate_data = data;
+}
+
+// Called with each learnt clause of at most max_length literals, 0-terminated
+static inline void ipasir_set_learn(void *solver, void *data, int max_length, void (*learn)(void *data, int *clause)) {
+    sat_solver_t *s = solver;
+    s->learn = learn;
+    s->learn_data = data;
+    s->learn_max = max_length;
+    s->learn_clause = satRealloc(s->learn_clause, (max_length + 1) * sizeof(int));
+}
+
+// Not part of IPASIR: import() is polled at every restart and returns the
+// next clause learnt elsewhere, or NULL when there is none
+static inline void satSetImport(void *solver, void *data, const int *(*import)(void *data, int *size)) {
+    sat_solver_t *s = solver;
+    s->import = import;
+    s->import_data = data;
+}
+
+// Not part of IPASIR: call before adding clauses so every variable gets the
+// configured initial phase and activity
+static inline void satConfigure(void *solver, const sat_config_t *config) {
+    sat_solver_t *s = solver;
+    s->config = *config;
+    s->rng = config->seed * 0x9E3779B97F4A7C15ULL + 1;
+}
+
+#endif
@@ -0,0 +1,246 @@
+#ifndef SAT_CUBE_H
+#define SAT_CUBE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "sat_encoder.h"
+#include "sat_cdcl.h"
+
+// Cube-and-conquer for the SAT path.
+//
+// The cuber splits the puzzle the way scripts/first_cell_candidate.py looks
+// at it: take the open cell with the fewest candidates and branch on each of
+// them. Every branch is propagated with the naked/hidden single rules from
+// sat_encoder.h, branches that die right away are dropped, and the survivors
+// are split again until there are enough cubes to keep all threads busy.
+// Each cube is a short list of (cell, digit) decisions.
+//
+// The conquer step hands cubes out to worker threads through an atomic
+// counter. A worker keeps one incremental solver for all of its cubes and
+// passes each cube as assumptions, so what it learnt on one cube carries
+// over to the next. The first satisfiable cube stops every worker.
+
+#ifndef CUBE_MIN_SIZE
+#define CUBE_MIN_SIZE 36 // smaller grids are solved in one piece
+#endif
+#define CUBES_PER_THREAD 16
+#define CUBE_MAX_DEPTH 8
+
+typedef struct {
+    int num_cubes;
+    int *start;  // cube k is lits[start[k]] .. lits[start[k + 1] - 1]
+    int *lits;   // SAT literals once cubeGenerate returns
+    int cap_cubes;
+    int cap_lits;
+} cube_set_t;
+
+static inline void cubeSetInit(cube_set_t *set) {
+    memset(set, 0, sizeof(*set));
+    set->start = malloc(sizeof(int));
+    if (!set->start) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    set->start[0] = 0;
+}
+
+static inline void cubeSetFree(cube_set_t *set) {
+    free(set->start);
+    free(set->lits);
+}
+
+// Append a cube made of prefix (size entries) followed by extra, if extra >= 0
+static inline void cubeSetAdd(cube_set_t *set, const int *prefix, int size, int extra) {
+    int len = size + (extra >= 0);
+    int used = set->start[set->num_cubes];
+    if (set->num_cubes + 1 >= set->cap_cubes) {
+        set->cap_cubes = set->cap_cubes ? 2 * set->cap_cubes : 64;
+        set->start = satRealloc(set->start, (set->cap_cubes + 1) * sizeof(int));
+    }
+    if (used + len > set->cap_lits) {
+        set->cap_lits = set->cap_lits ? 2 * set->cap_lits : 256;
+        while (used + len > set->cap_lits)
+            set->cap_lits *= 2;
+        set->lits = satRealloc(set->lits, set->cap_lits * sizeof(int));
+    }
+    if (size > 0)
+        memcpy(&set->lits[used], prefix, size * sizeof(int));
+    if (extra >= 0)
+        set->lits[used + size] = extra;
+    set->start[++set->num_cubes] = used + len;
+}
+
+// Put state back to root and replay the decisions (cell * n + digit).
+// Returns 0 if propagation finds a contradiction.
+static inline int cubeReplay(reduced_grid_t *state, const reduced_grid_t *root, const int *decisions, int size) {
+    int n = root->n;
+    memcpy(state->cand, root->cand, (size_t)n * n * n);
+    memcpy(state->fixed, root->fixed, (size_t)n * n * sizeof(int));
+    for (int i = 0; i < size; i++) {
+        int cell = decisions[i] / n, d = decisions[i] % n;
+        if (!reducedAssign(state, cell / n, cell % n, d))
+            return 0;
+    }
+    return reducedPropagate(state);
+}
+
+// Open cell with the fewest candidates, or -1 if every cell is fixed
+static inline int cubeSplitCell(const reduced_grid_t *state) {
+    int n = state->n, best = -1, best_count = n + 1;
+    for (int cell = 0; cell < n * n; cell++) {
+        if (state->fixed[cell])
+            continue;
+        int count = 0;
+        for (int d = 0; d < n; d++)
+            count += state->cand[cell * n + d] != 0;
+        if (count < best_count) {
+            best = cell;
+            best_count = count;
+        }
+    }
+    return best;
+}
+
+// Split root (a propagated reduced_grid_t) into at least target cubes where
+// possible. Literals use the compact variables of root if compact_vars is
+// set, the full n^3 numbering otherwise. No cubes means the puzzle has no
+// solution.
+static inline void cubeGenerate(const reduced_grid_t *root, int target, int compact_vars, cube_set_t *out) {
+    int n = root->n;
+    reduced_grid_t state = *root;
+    state.cand = malloc((size_t)n * n * n);
+    state.fixed = malloc((size_t)n * n * sizeof(int));
+    if (!state.cand || !state.fixed) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+
+    cube_set_t cur, next;
+    cubeSetInit(&cur);
+    cubeSetAdd(&cur, NULL, 0, -1);
+
+    for (int depth = 0; depth < CUBE_MAX_DEPTH && cur.num_cubes > 0 && cur.num_cubes < target; depth++) {
+        cubeSetInit(&next);
+        int split = 0;
+        for (int k = 0; k < cur.num_cubes; k++) {
+            const int *cube = &cur.lits[cur.start[k]];
+            int size = cur.start[k + 1] - cur.start[k];
+            if (!cubeReplay(&state, root, cube, size))
+                continue;
+            int cell = cubeSplitCell(&state);
+            if (cell < 0) {
+                cubeSetAdd(&next, cube, size, -1); // propagation solved this cube
+                continue;
+            }
+            for (int d = 0; d < n; d++) {
+                if (!state.cand[cell * n + d])
+                    continue;
+                cubeSetAdd(&next, cube, size, cell * n + d);
+                split = 1;
+            }
+        }
+        cubeSetFree(&cur);
+        cur = next;
+        if (!split)
+            break;
+    }
+
+    // Drop the children that die under propagation, then map to literals
+    cubeSetInit(out);
+    for (int k = 0; k < cur.num_cubes; k++) {
+        int *cube = &cur.lits[cur.start[k]];
+        int size = cur.start[k + 1] - cur.start[k];
+        if (!cubeReplay(&state, root, cube, size))
+            continue;
+        for (int i = 0; i < size; i++)
+            cube[i] = compact_vars ? root->var_id[cube[i]] : cube[i] + 1;
+        cubeSetAdd(out, cube, size, -1);
+    }
+
+    cubeSetFree(&cur);
+    free(state.cand);
+    free(state.fixed);
+}
+
+typedef struct {
+    const int *cnf; // flat clause buffer, each clause terminated by 0
+    size_t cnf_size;
+    int num_vars;
+    const cube_set_t *cubes;
+    atomic_int next_cube;
+    atomic_int refuted; // cubes proven unsatisfiable
+    atomic_int done;    // set once a cube is satisfiable
+    int winner;         // that cube
+    signed char *model; // its assignment, 1 true, -1 false
+} cube_run_t;
+
+static inline void cubeRunInit(cube_run_t *run, const int *cnf, size_t cnf_size, int num_vars, const cube_set_t *cubes) {
+    run->cnf = cnf;
+    run->cnf_size = cnf_size;
+    run->num_vars = num_vars;
+    run->cubes = cubes;
+    atomic_init(&run->next_cube, 0);
+    atomic_init(&run->refuted, 0);
+    atomic_init(&run->done, 0);
+    run->winner = -1;
+    run->model = calloc(num_vars + 1, 1);
+    if (!run->model) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+}
+
+static inline void cubeRunFree(cube_run_t *run) {
+    free(run->model);
+}
+
+static inline int cubeRunDone(void *data) {
+    cube_run_t *run = data;
+    return atomic_load_explicit(&run->done, memory_order_relaxed);
+}
+
+// Take cubes until none are left or one of them is satisfiable
+static inline void cubeWorker(cube_run_t *run) {
+    void *solver = NULL;
+
+    for (;;) {
+        int k = atomic_fetch_add(&run->next_cube, 1);
+        if (k >= run->cubes->num_cubes || cubeRunDone(run))
+            break;
+        if (!solver) {
+            solver = ipasir_init();
+            ipasir_set_terminate(solver, run, cubeRunDone);
+            for (size_t i = 0; i < run->cnf_size; i++)
+                ipasir_add(solver, run->cnf[i]);
+        }
+
+        for (int i = run->cubes->start[k]; i < run->cubes->start[k + 1]; i++)
+            ipasir_assume(solver, run->cubes->lits[i]);
+        int result = ipasir_solve(solver);
+        if (result == 20) {
+            atomic_fetch_add(&run->refuted, 1);
+            continue;
+        }
+        int expected = 0;
+        if (result == 10 && atomic_compare_exchange_strong(&run->done, &expected, 1)) {
+            run->winner = k;
+            for (int v = 1; v <= run->num_vars; v++)
+                run->model[v] = ipasir_val(solver, v) > 0 ? 1 : -1;
+        }
+        break;
+    }
+
+    if (solver)
+        ipasir_release(solver);
+}
+
+// 10 if some cube was satisfiable, 20 if all were refuted
+static inline int cubeRunResult(cube_run_t *run) {
+    if (atomic_load(&run->done))
+        return 10;
+    return atomic_load(&run->refuted) == run->cubes->num_cubes ? 20 : 0;
+}
+
+#endif
@@ -0,0 +1,222 @@
+#ifndef SAT_DIMACS_H
+#define SAT_DIMACS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sudoku_loader.h"
+
+// Fast DIMACS export and model import for the sat_solver_* programs.
+//
+// The writer formats integers by hand into large buffers and hands them to
+// write(2) directly instead of going through one fprintf per literal. When
+// the program is built with -fopenmp and more than one thread is requested,
+// the clause buffer is cut into chunks at clause boundaries and the chunks
+// are formatted in parallel, then written out in order.
+//
+// The model reader mmaps the solver output, so lines of any length are
+// handled (the old fgets buffer cut the model line at 1024 bytes).
+//
+// readPuzzle loads the same puzzle files as the backtracking solvers, so
+// both can be run on the *_easy/medium/hard.txt inputs.
+
+#define DIMACS_BUFFER_SIZE (1 << 20)
+#define DIMACS_MAX_SLOT_BYTES 12 // "-2147483648 " is the longest a literal gets
+
+// Append the decimal form of v to p and return the new end
+static inline char *dimacsFormatInt(char *p, int v) {
+    char tmp[12];
+    int len = 0;
+    unsigned int u = v < 0 ? 0u - (unsigned int)v : (unsigned int)v;
+    if (v < 0)
+        *p++ = '-';
+    do {
+        tmp[len++] = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    while (len)
+        *p++ = tmp[--len];
+    return p;
+}
+
+static inline void dimacsWriteAll(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(fd, buf, len);
+        if (written < 0) {
+            perror("Error writing CNF");
+            exit(1);
+        }
+        buf += written;
+        len -= written;
+    }
+}
+
+// Format the 0-terminated clauses in cnf[begin, end) into out
+static inline size_t dimacsFormat(char *out, const int *cnf, size_t begin, size_t end) {
+    char *p = out;
+    for (size_t i = begin; i < end; i++) {
+        if (cnf[i] == 0) {
+            *p++ = '0';
+            *p++ = '\n';
+        } else {
+            p = dimacsFormatInt(p, cnf[i]);
+            *p++ = ' ';
+        }
+    }
+    return p - out;
+}
+
+// Write a flat clause buffer (see cnf_layout_t) as a DIMACS file
+static inline void writeDimacs(const char *filename, const int *cnf, size_t cnf_size,
+                               int num_vars, long num_clauses, int threads) {
+    int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("Error opening file");
+        exit(1);
+    }
+
+    char header[64];
+    int header_len = snprintf(header, sizeof(header), "p cnf %d %ld\n", num_vars, num_clauses);
+    dimacsWriteAll(fd, header, header_len);
+
+#ifdef _OPENMP
+    if (threads > 1 && cnf_size > DIMACS_BUFFER_SIZE) {
+        int chunks = threads * 4;
+        size_t bounds[chunks + 1];
+        bounds[0] = 0;
+        for (int k = 1; k < chunks; k++) {
+            size_t pos = (size_t)k * cnf_size / chunks;
+            if (pos < bounds[k - 1])
+                pos = bounds[k - 1];
+            while (pos > 0 && pos < cnf_size && cnf[pos - 1] != 0)
+                pos++;
+            bounds[k] = pos;
+        }
+        bounds[chunks] = cnf_size;
+
+        char *out[chunks];
+        size_t out_len[chunks];
+        #pragma omp parallel for schedule(dynamic) num_threads(threads)
+        for (int k = 0; k < chunks; k++) {
+            out[k] = malloc((bounds[k + 1] - bounds[k]) * DIMACS_MAX_SLOT_BYTES + 1);
+            if (!out[k]) {
+                perror("Memory allocation failed");
+                exit(1);
+            }
+            out_len[k] = dimacsFormat(out[k], cnf, bounds[k], bounds[k + 1]);
+        }
+        for (int k = 0; k < chunks; k++) {
+            dimacsWriteAll(fd, out[k], out_len[k]);
+            free(out[k]);
+        }
+        close(fd);
+        return;
+    }
+#else
+    (void)threads;
+#endif
+
+    // Stream through one large buffer, flushing whenever it is nearly full
+    char *buf = malloc(DIMACS_BUFFER_SIZE);
+    if (!buf) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    size_t step = (DIMACS_BUFFER_SIZE / DIMACS_MAX_SLOT_BYTES) - 1;
+    for (size_t i = 0; i < cnf_size; i += step) {
+        size_t end = i + step < cnf_size ? i + step : cnf_size;
+        dimacsWriteAll(fd, buf, dimacsFormat(buf, cnf, i, end));
+    }
+    free(buf);
+    close(fd);
+}
+
+// Read a solver result file. Accepts MiniSat's format ("SAT" / "UNSAT" and a
+// bare literal line) as well as the competition format ("s SATISFIABLE" and
+// "v ..." lines). model[v] is set to 1 or -1 for every variable 1..num_vars
+// that appears, and 0 for the rest, even if the file has no verdict. Returns
+// 1 if satisfiable, 0 if unsatisfiable, -1 if the file has no verdict.
+static inline int readModel(const char *filename, int num_vars, signed char *model) {
+    memset(model, 0, num_vars + 1);
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Error opening MiniSat output");
+        exit(1);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("Error reading MiniSat output");
+        exit(1);
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return -1;
+    }
+    const char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        perror("Error mapping MiniSat output");
+        exit(1);
+    }
+
+    const char *p = data, *end = data + st.st_size;
+    int status = -1;
+
+    int line_start = 1;
+    while (p < end) {
+        // Status and comment lines are recognised by their first character
+        if (line_start && (*p == 'c' || *p == 's' || *p == 'S' || *p == 'U' || *p == 'I')) {
+            const char *line = p;
+            while (p < end && *p != '\n')
+                p++;
+            size_t len = p - line;
+            if ((len >= 5 && strncmp(line, "UNSAT", 5) == 0) ||
+                (len >= 15 && strncmp(line, "s UNSATISFIABLE", 15) == 0))
+                status = 0;
+            else if ((len >= 3 && strncmp(line, "SAT", 3) == 0) ||
+                     (len >= 13 && strncmp(line, "s SATISFIABLE", 13) == 0))
+                status = 1;
+            continue;
+        }
+        line_start = *p == '\n';
+        if (*p == 'v' || *p == ' ' || *p == '\t' || *p == '\n' || *p == '\r') {
+            p++;
+            continue;
+        }
+
+        // A literal
+        int negative = 0;
+        if (*p == '-') {
+            negative = 1;
+            p++;
+        }
+        int v = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+            v = v * 10 + (*p++ - '0');
+        if (v > 0 && v <= num_vars)
+            model[v] = negative ? -1 : 1;
+        while (p < end && *p != ' ' && *p != '\n' && *p != '\t' && *p != '\r')
+            p++; // Skip anything that is not part of a number
+    }
+
+    munmap((void *)data, st.st_size);
+    return status;
+}
+
+// Read a puzzle file: the grid size n on the first line, then n rows of n
+// numbers with 0 for an empty cell. n must be a perfect square; the box size
+// is stored in *box. Returns the grid row-major, to be freed by the caller.
+// The checks are those of load_puzzle in sudoku_loader.h, which also reads
+// puzzle index of a binary puzzle set.
+static inline int *readPuzzle(const char *filename, long index, int *n, int *box) {
+    int *grid = load_puzzle(filename, index, n, box);
+    if (!grid)
+        exit(1);
+    return grid;
+}
+
+#endif
@@ -0,0 +1,596 @@
+#ifndef SAT_ENCODER_H
+#define SAT_ENCODER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Givens-aware reduced encoding shared by the sat_solver_* programs.
+//
+// Before any clause is emitted the givens are run through unit propagation.
+// On the Sudoku CNF that is exactly naked singles (a cell's at-least-one
+// clause becomes unit) and hidden singles (a row/column/box at-least-one
+// clause becomes unit). Cells fixed that way get no variables at all, open
+// cells only get variables for digits that are still possible, and clauses
+// already satisfied by a fixed cell are dropped.
+
+typedef struct {
+    int n;
+    int box;
+    unsigned char *cand; // cand[(r * n + c) * n + d] != 0 if digit d + 1 is still possible
+    int *fixed;          // fixed[r * n + c] = digit forced by propagation, 0 if still open
+    int *var_id;         // var_id[(r * n + c) * n + d] = compact SAT variable, 0 if none
+    int *var_cell;       // var_cell[v] = (r * n + c) * n + d for compact variable v
+    int num_vars;
+} reduced_grid_t;
+
+// Callback used to hand a finished clause to the caller's clause store
+typedef void (*emit_clause_fn)(int literals[], int size);
+
+// At-most-one encodings.
+// Pairwise needs no extra variables but O(k^2) clauses; the others trade
+// auxiliary variables for O(k) clauses. Auxiliary variables are handed out
+// from *next_var, which must point at the last variable already in use.
+typedef enum {
+    AMO_PAIRWISE,
+    AMO_SEQUENTIAL, // Sinz sequential counter
+    AMO_COMMANDER,  // Klieber-Kwon, groups of 3
+    AMO_PRODUCT,    // Chen 2-product
+    AMO_BIMANDER    // Nguyen-Mai, groups of 2 with binary commanders
+} amo_encoding_t;
+
+static inline int parseAmoEncoding(const char *name, amo_encoding_t *enc) {
+    const char *names[] = {"pairwise", "sequential", "commander", "product", "bimander"};
+    for (int i = 0; i < 5; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            *enc = (amo_encoding_t)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Hand a clause to emit, or only count it when emit is NULL
+static inline long amoEmit(emit_clause_fn emit, int a, int b, int c, int size) {
+    if (emit) {
+        int clause[] = {a, b, c};
+        emit(clause, size);
+    }
+    return 1;
+}
+
+static inline long amoPairwise(const int *lits, int size, emit_clause_fn emit) {
+    long count = 0;
+    for (int i = 0; i < size; i++)
+        for (int j = i + 1; j < size; j++)
+            count += amoEmit(emit, -lits[i], -lits[j], 0, 2);
+    return count;
+}
+
+// Emit "at most one of lits[0..size)" and return the number of clauses.
+// With emit == NULL nothing is written, which lets callers size buffers and
+// auxiliary ranges up front.
+static inline long encodeAtMostOne(const int *lits, int size, amo_encoding_t enc, int *next_var, emit_clause_fn emit) {
+    long count = 0;
+    if (size <= 1)
+        return 0;
+
+    switch (enc) {
+    case AMO_PAIRWISE:
+        return amoPairwise(lits, size, emit);
+
+    case AMO_SEQUENTIAL: {
+        // s_i is true once one of x_0..x_i is true
+        int s = *next_var + 1;
+        *next_var += size - 1;
+        count += amoEmit(emit, -lits[0], s, 0, 2);
+        for (int i = 1; i < size - 1; i++) {
+            count += amoEmit(emit, -lits[i], s + i, 0, 2);
+            count += amoEmit(emit, -(s + i - 1), s + i, 0, 2);
+            count += amoEmit(emit, -lits[i], -(s + i - 1), 0, 2);
+        }
+        count += amoEmit(emit, -lits[size - 1], -(s + size - 2), 0, 2);
+        return count;
+    }
+
+    case AMO_COMMANDER: {
+        if (size <= 6)
+            return amoPairwise(lits, size, emit);
+        int groups = (size + 2) / 3;
+        int commanders[groups];
+        for (int g = 0; g < groups; g++) {
+            int start = g * 3, len = size - start < 3 ? size - start : 3;
+            commanders[g] = ++*next_var;
+            count += amoPairwise(&lits[start], len, emit);
+            for (int i = 0; i < len; i++)
+                count += amoEmit(emit, -lits[start + i], commanders[g], 0, 2);
+        }
+        return count + encodeAtMostOne(commanders, groups, enc, next_var, emit);
+    }
+
+    case AMO_PRODUCT: {
+        if (size <= 4)
+            return amoPairwise(lits, size, emit);
+        int p = 1;
+        while (p * p < size)
+            p++;
+        int q = (size + p - 1) / p;
+        int rows[p], cols[q];
+        for (int i = 0; i < p; i++)
+            rows[i] = ++*next_var;
+        for (int j = 0; j < q; j++)
+            cols[j] = ++*next_var;
+        for (int k = 0; k < size; k++) {
+            count += amoEmit(emit, -lits[k], rows[k / q], 0, 2);
+            count += amoEmit(emit, -lits[k], cols[k % q], 0, 2);
+        }
+        count += encodeAtMostOne(rows, p, enc, next_var, emit);
+        return count + encodeAtMostOne(cols, q, enc, next_var, emit);
+    }
+
+    case AMO_BIMANDER: {
+        int groups = (size + 1) / 2;
+        if (groups == 1)
+            return amoPairwise(lits, size, emit);
+        int bits = 0;
+        while ((1 << bits) < groups)
+            bits++;
+        int b = *next_var + 1;
+        *next_var += bits;
+        for (int k = 0; k < size; k++) {
+            int g = k / 2;
+            if (k % 2 == 0 && k + 1 < size)
+                count += amoEmit(emit, -lits[k], -lits[k + 1], 0, 2);
+            for (int j = 0; j < bits; j++)
+                count += amoEmit(emit, -lits[k], (g >> j) & 1 ? b + j : -(b + j), 0, 2);
+        }
+        return count;
+    }
+    }
+    return count;
+}
+
+// Auxiliary variables one at-most-one constraint over size literals uses
+static inline int amoAuxCount(int size, amo_encoding_t enc) {
+    int lits[size > 0 ? size : 1];
+    int next_var = 0;
+    memset(lits, 0, sizeof(lits));
+    encodeAtMostOne(lits, size, enc, &next_var, NULL);
+    return next_var;
+}
+
+// Flat clause buffer layout for the full structural encoding.
+//
+// Clauses are stored back to back, each terminated by 0, exactly like a
+// DIMACS body. Every constraint family has a closed-form clause count, so
+// the offset of each cell / (unit, num) group is known before encoding and
+// threads can write their groups straight into the buffer without locks.
+// All at-most-one clauses are binary, so one AMO group always takes
+// amo_clauses * 3 slots.
+//
+// Everything before base_slots is the structural part, which only depends on
+// n, box and the AMO options. The givens are unit clauses appended after it.
+typedef struct {
+    int n;
+    int box;
+    amo_encoding_t amo;
+    int amo_units;
+    int aux_per_group;   // auxiliary variables per AMO group
+    long amo_clauses;    // clauses per AMO group over n literals
+    size_t unit_slots;   // slots per (unit, num) group
+    size_t cell_alo_base;
+    size_t cell_amo_base;
+    size_t row_base;
+    size_t col_base;
+    size_t box_base;
+    size_t base_slots;   // where the givens start
+    size_t max_slots;    // base plus room for every cell being a given
+    long base_clauses;
+    int num_vars;
+} cnf_layout_t;
+
+static inline void cnfLayoutInit(cnf_layout_t *l, int n, int box, amo_encoding_t amo, int amo_units) {
+    size_t cells = (size_t)n * n;
+    l->n = n;
+    l->box = box;
+    l->amo = amo;
+    l->amo_units = amo_units;
+    l->aux_per_group = amoAuxCount(n, amo);
+    {
+        int lits[n], next_var = 0;
+        memset(lits, 0, sizeof(lits));
+        l->amo_clauses = encodeAtMostOne(lits, n, amo, &next_var, NULL);
+    }
+    l->unit_slots = (n + 1) + (amo_units ? l->amo_clauses * 3 : 0);
+
+    l->cell_alo_base = 0;
+    l->cell_amo_base = l->cell_alo_base + cells * (n + 1);
+    l->row_base = l->cell_amo_base + cells * l->amo_clauses * 3;
+    l->col_base = l->row_base + cells * l->unit_slots;
+    l->box_base = l->col_base + cells * l->unit_slots;
+    l->base_slots = l->box_base + cells * l->unit_slots;
+    l->max_slots = l->base_slots + cells * 2;
+
+    l->base_clauses = (long)cells * (4 + l->amo_clauses + (amo_units ? 3 * l->amo_clauses : 0));
+    l->num_vars = n * n * n + (amo_units ? 4 : 1) * (int)cells * l->aux_per_group;
+}
+
+// Slot offsets of each group. Units are indexed (row, num), (col, num) and
+// (box, num) with num 0-based.
+static inline size_t cellAloOffset(const cnf_layout_t *l, int r, int c) {
+    return l->cell_alo_base + ((size_t)r * l->n + c) * (l->n + 1);
+}
+
+static inline size_t cellAmoOffset(const cnf_layout_t *l, int r, int c) {
+    return l->cell_amo_base + ((size_t)r * l->n + c) * l->amo_clauses * 3;
+}
+
+static inline size_t rowOffset(const cnf_layout_t *l, int r, int num) {
+    return l->row_base + ((size_t)r * l->n + num) * l->unit_slots;
+}
+
+static inline size_t colOffset(const cnf_layout_t *l, int c, int num) {
+    return l->col_base + ((size_t)c * l->n + num) * l->unit_slots;
+}
+
+static inline size_t boxOffset(const cnf_layout_t *l, int b, int num) {
+    return l->box_base + ((size_t)b * l->n + num) * l->unit_slots;
+}
+
+// Last variable in use before the auxiliaries of an AMO group. Groups are
+// numbered cells, then (row, num), (col, num) and (box, num), so every group
+// owns a fixed range no matter which thread encodes it.
+static inline int auxBase(const cnf_layout_t *l, int group) {
+    return l->n * l->n * l->n + group * l->aux_per_group;
+}
+
+// Per-thread write cursor into the flat buffer. A thread points it at its
+// group with clauseSliceBegin and then emits through addClause.
+static __thread int *clause_pos;
+
+static inline void clauseSliceBegin(int *cnf, size_t offset) {
+    clause_pos = cnf + offset;
+}
+
+static inline void addClause(int literals[], int size) {
+    memcpy(clause_pos, literals, size * sizeof(int));
+    clause_pos += size;
+    *clause_pos++ = 0;
+}
+
+static inline int *cnfAlloc(size_t slots) {
+    int *cnf = malloc((slots > 0 ? slots : 1) * sizeof(int));
+    if (!cnf) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    return cnf;
+}
+
+// Write the givens of grid (row-major, 0 = empty) as unit clauses after the
+// structural part. Returns the number of givens.
+static inline int encodeGivens(const cnf_layout_t *l, int *cnf, const int *grid) {
+    int n = l->n, count = 0;
+    clauseSliceBegin(cnf, l->base_slots);
+    for (int cell = 0; cell < n * n; cell++) {
+        if (grid[cell] != 0) {
+            int clause[] = {cell * n + grid[cell]};
+            addClause(clause, 1);
+            count++;
+        }
+    }
+    return count;
+}
+
+// Binary cache of the structural part of the CNF.
+//
+// The structural clauses are identical for every puzzle of a given size and
+// AMO configuration, so they are built once and stored as a header followed
+// by the raw clause slots. Loading maps the file and copies the slots in,
+// which costs far less than encoding them again.
+#define CNF_CACHE_MAGIC "SUDOCNF1"
+
+typedef struct {
+    char magic[8];
+    int n;
+    int box;
+    int amo;
+    int amo_units;
+    int num_vars;
+    long base_clauses;
+    size_t base_slots;
+} cnf_cache_header_t;
+
+// Default cache file name for a layout, e.g. sudoku_base_25_5_pairwise.cnfbin
+static inline void cnfCacheName(char *buf, size_t len, const cnf_layout_t *l) {
+    const char *names[] = {"pairwise", "sequential", "commander", "product", "bimander"};
+    snprintf(buf, len, "sudoku_base_%d_%d_%s%s.cnfbin", l->n, l->box, names[l->amo],
+             l->amo_units ? "_units" : "");
+}
+
+static inline void cnfCacheHeader(cnf_cache_header_t *h, const cnf_layout_t *l) {
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, CNF_CACHE_MAGIC, sizeof(h->magic));
+    h->n = l->n;
+    h->box = l->box;
+    h->amo = l->amo;
+    h->amo_units = l->amo_units;
+    h->num_vars = l->num_vars;
+    h->base_clauses = l->base_clauses;
+    h->base_slots = l->base_slots;
+}
+
+// Copy the structural part from a cache file into cnf. Returns 0 if the file
+// is missing or was built for a different layout.
+static inline int cnfCacheLoad(const char *filename, const cnf_layout_t *l, int *cnf) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    cnf_cache_header_t expected;
+    cnfCacheHeader(&expected, l);
+    size_t size = sizeof(expected) + l->base_slots * sizeof(int);
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size != size) {
+        close(fd);
+        return 0;
+    }
+
+    const char *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return 0;
+    int ok = memcmp(data, &expected, sizeof(expected)) == 0;
+    if (ok)
+        memcpy(cnf, data + sizeof(expected), l->base_slots * sizeof(int));
+    munmap((void *)data, size);
+    return ok;
+}
+
+static inline void cnfCacheSave(const char *filename, const cnf_layout_t *l, const int *cnf) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        perror("Error opening CNF cache");
+        return;
+    }
+    cnf_cache_header_t header;
+    cnfCacheHeader(&header, l);
+    if (fwrite(&header, sizeof(header), 1, file) != 1 ||
+        fwrite(cnf, sizeof(int), l->base_slots, file) != l->base_slots)
+        perror("Error writing CNF cache");
+    fclose(file);
+}
+
+// Cell (r, c) of the k-th member of unit u: rows, then columns, then boxes
+static inline void unitCell(int n, int box, int u, int k, int *r, int *c) {
+    if (u < n) {
+        *r = u;
+        *c = k;
+    } else if (u < 2 * n) {
+        *r = k;
+        *c = u - n;
+    } else {
+        int b = u - 2 * n;
+        *r = (b / box) * box + k / box;
+        *c = (b % box) * box + k % box;
+    }
+}
+
+// Place digit d (0-based) in (r, c) and remove it from every peer.
+// Returns 0 if that contradicts what is already known.
+static inline int reducedAssign(reduced_grid_t *rg, int r, int c, int d) {
+    int n = rg->n, box = rg->box;
+    int cell = r * n + c;
+
+    if (rg->fixed[cell] == d + 1)
+        return 1;
+    if (rg->fixed[cell] != 0 || !rg->cand[cell * n + d])
+        return 0;
+
+    rg->fixed[cell] = d + 1;
+    memset(&rg->cand[cell * n], 0, n);
+    rg->cand[cell * n + d] = 1;
+
+    int box_r = r - r % box, box_c = c - c % box;
+    for (int i = 0; i < n; i++) {
+        int peers[3] = {r * n + i, i * n + c, (box_r + i / box) * n + box_c + i % box};
+        for (int p = 0; p < 3; p++) {
+            if (peers[p] == cell)
+                continue;
+            if (rg->fixed[peers[p]] == d + 1)
+                return 0;
+            rg->cand[peers[p] * n + d] = 0;
+        }
+    }
+    return 1;
+}
+
+// Run unit propagation on the givens until nothing changes.
+// Returns 0 if the puzzle is contradictory.
+static inline int reducedPropagate(reduced_grid_t *rg) {
+    int n = rg->n, box = rg->box;
+    int changed = 1;
+
+    while (changed) {
+        changed = 0;
+
+        // Naked singles: an open cell with exactly one candidate
+        for (int cell = 0; cell < n * n; cell++) {
+            if (rg->fixed[cell])
+                continue;
+            int count = 0, last = -1;
+            for (int d = 0; d < n; d++) {
+                if (rg->cand[cell * n + d]) {
+                    count++;
+                    last = d;
+                }
+            }
+            if (count == 0)
+                return 0;
+            if (count == 1) {
+                if (!reducedAssign(rg, cell / n, cell % n, last))
+                    return 0;
+                changed = 1;
+            }
+        }
+
+        // Hidden singles: a digit with exactly one possible cell in a unit
+        for (int u = 0; u < 3 * n; u++) {
+            for (int d = 0; d < n; d++) {
+                int count = 0, placed = 0, last_r = -1, last_c = -1;
+                for (int k = 0; k < n && !placed; k++) {
+                    int r, c;
+                    unitCell(n, box, u, k, &r, &c);
+                    if (rg->fixed[r * n + c] == d + 1)
+                        placed = 1;
+                    else if (!rg->fixed[r * n + c] && rg->cand[(r * n + c) * n + d]) {
+                        count++;
+                        last_r = r;
+                        last_c = c;
+                    }
+                }
+                if (placed)
+                    continue;
+                if (count == 0)
+                    return 0;
+                if (count == 1) {
+                    if (!reducedAssign(rg, last_r, last_c, d))
+                        return 0;
+                    changed = 1;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+// Build the reduced variable set for a puzzle (grid is row-major, 0 = empty).
+// Returns 0 if propagation proves the givens contradictory.
+static inline int reducedInit(reduced_grid_t *rg, const int *grid, int n, int box) {
+    rg->n = n;
+    rg->box = box;
+    rg->num_vars = 0;
+    rg->cand = malloc((size_t)n * n * n);
+    rg->fixed = calloc((size_t)n * n, sizeof(int));
+    rg->var_id = calloc((size_t)n * n * n, sizeof(int));
+    rg->var_cell = malloc(((size_t)n * n * n + 1) * sizeof(int));
+    if (!rg->cand || !rg->fixed || !rg->var_id || !rg->var_cell) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    memset(rg->cand, 1, (size_t)n * n * n);
+
+    for (int cell = 0; cell < n * n; cell++) {
+        if (grid[cell] != 0 && !reducedAssign(rg, cell / n, cell % n, grid[cell] - 1))
+            return 0;
+    }
+    if (!reducedPropagate(rg))
+        return 0;
+
+    for (int cell = 0; cell < n * n; cell++) {
+        if (rg->fixed[cell])
+            continue;
+        for (int d = 0; d < n; d++) {
+            if (rg->cand[cell * n + d]) {
+                rg->var_id[cell * n + d] = ++rg->num_vars;
+                rg->var_cell[rg->num_vars] = cell * n + d;
+            }
+        }
+    }
+    return 1;
+}
+
+static inline void reducedFree(reduced_grid_t *rg) {
+    free(rg->cand);
+    free(rg->fixed);
+    free(rg->var_id);
+    free(rg->var_cell);
+}
+
+// Emit the reduced CNF: cell at-least-one / at-most-one over the open cells,
+// and unit at-least-one (plus at-most-one if amo_units) for every digit not
+// yet placed in that unit. Returns the variable count including auxiliaries.
+static inline int reducedEncode(const reduced_grid_t *rg, amo_encoding_t amo, int amo_units, emit_clause_fn emit) {
+    int n = rg->n, box = rg->box;
+    int clause[n];
+    int next_var = rg->num_vars;
+
+    for (int cell = 0; cell < n * n; cell++) {
+        if (rg->fixed[cell])
+            continue;
+        int size = 0;
+        for (int d = 0; d < n; d++) {
+            if (rg->var_id[cell * n + d])
+                clause[size++] = rg->var_id[cell * n + d];
+        }
+        emit(clause, size);
+        encodeAtMostOne(clause, size, amo, &next_var, emit);
+    }
+
+    for (int u = 0; u < 3 * n; u++) {
+        for (int d = 0; d < n; d++) {
+            int size = 0, placed = 0;
+            for (int k = 0; k < n && !placed; k++) {
+                int r, c;
+                unitCell(n, box, u, k, &r, &c);
+                if (rg->fixed[r * n + c] == d + 1)
+                    placed = 1;
+                else if (rg->var_id[(r * n + c) * n + d])
+                    clause[size++] = rg->var_id[(r * n + c) * n + d];
+            }
+            if (placed)
+                continue;
+            emit(clause, size);
+            if (amo_units)
+                encodeAtMostOne(clause, size, amo, &next_var, emit);
+        }
+    }
+    return next_var;
+}
+
+// Dry-run emitter used to size the buffer for encodings without a closed form
+static long counted_clauses;
+static size_t counted_slots;
+
+static inline void countClause(int literals[], int size) {
+    (void)literals;
+    counted_clauses++;
+    counted_slots += size + 1;
+}
+
+// Encode the reduced CNF into a freshly allocated flat buffer. The reduced
+// clause count depends on the givens, so it is measured with a dry run first.
+static inline int *reducedEncodeFlat(const reduced_grid_t *rg, amo_encoding_t amo, int amo_units,
+                                     size_t *slots, long *clauses, int *num_vars) {
+    counted_clauses = 0;
+    counted_slots = 0;
+    reducedEncode(rg, amo, amo_units, countClause);
+
+    int *cnf = cnfAlloc(counted_slots);
+    clauseSliceBegin(cnf, 0);
+    *num_vars = reducedEncode(rg, amo, amo_units, addClause);
+    *slots = counted_slots;
+    *clauses = counted_clauses;
+    return cnf;
+}
+
+// Write a compact variable the solver set to true back into the grid
+static inline void reducedDecodeVar(const reduced_grid_t *rg, int v, int *grid) {
+    if (v <= 0 || v > rg->num_vars)
+        return;
+    int idx = rg->var_cell[v];
+    grid[idx / rg->n] = idx % rg->n + 1;
+}
+
+// Copy the cells fixed by propagation into the grid
+static inline void reducedApplyFixed(const reduced_grid_t *rg, int *grid) {
+    for (int cell = 0; cell < rg->n * rg->n; cell++) {
+        if (rg->fixed[cell])
+            grid[cell] = rg->fixed[cell];
+    }
+}
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef SAT_PORTFOLIO_H
+#define SAT_PORTFOLIO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+#include "sat_cdcl.h"
+
+// Portfolio solving: several CDCL instances (sat_cdcl.h) with different
+// seeds, restart policies and polarities race on the same formula, and the
+// first one to finish answers for all of them.
+//
+// Learnt clauses of up to PORTFOLIO_SHARE_SIZE literals are exchanged through
+// one ring buffer per worker. Only the owner writes its ring and the others
+// read it without locks. Every slot carries a sequence number that the writer
+// makes odd while filling it, so a reader that races with the writer, or has
+// fallen a whole ring behind, notices and skips the slot.
+//
+// The caller starts one thread per worker in whatever way the program already
+// uses (an OpenMP parallel region, pthread_create) and runs portfolioWorker
+// in each.
+
+#define PORTFOLIO_SHARE_SIZE 8
+#define PORTFOLIO_RING_SLOTS 4096
+
+typedef struct {
+    atomic_ulong seq; // 2 * index + 1 while being written, 2 * index + 2 once complete
+    atomic_int size;
+    atomic_int lits[PORTFOLIO_SHARE_SIZE];
+} share_slot_t;
+
+typedef struct {
+    share_slot_t slots[PORTFOLIO_RING_SLOTS];
+    atomic_ulong head; // index of the next slot to write
+} share_ring_t;
+
+typedef struct {
+    const int *cnf; // flat clause buffer, each clause terminated by 0
+    size_t cnf_size;
+    int num_vars;
+    int num_workers;
+    share_ring_t *rings;
+    atomic_int done; // set by the first worker with an answer
+    int result;      // 10 or 20 from the winner
+    int winner;
+    signed char *model; // winner's assignment, 1 true, -1 false
+} sat_portfolio_t;
+
+typedef struct {
+    sat_portfolio_t *portfolio;
+    int id;
+    unsigned long *read_pos; // next index to read in every ring
+    int next_ring;
+    int clause[PORTFOLIO_SHARE_SIZE];
+} portfolio_worker_t;
+
+// Worker 0 keeps the default settings, the others vary restarts and phase
+static inline void portfolioConfig(int id, sat_config_t *config) {
+    static const sat_restart_t restarts[] = {SAT_RESTART_LUBY, SAT_RESTART_GLUCOSE, SAT_RESTART_LUBY, SAT_RESTART_GLUCOSE};
+    static const sat_phase_t phases[] = {SAT_PHASE_FALSE, SAT_PHASE_FALSE, SAT_PHASE_RANDOM, SAT_PHASE_TRUE};
+    config->seed = id;
+    config->restarts = restarts[id % 4];
+    config->phase = phases[id % 4];
+}
+
+static inline void portfolioInit(sat_portfolio_t *p, const int *cnf, size_t cnf_size, int num_vars, int num_workers) {
+    p->cnf = cnf;
+    p->cnf_size = cnf_size;
+    p->num_vars = num_vars;
+    p->num_workers = num_workers;
+    p->rings = calloc(num_workers, sizeof(share_ring_t));
+    p->model = calloc(num_vars + 1, 1);
+    if (!p->rings || !p->model) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    atomic_init(&p->done, 0);
+    p->result = 0;
+    p->winner = -1;
+}
+
+static inline void portfolioFree(sat_portfolio_t *p) {
+    free(p->rings);
+    free(p->model);
+}
+
+static inline int portfolioDone(void *data) {
+    sat_portfolio_t *p = data;
+    return atomic_load_explicit(&p->done, memory_order_relaxed);
+}
+
+// Learn callback: publish a short learnt clause in this worker's ring
+static inline void portfolioExport(void *data, int *clause) {
+    portfolio_worker_t *w = data;
+    share_ring_t *ring = &w->portfolio->rings[w->id];
+    unsigned long index = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    share_slot_t *slot = &ring->slots[index % PORTFOLIO_RING_SLOTS];
+
+    atomic_store_explicit(&slot->seq, 2 * index + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    int size = 0;
+    while (clause[size] != 0) {
+        atomic_store_explicit(&slot->lits[size], clause[size], memory_order_relaxed);
+        size++;
+    }
+    atomic_store_explicit(&slot->size, size, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, 2 * index + 2, memory_order_release);
+    atomic_store_explicit(&ring->head, index + 1, memory_order_release);
+}
+
+// Copy slot index of ring into w->clause. Returns the size, or 0 if the
+// slot was overwritten or is being written.
+static inline int portfolioReadSlot(portfolio_worker_t *w, share_ring_t *ring, unsigned long index) {
+    share_slot_t *slot = &ring->slots[index % PORTFOLIO_RING_SLOTS];
+    unsigned long seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+    if (seq != 2 * index + 2)
+        return 0;
+    int size = atomic_load_explicit(&slot->size, memory_order_relaxed);
+    if (size < 1 || size > PORTFOLIO_SHARE_SIZE)
+        return 0;
+    for (int i = 0; i < size; i++)
+        w->clause[i] = atomic_load_explicit(&slot->lits[i], memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&slot->seq, memory_order_relaxed) != seq)
+        return 0;
+    return size;
+}
+
+// Import callback: the next clause from any other worker's ring
+static inline const int *portfolioImport(void *data, int *size) {
+    portfolio_worker_t *w = data;
+    sat_portfolio_t *p = w->portfolio;
+
+    for (int tried = 0; tried < p->num_workers; tried++) {
+        int r = w->next_ring;
+        if (r == w->id) {
+            w->next_ring = (r + 1) % p->num_workers;
+            continue;
+        }
+        share_ring_t *ring = &p->rings[r];
+        unsigned long head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (head - w->read_pos[r] > PORTFOLIO_RING_SLOTS)
+            w->read_pos[r] = head - PORTFOLIO_RING_SLOTS; // fell behind, skip what was overwritten
+        while (w->read_pos[r] < head) {
+            *size = portfolioReadSlot(w, ring, w->read_pos[r]++);
+            if (*size > 0)
+                return w->clause;
+        }
+        w->next_ring = (r + 1) % p->num_workers;
+    }
+    return NULL;
+}
+
+// Run worker id until it or another worker finishes. The first worker with
+// an answer stores it in p->result and p->model.
+static inline void portfolioWorker(sat_portfolio_t *p, int id) {
+    portfolio_worker_t w = {0};
+    w.portfolio = p;
+    w.id = id;
+    w.read_pos = calloc(p->num_workers, sizeof(unsigned long));
+    if (!w.read_pos) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+
+    void *solver = ipasir_init();
+    sat_config_t config;
+    portfolioConfig(id, &config);
+    satConfigure(solver, &config);
+    ipasir_set_terminate(solver, p, portfolioDone);
+    if (p->num_workers > 1) {
+        ipasir_set_learn(solver, &w, PORTFOLIO_SHARE_SIZE, portfolioExport);
+        satSetImport(solver, &w, portfolioImport);
+    }
+    for (size_t i = 0; i < p->cnf_size; i++)
+        ipasir_add(solver, p->cnf[i]);
+
+    int result = ipasir_solve(solver);
+    int expected = 0;
+    if (result != 0 && atomic_compare_exchange_strong(&p->done, &expected, 1)) {
+        p->winner = id;
+        p->result = result;
+        for (int v = 1; result == 10 && v <= p->num_vars; v++)
+            p->model[v] = ipasir_val(solver, v) > 0 ? 1 : -1;
+    }
+
+    ipasir_release(solver);
+    free(w.read_pos);
+}
+
+#endif
@@ -2,217 +2,428 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
 #include <pthread.h>
+#include "sat_encoder.h"
+#include "sat_dimacs.h"
+#include "sat_portfolio.h"
+#include "sat_cube.h"
+#include "sudoku_output.h"
 
-#define N 25
-#define SUBGRID 5
-#define MAX_VARS (N * N * N)
-#define MAX_CLAUSES 300000
-#define MAX_CLAUSE_SIZE 70
 #define NUM_THREADS 4  // Adjust thread count based on CPU cores
 
-int clauses[MAX_CLAUSES][MAX_CLAUSE_SIZE];
-int clause_count = 0;
-pthread_mutex_t clause_mutex;
+int grid_size = 0;   // N, read from the puzzle file
+int block_size = 0;  // sqrt(N), the side of a box
 
-// Convert 3D Sudoku representation to SAT variable (1-based indexing)
-int var(int row, int col, int num) {
-    return (row * N * N) + (col * N) + num + 1;
-}
+int *cnf = NULL;         // Flat clause buffer, each clause terminated by 0
+size_t cnf_size = 0;     // Slots in use
+long clause_count = 0;
+int num_vars = 0;
+cnf_layout_t layout;
 
-// Add a clause to the CNF formula
-void addClause(int literals[], int size) {
-    pthread_mutex_lock(&clause_mutex);
-    if (clause_count >= MAX_CLAUSES) {
-        fprintf(stderr, "Error: Exceeded maximum clause storage!\n");
-        exit(1);
-    }
-    for (int i = 0; i < size; i++) {
-        clauses[clause_count][i] = literals[i];
-    }
-    clause_count++;
-    pthread_mutex_unlock(&clause_mutex);
-}
+output_options_t output = {0};  // Set by --quiet, --output=, --binary
 
-// Print Sudoku Grid
-void printGrid(int grid[N][N]) {
-    for (int r = 0; r < N; r++) {
-        for (int c = 0; c < N; c++) {
-            printf("%d ", grid[r][c]);
-        }
-        printf("\n");
-    }
+bool reduced_encoding = false;  // Set by --reduced
+reduced_grid_t reduced;
+
+amo_encoding_t amo_encoding = AMO_PAIRWISE;  // Set by --amo=
+bool amo_units = false;                      // Set by --amo-units
+
+bool use_cache = false;         // Set by --cache[=file]
+const char *cache_file = NULL;  // NULL picks the default name from cnfCacheName
+bool base_ready = false;        // Structural clauses already in cnf
+
+int portfolio_size = 0;  // Set by --portfolio[=K], 0 runs MiniSat instead
+int cube_threads = 0;    // Set by --cube[=K], cube-and-conquer on K threads
+
+// Range of outer indices (row, column or box) one encoder thread owns
+typedef struct {
+    int first;
+    int last;
+} encoder_args_t;
+
+// Convert 3D Sudoku representation to SAT variable (1-based indexing)
+int var(int row, int col, int num) {
+    return (row * grid_size * grid_size) + (col * grid_size) + num + 1;
 }
 
-// Parallel function for encoding constraints
-void* encodeCellConstraints(void* arg) {
-    for (int r = 0; r < N; r++) {
-        for (int c = 0; c < N; c++) {
-            int clause[N];
-            for (int n = 0; n < N; n++) {
+// Ensure each cell in rows [first, last) has at least one number (1-N)
+void encodeCellConstraints(int first, int last) {
+    clauseSliceBegin(cnf, cellAloOffset(&layout, first, 0));
+    for (int r = first; r < last; r++) {
+        for (int c = 0; c < grid_size; c++) {
+            int clause[grid_size];
+            for (int n = 0; n < grid_size; n++) {
                 clause[n] = var(r, c, n);
             }
-            addClause(clause, N);
+            addClause(clause, grid_size);
         }
     }
-    return NULL;
 }
 
-void* encodeUniqueCellConstraints(void* arg) {
-    for (int r = 0; r < N; r++) {
-        for (int c = 0; c < N; c++) {
-            for (int n1 = 0; n1 < N; n1++) {
-                for (int n2 = n1 + 1; n2 < N; n2++) {
-                    int clause[] = {-var(r, c, n1), -var(r, c, n2)};
-                    addClause(clause, 2);
-                }
+// Ensure each cell in rows [first, last) has at most one number
+void encodeUniqueCellConstraints(int first, int last) {
+    clauseSliceBegin(cnf, cellAmoOffset(&layout, first, 0));
+    for (int r = first; r < last; r++) {
+        for (int c = 0; c < grid_size; c++) {
+            int cell[grid_size];
+            for (int n = 0; n < grid_size; n++) {
+                cell[n] = var(r, c, n);
             }
+            int next_var = auxBase(&layout, r * grid_size + c);
+            encodeAtMostOne(cell, grid_size, amo_encoding, &next_var, addClause);
         }
     }
-    return NULL;
 }
 
-void* encodeRowConstraints(void* arg) {
-    for (int r = 0; r < N; r++) {
-        for (int n = 0; n < N; n++) {
-            int clause[N];
-            for (int c = 0; c < N; c++) {
+// Ensure rows [first, last) have unique numbers
+void encodeRowConstraints(int first, int last) {
+    clauseSliceBegin(cnf, rowOffset(&layout, first, 0));
+    for (int r = first; r < last; r++) {
+        for (int n = 0; n < grid_size; n++) {
+            int clause[grid_size];
+            for (int c = 0; c < grid_size; c++) {
                 clause[c] = var(r, c, n);
             }
-            addClause(clause, N);
+            addClause(clause, grid_size);
+            if (amo_units) {
+                int next_var = auxBase(&layout, grid_size * grid_size + r * grid_size + n);
+                encodeAtMostOne(clause, grid_size, amo_encoding, &next_var, addClause);
+            }
         }
     }
-    return NULL;
 }
 
-void* encodeColConstraints(void* arg) {
-    for (int c = 0; c < N; c++) {
-        for (int n = 0; n < N; n++) {
-            int clause[N];
-            for (int r = 0; r < N; r++) {
+// Ensure columns [first, last) have unique numbers
+void encodeColConstraints(int first, int last) {
+    clauseSliceBegin(cnf, colOffset(&layout, first, 0));
+    for (int c = first; c < last; c++) {
+        for (int n = 0; n < grid_size; n++) {
+            int clause[grid_size];
+            for (int r = 0; r < grid_size; r++) {
                 clause[r] = var(r, c, n);
             }
-            addClause(clause, N);
+            addClause(clause, grid_size);
+            if (amo_units) {
+                int next_var = auxBase(&layout, 2 * grid_size * grid_size + c * grid_size + n);
+                encodeAtMostOne(clause, grid_size, amo_encoding, &next_var, addClause);
+            }
         }
     }
-    return NULL;
 }
 
-void* encodeSubgridConstraints(void* arg) {
-    for (int box_r = 0; box_r < SUBGRID; box_r++) {
-        for (int box_c = 0; box_c < SUBGRID; box_c++) {
-            for (int n = 0; n < N; n++) {
-                int clause[N];
-                int idx = 0;
-                for (int r = 0; r < SUBGRID; r++) {
-                    for (int c = 0; c < SUBGRID; c++) {
-                        clause[idx++] = var(box_r * SUBGRID + r, box_c * SUBGRID + c, n);
-                    }
+// Ensure subgrids [first, last) (numbered row-major) have unique numbers
+void encodeSubgridConstraints(int first, int last) {
+    clauseSliceBegin(cnf, boxOffset(&layout, first, 0));
+    for (int b = first; b < last; b++) {
+        int box_r = b / block_size, box_c = b % block_size;
+        for (int n = 0; n < grid_size; n++) {
+            int clause[grid_size];
+            int idx = 0;
+            for (int r = 0; r < block_size; r++) {
+                for (int c = 0; c < block_size; c++) {
+                    clause[idx++] = var(box_r * block_size + r, box_c * block_size + c, n);
                 }
-                addClause(clause, N);
+            }
+            addClause(clause, grid_size);
+            if (amo_units) {
+                int next_var = auxBase(&layout, 3 * grid_size * grid_size + b * grid_size + n);
+                encodeAtMostOne(clause, grid_size, amo_encoding, &next_var, addClause);
             }
         }
     }
+}
+
+// Each thread encodes every constraint family for its own slice of rows,
+// columns and boxes. The slices are disjoint ranges of the flat buffer, so
+// no locking is needed.
+void* encodeWorker(void* arg) {
+    encoder_args_t* args = (encoder_args_t*) arg;
+    encodeCellConstraints(args->first, args->last);
+    encodeUniqueCellConstraints(args->first, args->last);
+    encodeRowConstraints(args->first, args->last);
+    encodeColConstraints(args->first, args->last);
+    encodeSubgridConstraints(args->first, args->last);
     return NULL;
 }
 
-// Encode the given Sudoku puzzle as CNF clauses
-void encodeSudoku(int grid[N][N]) {
-    pthread_t threads[NUM_THREADS];
+// Encode only what the givens leave open (see sat_encoder.h).
+// The reduced CNF is small enough that it is emitted from a single thread.
+bool encodeReducedSudoku(int *grid) {
+    if (!reducedInit(&reduced, grid, grid_size, block_size))
+        return false;
+    cnf = reducedEncodeFlat(&reduced, amo_encoding, amo_units, &cnf_size, &clause_count, &num_vars);
+    return true;
+}
 
-    // Create threads for different constraint encodings
-    pthread_create(&threads[0], NULL, encodeCellConstraints, NULL);
-    pthread_create(&threads[1], NULL, encodeUniqueCellConstraints, NULL);
-    pthread_create(&threads[2], NULL, encodeRowConstraints, NULL);
-    pthread_create(&threads[3], NULL, encodeColConstraints, NULL);
+// Build the structural part of the CNF, or load it from the cache file.
+// It is the same for every puzzle of this size, but this solver takes one
+// puzzle per run, so only --cache saves building it again (the batch mode of
+// sat_solver_serial reuses it in memory).
+void encodeBaseCNF() {
+    // Every family's size is known up front, see cnf_layout_t
+    cnfLayoutInit(&layout, grid_size, block_size, amo_encoding, amo_units);
+    cnf = cnfAlloc(layout.max_slots);
+    num_vars = layout.num_vars;
 
-    // Wait for threads to complete
-    for (int i = 0; i < NUM_THREADS; i++) {
-        pthread_join(threads[i], NULL);
+    char default_name[128];
+    const char *path = cache_file;
+    if (use_cache && !path) {
+        cnfCacheName(default_name, sizeof(default_name), &layout);
+        path = default_name;
     }
 
-    // Run subgrid constraints on main thread (could be parallelized further)
-    encodeSubgridConstraints(NULL);
+    if (use_cache && cnfCacheLoad(path, &layout, cnf)) {
+        printf("Loaded base CNF from %s\n", path);
+    } else {
+        pthread_t threads[NUM_THREADS];
+        encoder_args_t args[NUM_THREADS];
 
-    // Encode initial puzzle numbers
-    for (int r = 0; r < N; r++) {
-        for (int c = 0; c < N; c++) {
-            if (grid[r][c] != 0) {
-                int clause[] = {var(r, c, grid[r][c] - 1)};
-                addClause(clause, 1);
-            }
+        // Split the N rows / columns / boxes evenly across the threads
+        for (int i = 0; i < NUM_THREADS; i++) {
+            args[i].first = i * grid_size / NUM_THREADS;
+            args[i].last = (i + 1) * grid_size / NUM_THREADS;
+            pthread_create(&threads[i], NULL, encodeWorker, &args[i]);
         }
+
+        // Wait for threads to complete
+        for (int i = 0; i < NUM_THREADS; i++) {
+            pthread_join(threads[i], NULL);
+        }
+        if (use_cache)
+            cnfCacheSave(path, &layout, cnf);
     }
+    base_ready = true;
+}
+
+// Encode the given Sudoku puzzle as CNF clauses.
+// Per puzzle only the unit clauses for the givens are rewritten.
+void encodeSudoku(int *grid) {
+    if (!base_ready)
+        encodeBaseCNF();
+
+    int num_givens = encodeGivens(&layout, cnf, grid);
+    cnf_size = layout.base_slots + (size_t)num_givens * 2;
+    clause_count = layout.base_clauses + num_givens;
 }
 
 // Write the CNF formula to a file
 void writeCNF(const char *filename) {
-    FILE *file = fopen(filename, "w");
-    if (!file) {
-        perror("Error opening file");
-        exit(1);
+    writeDimacs(filename, cnf, cnf_size, num_vars, clause_count, NUM_THREADS);
+}
+
+// Fill the grid from a solver model
+void decodeModel(const signed char *model, int *grid) {
+    for (int v = 1; v <= num_vars; v++) {
+        if (model[v] <= 0)
+            continue;
+        if (reduced_encoding) {
+            reducedDecodeVar(&reduced, v, grid);
+        } else if (v <= grid_size * grid_size * grid_size) {
+            int index = v - 1;
+            grid[index / grid_size] = index % grid_size + 1;
+        }
+    }
+}
+
+typedef struct {
+    sat_portfolio_t *portfolio;
+    int id;
+} portfolio_args_t;
+
+void* portfolioThread(void* arg) {
+    portfolio_args_t *args = (portfolio_args_t *)arg;
+    portfolioWorker(args->portfolio, args->id);
+    return NULL;
+}
+
+// Race portfolio_size differently configured CDCL solvers on the CNF
+// instead of running MiniSat, and read the grid from the winner's model.
+// Returns false if there is no solution.
+bool solvePortfolio(int *grid) {
+    sat_portfolio_t portfolio;
+    portfolioInit(&portfolio, cnf, cnf_size, num_vars, portfolio_size);
+
+    pthread_t threads[portfolio_size];
+    portfolio_args_t args[portfolio_size];
+    for (int i = 0; i < portfolio_size; i++) {
+        args[i].portfolio = &portfolio;
+        args[i].id = i;
+        pthread_create(&threads[i], NULL, portfolioThread, &args[i]);
+    }
+    for (int i = 0; i < portfolio_size; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    if (portfolio.result != 10) {
+        printf("No solution exists.\n");
+        portfolioFree(&portfolio);
+        return false;
     }
+    printf("Portfolio: worker %d of %d finished first\n", portfolio.winner, portfolio_size);
+    decodeModel(portfolio.model, grid);
+    portfolioFree(&portfolio);
+    return true;
+}
+
+void* cubeThread(void* arg) {
+    cubeWorker((cube_run_t *)arg);
+    return NULL;
+}
 
-    fprintf(file, "p cnf %d %d\n", MAX_VARS, clause_count);
-    for (int i = 0; i < clause_count; i++) {
-        for (int j = 0; j < MAX_CLAUSE_SIZE && clauses[i][j] != 0; j++) {
-            fprintf(file, "%d ", clauses[i][j]);
+// Split the puzzle into cubes on the cells with the fewest candidates and
+// solve them on cube_threads threads (see sat_cube.h). Returns false if there
+// is no solution.
+bool solveCubes(int *grid) {
+    reduced_grid_t root_grid;
+    const reduced_grid_t *root = &reduced;
+    if (!reduced_encoding) {
+        if (!reducedInit(&root_grid, grid, grid_size, block_size)) {
+            printf("No solution exists.\n");
+            reducedFree(&root_grid);
+            return false;
         }
-        fprintf(file, "0\n");
+        root = &root_grid;
+    }
+
+    cube_set_t cubes;
+    cubeGenerate(root, grid_size >= CUBE_MIN_SIZE ? cube_threads * CUBES_PER_THREAD : 1, reduced_encoding, &cubes);
+    if (!reduced_encoding)
+        reducedFree(&root_grid);
+    printf("Cube and conquer: %d cubes on %d threads\n", cubes.num_cubes, cube_threads);
+
+    cube_run_t run;
+    cubeRunInit(&run, cnf, cnf_size, num_vars, &cubes);
+    pthread_t threads[cube_threads];
+    for (int i = 0; i < cube_threads; i++) {
+        pthread_create(&threads[i], NULL, cubeThread, &run);
+    }
+    for (int i = 0; i < cube_threads; i++) {
+        pthread_join(threads[i], NULL);
     }
-    fclose(file);
+
+    bool solved = cubeRunResult(&run) == 10;
+    if (solved)
+        decodeModel(run.model, grid);
+    else
+        printf("No solution exists.\n");
+    cubeRunFree(&run);
+    cubeSetFree(&cubes);
+    return solved;
 }
 
-// Solve Sudoku using MiniSat
-void solveSudoku(int grid[N][N]) {
-    pthread_mutex_init(&clause_mutex, NULL);
-    
-    encodeSudoku(grid);
+// Read MiniSat's result file into the grid. Returns false if it found no
+// solution, or left no verdict (it failed or was killed).
+bool parseSolution(const char *filename, int *grid) {
+    signed char *model = malloc(num_vars + 1);
+    if (!model) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    int status = readModel(filename, num_vars, model);
+    if (status == 1)
+        decodeModel(model, grid);
+    else
+        printf(status == 0 ? "No solution exists.\n" : "MiniSat gave no result.\n");
+    free(model);
+    return status == 1;
+}
+
+// Solve Sudoku using MiniSat. Returns false if there is no solution.
+bool solveSudoku(int *grid) {
+    if (reduced_encoding) {
+        if (!encodeReducedSudoku(grid)) {
+            printf("No solution exists.\n");
+            return false;
+        }
+        printf("Reduced encoding: %d variables, %ld clauses\n", num_vars, clause_count);
+    } else {
+        encodeSudoku(grid);
+    }
+    if (portfolio_size > 0 || cube_threads > 0) {
+        if (reduced_encoding)
+            reducedApplyFixed(&reduced, grid);
+        if (cube_threads > 0)
+            return solveCubes(grid);
+        return solvePortfolio(grid);
+    }
     writeCNF("sudoku.cnf");
 
     printf("\nRunning MiniSat...\n");
     system("minisat sudoku.cnf sudoku.out");
+    if (reduced_encoding)
+        reducedApplyFixed(&reduced, grid);
+    return parseSolution("sudoku.out", grid);
+}
 
-    pthread_mutex_destroy(&clause_mutex);
-}
-
-int main() {
-int grid[N][N] = {
-
-    {0, 2, 3, 4, 5, 6, 7, 8, 0, 10, 11, 0, 13, 14, 15, 16, 0, 18, 19, 20, 21, 22, 23, 0, 25},
-    {6, 7, 8, 9, 10, 0, 12, 0, 14, 15, 0, 17, 18, 0, 20, 21, 22, 0, 24, 25, 1, 2, 3, 4, 5},
-    {11, 12, 13, 14, 0, 16, 17, 18, 19, 0, 21, 22, 23, 24, 25, 0, 0, 3, 4, 5, 6, 7, 8, 9, 0},
-    {16, 17, 0, 19, 20, 0, 22, 23, 24, 25, 1, 2, 0, 4, 5, 6, 7, 8, 9, 10, 0, 12, 13, 14, 0},
-    {21, 22, 23, 24, 25, 0, 2, 3, 4, 0, 6, 7, 8, 0, 10, 11, 12, 13, 0, 15, 0, 17, 18, 19, 20},
-    {2, 3, 4, 5, 6, 7, 0, 9, 10, 0, 12, 13, 14, 15, 0, 17, 18, 19, 0, 21, 22, 23, 24, 25, 0},
-    {7, 8, 9, 10, 11, 0, 13, 14, 15, 16, 0, 18, 19, 20, 21, 0, 23, 24, 25, 1, 2, 3, 0, 5, 6},
-    {12, 13, 14, 15, 16, 0, 18, 19, 20, 21, 22, 0, 24, 25, 1, 2, 3, 0, 5, 6, 7, 8, 9, 0, 11},
-    {17, 18, 19, 20, 21, 0, 23, 24, 25, 1, 2, 3, 4, 0, 6, 7, 8, 9, 10, 0, 12, 13, 14, 15, 16},
-    {22, 23, 24, 25, 1, 0, 3, 4, 5, 6, 7, 8, 9, 0, 11, 12, 13, 14, 15, 0, 17, 18, 19, 20, 0},
-    {3, 4, 5, 6, 7, 0, 9, 10, 0, 12, 13, 0, 15, 16, 0, 18, 19, 20, 21, 0, 23, 24, 25, 1, 2},
-    {8, 9, 10, 11, 12, 0, 14, 15, 16, 0, 18, 19, 20, 21, 0, 23, 24, 25, 1, 0, 3, 4, 5, 6, 7},
-    {13, 14, 15, 16, 0, 18, 19, 20, 0, 22, 23, 24, 25, 0, 2, 3, 4, 5, 6, 0, 8, 9, 10, 11, 12},
-    {18, 19, 0, 21, 22, 23, 24, 25, 1, 0, 3, 4, 5, 6, 7, 0, 9, 10, 11, 12, 0, 14, 15, 16, 17},
-    {23, 24, 25, 1, 2, 0, 4, 5, 6, 7, 0, 9, 10, 11, 12, 0, 14, 15, 16, 17, 0, 19, 20, 21, 22},
-    {4, 5, 6, 7, 0, 9, 10, 11, 12, 0, 14, 15, 16, 17, 0, 19, 20, 21, 22, 0, 24, 25, 1, 2, 3},
-    {9, 10, 11, 12, 13, 0, 15, 16, 17, 0, 19, 20, 21, 22, 0, 24, 25, 1, 2, 0, 4, 5, 6, 7, 8},
-    {14, 15, 16, 17, 0, 19, 20, 21, 22, 0, 24, 25, 1, 2, 0, 4, 5, 6, 7, 0, 9, 10, 11, 12, 13},
-    {19, 20, 21, 22, 0, 24, 25, 1, 2, 0, 4, 5, 6, 7, 0, 9, 10, 11, 12, 0, 14, 15, 16, 17, 18},
-    {24, 25, 1, 2, 3, 0, 5, 6, 7, 8, 0, 10, 11, 12, 13, 0, 15, 16, 17, 18, 0, 20, 21, 22, 23},
-    {5, 6, 7, 8, 9, 0, 11, 12, 13, 14, 0, 16, 17, 18, 19, 0, 21, 22, 23, 24, 0, 1, 2, 3, 4},
-    {10, 11, 12, 13, 0, 15, 16, 17, 18, 0, 20, 21, 22, 23, 0, 25, 1, 2, 3, 0, 5, 6, 7, 8, 9},
-    {15, 16, 17, 18, 0, 20, 21, 22, 23, 0, 25, 1, 2, 3, 0, 5, 6, 7, 8, 0, 10, 11, 12, 13, 14},
-    {20, 21, 22, 23, 0, 25, 1, 2, 3, 0, 5, 6, 7, 8, 0, 10, 11, 12, 13, 0, 15, 16, 17, 18, 19},
-    {25, 1, 2, 3, 4, 0, 6, 7, 8, 9, 0, 11, 12, 13, 14, 0, 16, 17, 18, 19, 0, 21, 22, 23, 24}
-};
-
-    printf("Original Sudoku Puzzle:\n");
-    printGrid(grid);
-
-    solveSudoku(grid);
-    
-    printf("\nSolved Sudoku:\n");
-    printGrid(grid);
+int main(int argc, char *argv[]) {
+    const char *puzzle_file = NULL;
+    long puzzle_index = 0; // record to solve when the input is a puzzle set
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--reduced") == 0) {
+            reduced_encoding = true;
+        } else if (strncmp(argv[i], "--amo=", 6) == 0 && parseAmoEncoding(argv[i] + 6, &amo_encoding)) {
+            continue;
+        } else if (strcmp(argv[i], "--amo-units") == 0) {
+            amo_units = true;
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            use_cache = true;
+        } else if (strncmp(argv[i], "--cache=", 8) == 0) {
+            use_cache = true;
+            cache_file = argv[i] + 8;
+        } else if (strcmp(argv[i], "--portfolio") == 0) {
+            portfolio_size = NUM_THREADS;
+        } else if (strncmp(argv[i], "--portfolio=", 12) == 0 && atoi(argv[i] + 12) > 0) {
+            portfolio_size = atoi(argv[i] + 12);
+        } else if (strcmp(argv[i], "--cube") == 0) {
+            cube_threads = NUM_THREADS;
+        } else if (strncmp(argv[i], "--cube=", 7) == 0 && atoi(argv[i] + 7) > 0) {
+            cube_threads = atoi(argv[i] + 7);
+        } else if (output_parse_option(&output, argv[i])) {
+            continue;
+        } else if (strncmp(argv[i], "--index=", 8) == 0) {
+            puzzle_index = atol(argv[i] + 8);
+        } else if (argv[i][0] != '-' && !puzzle_file) {
+            puzzle_file = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [--reduced] [--amo=pairwise|sequential|commander|product|bimander] [--amo-units] [--cache[=file]] [--portfolio[=K]] [--cube[=K]] [--index=K] " OUTPUT_USAGE " <input_file>\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!puzzle_file) {
+        fprintf(stderr, "Usage: %s [options] <input_file>\n", argv[0]);
+        return 1;
+    }
+    int *grid = readPuzzle(puzzle_file, puzzle_index, &grid_size, &block_size);
+
+    int *puzzle = malloc((size_t)grid_size * grid_size * sizeof(int));
+    if (!puzzle) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    memcpy(puzzle, grid, (size_t)grid_size * grid_size * sizeof(int));
+    output_grid(&output, "Original Sudoku Puzzle:", grid, grid_size);
+
+    STATS_START();
+    // Timed from the encoding of the puzzle to its decoded solution, the
+    // whole solve for a SAT solver; loading and output are left out
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool solved = solveSudoku(grid);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    int status = 1;
+    if (solved) {
+        if (!output.quiet)
+            printf("\n");
+        status = !output_solution(&output, "Solved Sudoku:", puzzle, grid, grid_size, block_size);
+    }
+    print_elapsed("sat pthread", elapsed_ms(&start, &end));
+    STATS_PRINT("CDCL");
+    if (reduced_encoding)
+        reducedFree(&reduced);
+    free(cnf);
+    free(puzzle);
+    free(grid);
     
-    return 0;
+    return status;
 }
@@ -2,229 +2,488 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <time.h>
+#include "sat_encoder.h"
+#include "sat_dimacs.h"
+#include "sat_cdcl.h"
+#include "sudoku_batch.h"
+#include "sudoku_output.h"
 
-#define N 25
-#define SUBGRID 2
-#define MAX_VARS (N * N * N)  
-#define MAX_CLAUSES 300000    // Largeer puzzles need larger size 
-#define MAX_CLAUSE_SIZE 70    // Larger puzzles need larger size
+int grid_size = 0;   // N, read from the puzzle file
+int block_size = 0;  // sqrt(N), the side of a box
 
-int clauses[MAX_CLAUSES][MAX_CLAUSE_SIZE];  // CNF clauses
-int clause_count = 0;
+int *cnf = NULL;         // Flat clause buffer, each clause terminated by 0
+size_t cnf_size = 0;     // Slots in use
+long clause_count = 0;
+int num_vars = 0;
+cnf_layout_t layout;
 
-// Convert 3D Sudoku representation to SAT variable (1-based indexing)
-int var(int row, int col, int num) {
-    return (row * N * N) + (col * N) + num + 1;
-}
+output_options_t output = {0};  // Set by --quiet, --output=, --binary
 
-// Add a clause to the CNF formula
-void addClause(int literals[], int size) {
-    if (clause_count >= MAX_CLAUSES) {
-        fprintf(stderr, "Error: Exceeded maximum clause storage!\n");
-        exit(1);
-    }
-    for (int i = 0; i < size; i++) {
-        clauses[clause_count][i] = literals[i];
-    }
-    clause_count++;
-}
+bool reduced_encoding = false;  // Set by --reduced
+reduced_grid_t reduced;
 
-// Print Sudoku Grid
-void printGrid(int grid[N][N]) {
-    for (int r = 0; r < N; r++) {
-        for (int c = 0; c < N; c++) {
-            printf("%d ", grid[r][c]);
-        }
-        printf("\n");
-    }
+amo_encoding_t amo_encoding = AMO_PAIRWISE;  // Set by --amo=
+bool amo_units = false;                      // Set by --amo-units
+
+bool use_cache = false;         // Set by --cache[=file]
+const char *cache_file = NULL;  // NULL picks the default name from cnfCacheName
+bool base_ready = false;        // Structural clauses already in cnf
+
+bool incremental = false;   // Set by --incremental
+bool check_unique = false;  // Set by --unique
+bool batch = false;         // Set by --batch
+void *sat_solver = NULL;    // In-process solver holding the base CNF and what it learnt
+int next_free_var = 0;      // Next variable above the base CNF, for activation literals
+
+// Convert 3D Sudoku representation to SAT variable (1-based indexing)
+int var(int row, int col, int num) {
+    return (row * grid_size * grid_size) + (col * grid_size) + num + 1;
 }
 
 // Ensure each cell has at least one number (1-N)
 void encodeCellConstraints() {
-    for (int r = 0; r < N; r++) {
-        for (int c = 0; c < N; c++) {
-            int clause[N];
-            for (int n = 0; n < N; n++) {
+    clauseSliceBegin(cnf, layout.cell_alo_base);
+    for (int r = 0; r < grid_size; r++) {
+        for (int c = 0; c < grid_size; c++) {
+            int clause[grid_size];
+            for (int n = 0; n < grid_size; n++) {
                 clause[n] = var(r, c, n);
             }
-            addClause(clause, N);
+            addClause(clause, grid_size);
         }
     }
 }
 
 // Ensure each cell has at most one number
 void encodeUniqueCellConstraints() {
-    for (int r = 0; r < N; r++) {
-        for (int c = 0; c < N; c++) {
-            for (int n1 = 0; n1 < N; n1++) {
-                for (int n2 = n1 + 1; n2 < N; n2++) {
-                    int clause[] = {-var(r, c, n1), -var(r, c, n2)};
-                    addClause(clause, 2);
-                }
+    clauseSliceBegin(cnf, layout.cell_amo_base);
+    for (int r = 0; r < grid_size; r++) {
+        for (int c = 0; c < grid_size; c++) {
+            int cell[grid_size];
+            for (int n = 0; n < grid_size; n++) {
+                cell[n] = var(r, c, n);
             }
+            int next_var = auxBase(&layout, r * grid_size + c);
+            encodeAtMostOne(cell, grid_size, amo_encoding, &next_var, addClause);
         }
     }
 }
 
 // Ensure each row has unique numbers
 void encodeRowConstraints() {
-    for (int r = 0; r < N; r++) {
-        for (int n = 0; n < N; n++) {
-            int clause[N];
-            for (int c = 0; c < N; c++) {
+    clauseSliceBegin(cnf, layout.row_base);
+    for (int r = 0; r < grid_size; r++) {
+        for (int n = 0; n < grid_size; n++) {
+            int clause[grid_size];
+            for (int c = 0; c < grid_size; c++) {
                 clause[c] = var(r, c, n);
             }
-            addClause(clause, N);
+            addClause(clause, grid_size);
+            if (amo_units) {
+                int next_var = auxBase(&layout, grid_size * grid_size + r * grid_size + n);
+                encodeAtMostOne(clause, grid_size, amo_encoding, &next_var, addClause);
+            }
         }
     }
 }
 
 // Ensure each column has unique numbers
 void encodeColConstraints() {
-    for (int c = 0; c < N; c++) {
-        for (int n = 0; n < N; n++) {
-            int clause[N];
-            for (int r = 0; r < N; r++) {
+    clauseSliceBegin(cnf, layout.col_base);
+    for (int c = 0; c < grid_size; c++) {
+        for (int n = 0; n < grid_size; n++) {
+            int clause[grid_size];
+            for (int r = 0; r < grid_size; r++) {
                 clause[r] = var(r, c, n);
             }
-            addClause(clause, N);
+            addClause(clause, grid_size);
+            if (amo_units) {
+                int next_var = auxBase(&layout, 2 * grid_size * grid_size + c * grid_size + n);
+                encodeAtMostOne(clause, grid_size, amo_encoding, &next_var, addClause);
+            }
         }
     }
 }
 
 // Ensure each sqrtN x sqrtN subgrid has unique numbers
 void encodeSubgridConstraints() {
-    for (int box_r = 0; box_r < SUBGRID; box_r++) {
-        for (int box_c = 0; box_c < SUBGRID; box_c++) {
-            for (int n = 0; n < N; n++) {
-                int clause[N];
+    clauseSliceBegin(cnf, layout.box_base);
+    for (int box_r = 0; box_r < block_size; box_r++) {
+        for (int box_c = 0; box_c < block_size; box_c++) {
+            for (int n = 0; n < grid_size; n++) {
+                int clause[grid_size];
                 int idx = 0;
-                for (int r = 0; r < SUBGRID; r++) {
-                    for (int c = 0; c < SUBGRID; c++) {
-                        clause[idx++] = var(box_r * SUBGRID + r, box_c * SUBGRID + c, n);
+                for (int r = 0; r < block_size; r++) {
+                    for (int c = 0; c < block_size; c++) {
+                        clause[idx++] = var(box_r * block_size + r, box_c * block_size + c, n);
                     }
                 }
-                addClause(clause, N);
+                addClause(clause, grid_size);
+                if (amo_units) {
+                    int next_var = auxBase(&layout, 3 * grid_size * grid_size + (box_r * block_size + box_c) * grid_size + n);
+                    encodeAtMostOne(clause, grid_size, amo_encoding, &next_var, addClause);
+                }
             }
         }
     }
 }
 
-// Encode the given Sudoku puzzle as CNF clauses
-void encodeSudoku(int grid[N][N]) {
-    encodeCellConstraints();
-    encodeUniqueCellConstraints();
-    encodeRowConstraints();
-    encodeColConstraints();
-    encodeSubgridConstraints();
+// Encode only what the givens leave open (see sat_encoder.h).
+// Returns false if propagating the givens already proves the puzzle unsolvable.
+bool encodeReducedSudoku(int *grid) {
+    if (!reducedInit(&reduced, grid, grid_size, block_size))
+        return false;
+    cnf = reducedEncodeFlat(&reduced, amo_encoding, amo_units, &cnf_size, &clause_count, &num_vars);
+    return true;
+}
 
-    // Encode the initial numbers from the puzzle
-    for (int r = 0; r < N; r++) {
-        for (int c = 0; c < N; c++) {
-            if (grid[r][c] != 0) {
-                int clause[] = {var(r, c, grid[r][c] - 1)};
-                addClause(clause, 1);
-            }
-        }
+// Build the structural part of the CNF, or load it from the cache file.
+// It is the same for every puzzle of this size, so a --batch run builds it
+// once and then only rewrites the givens (encodeSudoku); --cache saves the
+// work across runs.
+void encodeBaseCNF() {
+    // Every family's size is known up front, see cnf_layout_t
+    cnfLayoutInit(&layout, grid_size, block_size, amo_encoding, amo_units);
+    cnf = cnfAlloc(layout.max_slots);
+    num_vars = layout.num_vars;
+
+    char default_name[128];
+    const char *path = cache_file;
+    if (use_cache && !path) {
+        cnfCacheName(default_name, sizeof(default_name), &layout);
+        path = default_name;
     }
+
+    if (use_cache && cnfCacheLoad(path, &layout, cnf)) {
+        printf("Loaded base CNF from %s\n", path);
+    } else {
+        encodeCellConstraints();
+        encodeUniqueCellConstraints();
+        encodeRowConstraints();
+        encodeColConstraints();
+        encodeSubgridConstraints();
+        if (use_cache)
+            cnfCacheSave(path, &layout, cnf);
+    }
+    base_ready = true;
+}
+
+// Encode the given Sudoku puzzle as CNF clauses.
+// Per puzzle only the unit clauses for the givens are rewritten.
+void encodeSudoku(int *grid) {
+    if (!base_ready)
+        encodeBaseCNF();
+
+    int num_givens = encodeGivens(&layout, cnf, grid);
+    cnf_size = layout.base_slots + (size_t)num_givens * 2;
+    clause_count = layout.base_clauses + num_givens;
 }
 
 // Write the CNF formula to a file
 void writeCNF(const char *filename) {
-    FILE *file = fopen(filename, "w");
-    if (!file) {
-        perror("Error opening file");
+    writeDimacs(filename, cnf, cnf_size, num_vars, clause_count, 1);
+}
+
+// Parse MiniSat output and extract solution. Returns false if MiniSat found
+// none, or left no verdict (it failed or was killed).
+bool parseSolution(const char *filename, int *grid) {
+    signed char *model = malloc(num_vars + 1);
+    if (!model) {
+        perror("Memory allocation failed");
         exit(1);
     }
 
-    fprintf(file, "p cnf %d %d\n", MAX_VARS, clause_count);
-    for (int i = 0; i < clause_count; i++) {
-        for (int j = 0; j < MAX_CLAUSE_SIZE && clauses[i][j] != 0; j++) {
-            fprintf(file, "%d ", clauses[i][j]);
+    int status = readModel(filename, num_vars, model);
+    if (status != 1) {
+        printf(status == 0 ? "No solution exists.\n" : "MiniSat gave no result.\n");
+        free(model);
+        return false;
+    }
+    for (int v = 1; v <= num_vars; v++) {
+        if (model[v] <= 0)
+            continue;
+        if (reduced_encoding) {
+            reducedDecodeVar(&reduced, v, grid);
+        } else if (v <= grid_size * grid_size * grid_size) {
+            int index = v - 1;
+            grid[index / grid_size] = index % grid_size + 1;
+        }
+    }
+    free(model);
+    return true;
+}
+
+// Load the base CNF into the in-process solver the first time it is needed
+void initIncrementalSolver() {
+    if (!base_ready)
+        encodeBaseCNF();
+    sat_solver = ipasir_init();
+    for (size_t i = 0; i < layout.base_slots; i++)
+        ipasir_add(sat_solver, cnf[i]);
+    next_free_var = layout.num_vars + 1;
+}
+
+// The givens only hold for the next solve, so nothing puzzle-specific
+// stays in the solver
+void assumeGivens(int *grid) {
+    for (int r = 0; r < grid_size; r++) {
+        for (int c = 0; c < grid_size; c++) {
+            if (grid[r * grid_size + c] != 0)
+                ipasir_assume(sat_solver, var(r, c, grid[r * grid_size + c] - 1));
         }
-        fprintf(file, "0\n");
     }
-    fclose(file);
 }
 
-// Parse MiniSat output and extract solution
-void parseSolution(const char *filename, int grid[N][N]) {
-    FILE *file = fopen(filename, "r");
-    if (!file) {
-        perror("Error opening MiniSat output");
-        exit(1);
+// Check that no other solution exists by blocking the one found. The
+// blocking clause is guarded by a fresh activation literal and retired with
+// a unit clause afterwards, so it does not constrain later puzzles.
+bool isUniqueSolution(int *grid, int *solution) {
+    int act = next_free_var++;
+    ipasir_add(sat_solver, -act);
+    for (int r = 0; r < grid_size; r++) {
+        for (int c = 0; c < grid_size; c++) {
+            if (grid[r * grid_size + c] == 0)
+                ipasir_add(sat_solver, -var(r, c, solution[r * grid_size + c] - 1));
+        }
     }
+    ipasir_add(sat_solver, 0);
 
-    char buffer[1024];
-    while (fgets(buffer, sizeof(buffer), file)) {
-        if (strncmp(buffer, "UNSAT", 5) == 0) {
-            printf("No solution exists.\n");
-            fclose(file);
-            return;
-        }
-        if (buffer[0] == 'v') {
-            char *token = strtok(buffer + 2, " ");
-            while (token) {
-                int v = atoi(token);
-                if (v > 0) {
-                    int index = v - 1;
-                    int r = index / (N * N);
-                    int c = (index / N) % N;
-                    int n = index % N;
-                    grid[r][c] = n + 1;
-                }
-                token = strtok(NULL, " ");
+    assumeGivens(grid);
+    ipasir_assume(sat_solver, act);
+    int result = ipasir_solve(sat_solver);
+
+    ipasir_add(sat_solver, -act);
+    ipasir_add(sat_solver, 0);
+    return result == 20;
+}
+
+// Solve with the in-process solver instead of MiniSat. The base CNF is added
+// once and the givens are passed as assumptions, so with --batch clauses
+// learnt on one puzzle carry over to the next. If unique is not NULL it is
+// set to whether the solution is the only one. Returns false if there is no
+// solution.
+bool solveIncremental(int *grid, bool *unique) {
+    if (!sat_solver)
+        initIncrementalSolver();
+
+    assumeGivens(grid);
+    if (ipasir_solve(sat_solver) != 10)
+        return false;
+
+    size_t grid_bytes = (size_t)grid_size * grid_size * sizeof(int);
+    int *solution = malloc(grid_bytes);
+    if (!solution) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    for (int r = 0; r < grid_size; r++) {
+        for (int c = 0; c < grid_size; c++) {
+            for (int n = 0; n < grid_size; n++) {
+                if (ipasir_val(sat_solver, var(r, c, n)) > 0)
+                    solution[r * grid_size + c] = n + 1;
             }
         }
     }
-    fclose(file);
+
+    if (unique)
+        *unique = isUniqueSolution(grid, solution);
+    memcpy(grid, solution, grid_bytes);
+    free(solution);
+    return true;
 }
 
-// Solve Sudoku using MiniSat
-void solveSudoku(int grid[N][N]) {
-    encodeSudoku(grid);
+// Run command (MiniSat on sudoku.cnf) on the CNF in cnf and read the grid
+// from its result. Returns false if there is no solution.
+bool solveMiniSat(int *grid, const char *command) {
     writeCNF("sudoku.cnf");
+    system(command);
+    return parseSolution("sudoku.out", grid);
+}
+
+// Solve Sudoku using MiniSat. Returns false if there is no solution.
+bool solveSudoku(int *grid) {
+    if (incremental) {
+        bool unique;
+        if (!solveIncremental(grid, check_unique ? &unique : NULL)) {
+            printf("No solution exists.\n");
+            return false;
+        }
+        if (check_unique)
+            printf(unique ? "Solution is unique.\n" : "Puzzle has more than one solution.\n");
+        return true;
+    }
+    if (reduced_encoding) {
+        if (!encodeReducedSudoku(grid)) {
+            printf("No solution exists.\n");
+            return false;
+        }
+        reducedApplyFixed(&reduced, grid);
+        printf("Reduced encoding: %d variables, %ld clauses\n", num_vars, clause_count);
+        if (num_vars == 0)
+            return true; // Propagation alone solved the puzzle
+    } else {
+        encodeSudoku(grid);
+    }
+    return solveMiniSat(grid, "minisat sudoku.cnf sudoku.out");
+}
+
+// Solve every puzzle of a batch file (see sudoku_batch.h) and report
+// throughput and latency. With --incremental one in-process solver is kept,
+// so what it learnt on one puzzle helps with the next; otherwise the base
+// CNF is built once and each puzzle only rewrites its givens before MiniSat
+// runs. Solutions go to output.file if it is set.
+int solveBatch(const char *filename) {
+    batch_reader_t reader;
+    if (!batch_open(&reader, filename))
+        return 1;
+    FILE *out = NULL;
+    if (output.file) {
+        out = fopen(output.file, "wb");
+        if (!out) {
+            perror("Error opening output file");
+            batch_close(&reader);
+            return 1;
+        }
+        batch_begin_output(out, &reader);
+    }
 
-    system("minisat sudoku.cnf sudoku.out");
-
-    parseSolution("sudoku.out", grid);
-}
-
-
-int main() {
-int grid[N][N] = {
-
-    {0, 2, 3, 4, 5, 6, 7, 8, 0, 10, 11, 0, 13, 14, 15, 16, 0, 18, 19, 20, 21, 22, 23, 0, 25},
-    {6, 7, 8, 9, 10, 0, 12, 0, 14, 15, 0, 17, 18, 0, 20, 21, 22, 0, 24, 25, 1, 2, 3, 4, 5},
-    {11, 12, 13, 14, 0, 16, 17, 18, 19, 0, 21, 22, 23, 24, 25, 0, 0, 3, 4, 5, 6, 7, 8, 9, 0},
-    {16, 17, 0, 19, 20, 0, 22, 23, 24, 25, 1, 2, 0, 4, 5, 6, 7, 8, 9, 10, 0, 12, 13, 14, 0},
-    {21, 22, 23, 24, 25, 0, 2, 3, 4, 0, 6, 7, 8, 0, 10, 11, 12, 13, 0, 15, 0, 17, 18, 19, 20},
-    {2, 3, 4, 5, 6, 7, 0, 9, 10, 0, 12, 13, 14, 15, 0, 17, 18, 19, 0, 21, 22, 23, 24, 25, 0},
-    {7, 8, 9, 10, 11, 0, 13, 14, 15, 16, 0, 18, 19, 20, 21, 0, 23, 24, 25, 1, 2, 3, 0, 5, 6},
-    {12, 13, 14, 15, 16, 0, 18, 19, 20, 21, 22, 0, 24, 25, 1, 2, 3, 0, 5, 6, 7, 8, 9, 0, 11},
-    {17, 18, 19, 20, 21, 0, 23, 24, 25, 1, 2, 3, 4, 0, 6, 7, 8, 9, 10, 0, 12, 13, 14, 15, 16},
-    {22, 23, 24, 25, 1, 0, 3, 4, 5, 6, 7, 8, 9, 0, 11, 12, 13, 14, 15, 0, 17, 18, 19, 20, 0},
-    {3, 4, 5, 6, 7, 0, 9, 10, 0, 12, 13, 0, 15, 16, 0, 18, 19, 20, 21, 0, 23, 24, 25, 1, 2},
-    {8, 9, 10, 11, 12, 0, 14, 15, 16, 0, 18, 19, 20, 21, 0, 23, 24, 25, 1, 0, 3, 4, 5, 6, 7},
-    {13, 14, 15, 16, 0, 18, 19, 20, 0, 22, 23, 24, 25, 0, 2, 3, 4, 5, 6, 0, 8, 9, 10, 11, 12},
-    {18, 19, 0, 21, 22, 23, 24, 25, 1, 0, 3, 4, 5, 6, 7, 0, 9, 10, 11, 12, 0, 14, 15, 16, 17},
-    {23, 24, 25, 1, 2, 0, 4, 5, 6, 7, 0, 9, 10, 11, 12, 0, 14, 15, 16, 17, 0, 19, 20, 21, 22},
-    {4, 5, 6, 7, 0, 9, 10, 11, 12, 0, 14, 15, 16, 17, 0, 19, 20, 21, 22, 0, 24, 25, 1, 2, 3},
-    {9, 10, 11, 12, 13, 0, 15, 16, 17, 0, 19, 20, 21, 22, 0, 24, 25, 1, 2, 0, 4, 5, 6, 7, 8},
-    {14, 15, 16, 17, 0, 19, 20, 21, 22, 0, 24, 25, 1, 2, 0, 4, 5, 6, 7, 0, 9, 10, 11, 12, 13},
-    {19, 20, 21, 22, 0, 24, 25, 1, 2, 0, 4, 5, 6, 7, 0, 9, 10, 11, 12, 0, 14, 15, 16, 17, 18},
-    {24, 25, 1, 2, 3, 0, 5, 6, 7, 8, 0, 10, 11, 12, 13, 0, 15, 16, 17, 18, 0, 20, 21, 22, 23},
-    {5, 6, 7, 8, 9, 0, 11, 12, 13, 14, 0, 16, 17, 18, 19, 0, 21, 22, 23, 24, 0, 1, 2, 3, 4},
-    {10, 11, 12, 13, 0, 15, 16, 17, 18, 0, 20, 21, 22, 23, 0, 25, 1, 2, 3, 0, 5, 6, 7, 8, 9},
-    {15, 16, 17, 18, 0, 20, 21, 22, 23, 0, 25, 1, 2, 3, 0, 5, 6, 7, 8, 0, 10, 11, 12, 13, 14},
-    {20, 21, 22, 23, 0, 25, 1, 2, 3, 0, 5, 6, 7, 8, 0, 10, 11, 12, 13, 0, 15, 16, 17, 18, 19},
-    {25, 1, 2, 3, 4, 0, 6, 7, 8, 9, 0, 11, 12, 13, 14, 0, 16, 17, 18, 19, 0, 21, 22, 23, 24}
-};
-
-
-
-    solveSudoku(grid);
-    printf("\nSolved Sudoku:\n");
-    printGrid(grid);
+    size_t cells = batch_max_cells(&reader);
+    int *puzzle = malloc(cells * sizeof(int));
+    int *grid = malloc(cells * sizeof(int));
+    if (!puzzle || !grid) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+
+    batch_stats_t stats = {0};
+    long unique_count = 0;
+    double start = batch_now();
+    STATS_START();
+    int status;
+    while ((status = batch_next(&reader, puzzle)) != 0) {
+        if (status < 0) {
+            stats.invalid++;
+            if (out)
+                batch_write_result(out, &reader, puzzle, NULL, reader.line, reader.line_len);
+            continue;
+        }
+        // Every puzzle of a batch has the size of the first
+        grid_size = reader.grid_size;
+        block_size = reader.block_size;
+        memcpy(grid, puzzle, (size_t)grid_size * grid_size * sizeof(int));
+        double t = batch_now();
+        bool unique = false;
+        bool solved;
+        if (incremental) {
+            solved = solveIncremental(grid, check_unique ? &unique : NULL);
+        } else {
+            encodeSudoku(grid);
+            solved = solveMiniSat(grid, "minisat -verb=0 sudoku.cnf sudoku.out > /dev/null");
+        }
+        batch_record(&stats, batch_now() - t, solved);
+        unique_count += unique;
+        if (out)
+            batch_write_result(out, &reader, puzzle, solved ? grid : NULL, reader.line, reader.line_len);
+    }
+    double elapsed = batch_now() - start;
+
+    if (out && fclose(out) != 0) {
+        perror("Error writing output file");
+        return 1;
+    }
+    batch_close(&reader);
+    free(puzzle);
+    free(grid);
+    batch_report(&stats, elapsed, "sat");
+    if (check_unique)
+        printf("%ld of %ld solved puzzles have a unique solution\n", unique_count, stats.solved);
+    STATS_PRINT("batch");
     return 0;
 }
+
+int main(int argc, char *argv[]) {
+    const char *puzzle_file = NULL;
+    long puzzle_index = 0; // record to solve when the input is a puzzle set
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--reduced") == 0) {
+            reduced_encoding = true;
+        } else if (strncmp(argv[i], "--amo=", 6) == 0 && parseAmoEncoding(argv[i] + 6, &amo_encoding)) {
+            continue;
+        } else if (strcmp(argv[i], "--amo-units") == 0) {
+            amo_units = true;
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            use_cache = true;
+        } else if (strncmp(argv[i], "--cache=", 8) == 0) {
+            use_cache = true;
+            cache_file = argv[i] + 8;
+        } else if (strcmp(argv[i], "--incremental") == 0) {
+            incremental = true;
+        } else if (strcmp(argv[i], "--unique") == 0) {
+            incremental = true;
+            check_unique = true;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        } else if (output_parse_option(&output, argv[i])) {
+            continue;
+        } else if (strncmp(argv[i], "--index=", 8) == 0) {
+            puzzle_index = atol(argv[i] + 8);
+        } else if (argv[i][0] != '-' && !puzzle_file) {
+            puzzle_file = argv[i];
+        } else {
+            fprintf(stderr, "Usage: %s [--reduced] [--amo=pairwise|sequential|commander|product|bimander] [--amo-units] [--cache[=file]] [--incremental] [--unique] [--index=K] " OUTPUT_USAGE " <input_file>\n", argv[0]);
+            fprintf(stderr, "       %s --batch [--incremental] [--amo=...] [--amo-units] [--cache[=file]] [--unique] [--output=file] <batch_file>\n", argv[0]);
+            return 1;
+        }
+    }
+    if (!puzzle_file) {
+        fprintf(stderr, "Usage: %s [options] <input_file>\n", argv[0]);
+        return 1;
+    }
+    if (incremental && reduced_encoding) {
+        fprintf(stderr, "--reduced depends on the givens and cannot be combined with --incremental\n");
+        return 1;
+    }
+    if (batch) {
+        if (reduced_encoding) {
+            fprintf(stderr, "--reduced encodes every puzzle from scratch and cannot be combined with --batch\n");
+            return 1;
+        }
+        int status = solveBatch(puzzle_file);
+        if (sat_solver)
+            ipasir_release(sat_solver);
+        free(cnf);
+        return status;
+    }
+
+    int *grid = readPuzzle(puzzle_file, puzzle_index, &grid_size, &block_size);
+    int *puzzle = malloc((size_t)grid_size * grid_size * sizeof(int));
+    if (!puzzle) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    memcpy(puzzle, grid, (size_t)grid_size * grid_size * sizeof(int));
+    STATS_START();
+    // Timed from the encoding of the puzzle to its decoded solution, the
+    // whole solve for a SAT solver; loading and output are left out
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bool solved = solveSudoku(grid);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    int status = 1;
+    if (solved) {
+        if (!output.quiet)
+            printf("\n");
+        status = !output_solution(&output, "Solved Sudoku:", puzzle, grid, grid_size, block_size);
+    }
+    print_elapsed("sat", elapsed_ms(&start, &end));
+    STATS_PRINT("CDCL");
+    if (reduced_encoding)
+        reducedFree(&reduced);
+    if (sat_solver)
+        ipasir_release(sat_solver);
+    free(cnf);
+    free(puzzle);
+    free(grid);
+    return status;
+}
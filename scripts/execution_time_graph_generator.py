@@ -1,58 +1,99 @@
+import argparse
+import csv
+import json
+from collections import defaultdict
+
 import matplotlib.pyplot as plt
 import numpy as np
 
-sudoku_types = [
-    "9x9_easy", 
-    "9x9_medium", 
-    "16x16_easy",
-    "16x16_medium", 
-    "25x25_easy", 
-    "25x25_medium",
-    "25x25_hard"
-]
+# Plots the results of sudoku_benchmark.exe: one line per backend (and per
+# thread count for OpenMP) with the median time of every input, and error
+# bars up to the p95 time. Timed-out or failed runs are left out.
 
-# please use this order
-# [9x9_easy, 9x9_medium, 16x16_easy, 16x16_medium, 25x25_easy, 25x25_medium, 25x25_hard]
-serial_times = [
-    [0.00005, 0.00027, 11.7087, 45.82583, 68, 295, 1431], # testing 1
+INPUT_ORDER = [
+    "9x9_easy", "9x9_medium", "9x9_hard",
+    "16x16_easy", "16x16_medium", "16x16_hard",
+    "25x25_easy", "25x25_medium", "25x25_hard",
+    "builtin",
 ]
-openmp2_times = [
-    [0.00019,0.00049,11.75687,44.89533,61,86, 1262],
-    ]
-openmp4_times = [
-    [0.0003, 0.00047,11.68618, 45.907, 28.8557, 56.63862, 1276],
-                 ]
-openmp6_times = [
-    [0.00057,0.0005,11.27572,44.73033,28.45861,56.502,1292],
-    ]
-openmp8_times = [
-    [0.00047, 0.00056, 11.2521,45.14718, 29.52103, 48.47616, 1261],
-    ]
-
-# calculting avgs
-serial_times   = [sum(times)/len(times) for times in zip(*serial_times)]
-openmp2_times  = [sum(times)/len(times) for times in zip(*openmp2_times)]
-openmp4_times  = [sum(times)/len(times) for times in zip(*openmp4_times)]
-openmp6_times  = [sum(times)/len(times) for times in zip(*openmp6_times)]
-openmp8_times  = [sum(times)/len(times) for times in zip(*openmp8_times)]
-
-
-x = np.arange(len(sudoku_types))
-plt.figure(figsize=(10, 6))
-
-plt.plot(x, serial_times, marker='o', label='Serial')
-plt.plot(x, openmp2_times, marker='o', label='OpenMP (2 threads)')
-plt.plot(x, openmp4_times, marker='o', label='OpenMP (4 threads)')
-plt.plot(x, openmp6_times, marker='o', label='OpenMP (6 threads)')
-plt.plot(x, openmp8_times, marker='o', label='OpenMP (8 threads)')
-
-plt.xticks(x, sudoku_types)
-plt.xlabel('Sudoku Types')
-plt.ylabel('Execution Time (seconds)')
-plt.title('Execution Time of Solving Sudoku Puzzles')
-plt.legend()
-
-plt.tight_layout()
-plt.savefig("omp_execution_time_graph.png")
-
-plt.show()
+
+
+def read_results(file_path):
+    """
+    Reads the CSV or JSON file written by sudoku_benchmark.exe and returns
+    the rows that finished, as dicts with numeric fields converted.
+    """
+    if file_path.endswith(".json"):
+        with open(file_path) as f:
+            rows = json.load(f)["results"]
+    else:
+        with open(file_path, newline="") as f:
+            rows = list(csv.DictReader(f))
+
+    results = []
+    for row in rows:
+        if row["status"] != "ok":
+            continue
+        results.append({
+            "backend": row["backend"],
+            "threads": int(row["threads"]),
+            "procs": int(row["procs"]),
+            "input": row["input"],
+            "median": float(row["median_s"]),
+            "p95": float(row["p95_s"]),
+        })
+    return results
+
+
+def series_label(backend, threads, procs):
+    if threads > 0:
+        return f"{backend} ({threads} threads)"
+    if procs > 1:
+        return f"{backend} ({procs} ranks)"
+    return backend
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Plot the execution times measured by sudoku_benchmark.exe.")
+    parser.add_argument("results", nargs="?", default="benchmark.csv", help="CSV or JSON file from the benchmark")
+    parser.add_argument("--output", default="execution_time_graph.png", help="image to write")
+    parser.add_argument("--log", action="store_true", help="logarithmic time axis")
+    parser.add_argument("--no-show", action="store_true", help="only write the image")
+    args = parser.parse_args()
+
+    results = read_results(args.results)
+    if not results:
+        raise SystemExit(f"No finished runs in {args.results}.")
+
+    inputs = sorted({r["input"] for r in results},
+                    key=lambda name: INPUT_ORDER.index(name) if name in INPUT_ORDER else len(INPUT_ORDER))
+    series = defaultdict(dict)
+    for r in results:
+        series[(r["backend"], r["threads"], r["procs"])][r["input"]] = r
+
+    x = np.arange(len(inputs))
+    plt.figure(figsize=(10, 6))
+    for (backend, threads, procs), by_input in sorted(series.items()):
+        xs = [i for i, name in enumerate(inputs) if name in by_input]
+        medians = [by_input[inputs[i]]["median"] for i in xs]
+        above = [by_input[inputs[i]]["p95"] - by_input[inputs[i]]["median"] for i in xs]
+        plt.errorbar(xs, medians, yerr=[[0] * len(xs), above], marker='o', capsize=3,
+                     label=series_label(backend, threads, procs))
+
+    plt.xticks(x, inputs, rotation=30)
+    plt.xlabel('Sudoku Types')
+    plt.ylabel('Execution Time (seconds, median; bars to p95)')
+    if args.log:
+        plt.yscale('log')
+    plt.title('Execution Time of Solving Sudoku Puzzles')
+    plt.legend()
+
+    plt.tight_layout()
+    plt.savefig(args.output)
+
+    if not args.no_show:
+        plt.show()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,29 @@
+import argparse
+import json
+
+# Joins the trace files written by the MPI solver built with -DSOLVER_TRACE
+# (one per rank, trace.<rank>.json) into one file, so the ranks show up as
+# separate processes on a single timeline. See sudoku_trace.h.
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Merge per-rank Chrome trace files into one.")
+    parser.add_argument("traces", nargs="+", help="trace files, e.g. trace.*.json")
+    parser.add_argument("--output", default="trace.json", help="merged file to write")
+    args = parser.parse_args()
+
+    events = []
+    dropped = 0
+    for path in args.traces:
+        with open(path) as f:
+            trace = json.load(f)
+        events.extend(trace["traceEvents"])
+        dropped += trace.get("otherData", {}).get("dropped", 0)
+
+    with open(args.output, "w") as f:
+        json.dump({"displayTimeUnit": "ms", "traceEvents": events, "otherData": {"dropped": dropped}}, f)
+    print(f"Merged {len(args.traces)} files, {len(events)} events into {args.output}")
+
+
+if __name__ == "__main__":
+    main()
@@ -1,5 +1,10 @@
 import math
 import argparse
+import struct
+
+PUZZLE_SET_MAGIC = b"SUDOKUB1"
+PUZZLE_SET_HEADER = struct.Struct("<8sIIQII")  # see sudoku_loader.h
+PUZZLE_SET_SOLUTIONS = 1
 
 def read_sudoku_from_file(file_path):
     """
@@ -32,6 +37,64 @@ def read_sudoku_from_file(file_path):
     board = [numbers[i * n:(i + 1) * n] for i in range(n)]
     return board, n, subgrid_size
 
+def read_puzzle_set(file_path):
+    """
+    Reads a binary puzzle set (.sdkb, see sudoku_loader.h) and yields
+    (puzzle, solution) board pairs. solution is None if the set only holds
+    puzzles.
+
+    Raises:
+        ValueError: If the header is not valid or the file size does not match it.
+    """
+    with open(file_path, 'rb') as f:
+        data = f.read()
+    if len(data) < PUZZLE_SET_HEADER.size:
+        raise ValueError("File is too short for a puzzle set header.")
+    magic, n, subgrid_size, count, cell_width, flags = PUZZLE_SET_HEADER.unpack_from(data)
+    if magic != PUZZLE_SET_MAGIC or subgrid_size * subgrid_size != n or cell_width not in (1, 2):
+        raise ValueError("Not a valid puzzle set header.")
+
+    grid_bytes = n * n * cell_width
+    has_solutions = flags & PUZZLE_SET_SOLUTIONS
+    record_size = grid_bytes * (2 if has_solutions else 1)
+    if len(data) != PUZZLE_SET_HEADER.size + count * record_size:
+        raise ValueError(f"File size does not match the {count} records of the header.")
+
+    cell_format = "<%d%s" % (n * n, "B" if cell_width == 1 else "H")
+    def board_at(offset):
+        cells = struct.unpack_from(cell_format, data, offset)
+        return [list(cells[i * n:(i + 1) * n]) for i in range(n)]
+
+    for index in range(count):
+        offset = PUZZLE_SET_HEADER.size + index * record_size
+        puzzle = board_at(offset)
+        solution = board_at(offset + grid_bytes) if has_solutions else None
+        yield puzzle, solution, n, subgrid_size
+
+def matches_givens(puzzle, solution):
+    """Returns True if solution keeps every given of puzzle."""
+    return all(given == 0 or given == value
+               for puzzle_row, solution_row in zip(puzzle, solution)
+               for given, value in zip(puzzle_row, solution_row))
+
+def verify_puzzle_set(file_path):
+    """
+    Checks every record of a puzzle set: its solution must be valid and keep
+    the givens of its puzzle. Records without a solution are checked as
+    complete grids.
+    """
+    total = invalid = 0
+    for index, (puzzle, solution, n, subgrid_size) in enumerate(read_puzzle_set(file_path)):
+        total += 1
+        board = solution if solution is not None else puzzle
+        if not is_valid_sudoku(board, n, subgrid_size):
+            print(f"Record {index} is not a valid solution.")
+            invalid += 1
+        elif solution is not None and not matches_givens(puzzle, solution):
+            print(f"Record {index}: the solution does not match the givens of its puzzle.")
+            invalid += 1
+    print(f"{total - invalid} of {total} records in the puzzle set are valid.")
+
 def is_valid_sudoku(board, n, subgrid_size):
     """
     Checks if the given sudoku board is a valid solution.
@@ -75,11 +138,15 @@ def is_valid_sudoku(board, n, subgrid_size):
 
 def main():
     parser = argparse.ArgumentParser(
-        description="Verify a sudoku solution from a file. The file must contain a perfect square number of integers (n*n), where n is the grid size."
+        description="Verify a sudoku solution from a file. The file must contain a perfect square number of integers (n*n), where n is the grid size, or be a binary puzzle set (.sdkb)."
     )
     parser.add_argument("input_file", help="Path to the input file")
     args = parser.parse_args()
     try:
+        with open(args.input_file, 'rb') as f:
+            if f.read(len(PUZZLE_SET_MAGIC)) == PUZZLE_SET_MAGIC:
+                verify_puzzle_set(args.input_file)
+                return
         board, n, subgrid_size = read_sudoku_from_file(args.input_file)
         count = {}
         for i in board[0]:
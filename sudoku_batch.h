@@ -0,0 +1,329 @@
+#ifndef SUDOKU_BATCH_H
+#define SUDOKU_BATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "sudoku_loader.h"
+
+// Batch input for the backtracking solvers.
+//
+// A batch file is either a puzzle set (sudoku_loader.h) or a text file with
+// one puzzle per line, the layout public benchmark collections use: n * n
+// characters row by row, a digit for a given and '.' or '0' for a blank, so
+// 81 characters for 9x9. Anything after the first ',' is ignored, which
+// takes the "puzzle,solution" lines of a generator corpus as they are, and
+// so are blank lines and lines starting with '#'. The grid size comes from
+// the first puzzle line; only grids with single-digit cells (n <= 9) fit
+// the layout.
+//
+// The file is mmapped and read one puzzle at a time, so batches of any size
+// are streamed. Results can be written in the input's layout: a solution
+// line per puzzle line, or a puzzle set with the solutions. A puzzle that is
+// not solved is written back as it was read, so the output lines up with
+// the input.
+
+#define BATCH_MAX_LINE_SIZE 9 // largest n for one character per cell
+
+typedef struct
+{
+    const char *filename;
+    const char *data;
+    size_t size;
+    int is_set;
+    puzzle_set_t set;
+    long next_record; // set: next record to read
+    size_t pos;       // text: offset of the next line
+    long line_number; // text: line of the puzzle just read
+    const char *line; // text: that line, up to but not including the newline
+    size_t line_len;
+    int grid_size; // 0 for a text file until its first puzzle line
+    int block_size;
+} batch_reader_t;
+
+typedef struct
+{
+    double *latency; // seconds per solved or unsolved puzzle
+    long count;
+    long capacity;
+    long solved;
+    long invalid; // lines that were not a puzzle
+} batch_stats_t;
+
+static inline double batch_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Map filename for reading. Returns 0 after printing an error.
+static inline int batch_open(batch_reader_t *reader, const char *filename)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->filename = filename;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("Error opening file");
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        perror("Error reading file");
+        close(fd);
+        return 0;
+    }
+    reader->size = st.st_size;
+    if (reader->size == 0)
+    {
+        close(fd);
+        return 1; // an empty batch
+    }
+    reader->data = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (reader->data == MAP_FAILED)
+    {
+        perror("Error mapping file");
+        return 0;
+    }
+    madvise((void *)reader->data, reader->size, MADV_SEQUENTIAL);
+
+    if (reader->size >= 8 && memcmp(reader->data, PUZZLE_SET_MAGIC, 8) == 0)
+    {
+        if (!puzzle_set_from_mapping((const unsigned char *)reader->data, reader->size, filename, &reader->set))
+        {
+            munmap((void *)reader->data, reader->size);
+            return 0;
+        }
+        reader->is_set = 1;
+        reader->grid_size = reader->set.grid_size;
+        reader->block_size = reader->set.block_size;
+    }
+    return 1;
+}
+
+static inline void batch_close(batch_reader_t *reader)
+{
+    if (reader->size > 0)
+    {
+        munmap((void *)reader->data, reader->size);
+    }
+}
+
+// Cells a grid from this reader can have
+static inline size_t batch_max_cells(const batch_reader_t *reader)
+{
+    if (reader->is_set)
+    {
+        return (size_t)reader->grid_size * reader->grid_size;
+    }
+    return BATCH_MAX_LINE_SIZE * BATCH_MAX_LINE_SIZE;
+}
+
+// Parse the puzzle field of the current line into grid. Returns 0 if it is
+// not a puzzle of the batch's grid size.
+static inline int batch_parse_line(batch_reader_t *reader, int *grid)
+{
+    size_t len = 0;
+    while (len < reader->line_len && reader->line[len] != ',' && reader->line[len] != '\r')
+    {
+        len++;
+    }
+
+    if (reader->grid_size == 0)
+    {
+        int n = 1;
+        while ((size_t)n * n < len)
+        {
+            n++;
+        }
+        int block = 1;
+        while (block * block < n)
+        {
+            block++;
+        }
+        if ((size_t)n * n != len || block * block != n || n > BATCH_MAX_LINE_SIZE)
+        {
+            return 0;
+        }
+        reader->grid_size = n;
+        reader->block_size = block;
+    }
+    if (len != (size_t)reader->grid_size * reader->grid_size)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < len; i++)
+    {
+        char c = reader->line[i];
+        if (c == '.' || c == '0')
+        {
+            grid[i] = 0;
+        }
+        else if (c >= '1' && c - '0' <= reader->grid_size)
+        {
+            grid[i] = c - '0';
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Read the next puzzle into grid (batch_max_cells ints). Returns 1, 0 at
+// the end of the batch, or -1 for a line that is not a puzzle, which is
+// reported on stderr.
+static inline int batch_next(batch_reader_t *reader, int *grid)
+{
+    if (reader->is_set)
+    {
+        if (reader->next_record >= reader->set.count)
+        {
+            return 0;
+        }
+        puzzle_set_get(&reader->set, reader->next_record++, 0, grid);
+        size_t cells = (size_t)reader->grid_size * reader->grid_size;
+        for (size_t i = 0; i < cells; i++)
+        {
+            if (grid[i] > reader->grid_size)
+            {
+                fprintf(stderr, "%s: record %ld has a cell out of range.\n", reader->filename, reader->next_record - 1);
+                return -1;
+            }
+        }
+        return 1;
+    }
+
+    while (reader->pos < reader->size)
+    {
+        const char *line = reader->data + reader->pos;
+        const char *newline = memchr(line, '\n', reader->size - reader->pos);
+        size_t len = newline ? (size_t)(newline - line) : reader->size - reader->pos;
+        reader->pos += len + (newline != NULL);
+        reader->line_number++;
+        if (len == 0 || line[0] == '#' || line[0] == '\r')
+        {
+            continue;
+        }
+
+        reader->line = line;
+        reader->line_len = len;
+        if (!batch_parse_line(reader, grid))
+        {
+            fprintf(stderr, "%s:%ld: not a puzzle line\n", reader->filename, reader->line_number);
+            return -1;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+// Write the header a puzzle set output needs before its records
+static inline void batch_begin_output(FILE *out, const batch_reader_t *reader)
+{
+    if (reader->is_set)
+    {
+        puzzle_set_write_header(out, reader->grid_size, reader->block_size, reader->set.count, 1);
+    }
+}
+
+// Write the result for one puzzle in the layout of the input: solution, or
+// if it is NULL (unsolved, or not a puzzle) what was read. line and
+// line_len are the reader's line for that puzzle.
+static inline void batch_write_result(FILE *out, const batch_reader_t *reader, const int *puzzle,
+                                      const int *solution, const char *line, size_t line_len)
+{
+    int n = reader->grid_size;
+    if (reader->is_set)
+    {
+        unsigned char *record = malloc(reader->set.record_size);
+        if (!record)
+        {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+        unsigned char *end = puzzle_set_pack(record, puzzle, n);
+        puzzle_set_pack(end, solution ? solution : puzzle, n);
+        fwrite(record, 1, reader->set.record_size, out);
+        free(record);
+        return;
+    }
+    if (!solution)
+    {
+        fwrite(line, 1, line_len, out);
+        fputc('\n', out);
+        return;
+    }
+    char text[BATCH_MAX_LINE_SIZE * BATCH_MAX_LINE_SIZE + 1];
+    for (int i = 0; i < n * n; i++)
+    {
+        text[i] = '0' + solution[i];
+    }
+    text[n * n] = '\n';
+    fwrite(text, 1, n * n + 1, out);
+}
+
+static inline void batch_record(batch_stats_t *stats, double seconds, int solved)
+{
+    if (stats->count == stats->capacity)
+    {
+        stats->capacity = stats->capacity ? 2 * stats->capacity : 1024;
+        stats->latency = realloc(stats->latency, stats->capacity * sizeof(double));
+        if (!stats->latency)
+        {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+    }
+    stats->latency[stats->count++] = seconds;
+    stats->solved += solved;
+}
+
+static inline int batch_compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Latency below which a fraction p of the puzzles finished
+static inline double batch_percentile(const double *sorted, long count, double p)
+{
+    long index = (long)ceil(p * count) - 1;
+    return sorted[index < 0 ? 0 : index];
+}
+
+// Print throughput and the latency distribution, then free the stats
+static inline void batch_report(batch_stats_t *stats, double elapsed, const char *label)
+{
+    printf("Solved %ld of %ld puzzles (%s) in %.3f s: %.0f puzzles/s\n", stats->solved, stats->count, label, elapsed,
+           elapsed > 0 ? stats->count / elapsed : 0.0);
+    if (stats->invalid > 0)
+    {
+        printf("Skipped %ld non-puzzle lines\n", stats->invalid);
+    }
+    if (stats->count > 0)
+    {
+        double sum = 0;
+        for (long i = 0; i < stats->count; i++)
+        {
+            sum += stats->latency[i];
+        }
+        qsort(stats->latency, stats->count, sizeof(double), batch_compare_double);
+        const double *s = stats->latency;
+        long c = stats->count;
+        printf("Latency per puzzle (us): min %.1f  mean %.1f  p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n",
+               s[0] * 1e6, sum / c * 1e6, batch_percentile(s, c, 0.5) * 1e6, batch_percentile(s, c, 0.9) * 1e6,
+               batch_percentile(s, c, 0.99) * 1e6, batch_percentile(s, c, 0.999) * 1e6, s[c - 1] * 1e6);
+    }
+    free(stats->latency);
+}
+
+#endif
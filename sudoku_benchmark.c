@@ -0,0 +1,630 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+// Benchmark driver for the solvers.
+//
+// Every backend runs as a child process on every input: warmup runs first,
+// then the timed trials. The time of a trial is the one the solver reports
+// itself (its clock covers the solve only, not loading or output); wall time
+// around the process is recorded too and used for solvers that report none.
+// The children run with --quiet, so nothing but the timing line is printed.
+//
+// Each configuration gets min, median, p95, mean and standard deviation
+// over its trials, written as CSV rows while the run goes (a long run that is
+// stopped keeps what it has) and, with --json, as one JSON file at the end
+// with the individual trial times. scripts/execution_time_graph_generator.py
+// plots either file.
+//
+// The pthreads, MPI and brute-force solvers have their grid compiled in, so
+// they run once per benchmark with "builtin" as the input.
+//
+// With --verify every run writes its solution with --output, which
+// sudoku_verify.exe then checks against the input; a run whose solution is
+// wrong is recorded as invalid. The check runs after the solver has exited,
+// so it adds nothing to the times.
+
+#define MAX_TRIALS 1000
+#define MAX_CHILD_ARGS 32
+
+typedef struct
+{
+    const char *name;    // as given to --backends
+    const char *program; // binary in --bin-dir, built by "make solvers"
+    const char *args[4]; // options before --quiet, up to a NULL
+    int takes_input;     // 0: the puzzle is compiled into the program
+    int threaded;        // run at 1..T threads through OMP_NUM_THREADS
+    int mpi;             // started through --mpirun
+} backend_t;
+
+static const backend_t backends[] = {
+    {"serial", "sudoku_solver_serial.exe", {NULL}, 1, 0, 0},
+    {"omp", "sudoku_solver_omp.exe", {NULL}, 1, 1, 0},
+    {"pthreads", "sudoku_solver_pthreads.exe", {NULL}, 0, 0, 0},
+    {"mpi", "sudoku_solver_mpi.exe", {NULL}, 0, 0, 1},
+    // The in-process solver with at-most-one clauses on every unit: the
+    // pairwise default without them is orders of magnitude slower from 16x16
+    {"sat", "sat_solver_serial.exe", {"--incremental", "--amo-units", NULL}, 1, 0, 0},
+    {"brute", "brute.exe", {NULL}, 0, 0, 0},
+};
+#define NUM_BACKENDS ((int)(sizeof(backends) / sizeof(backends[0])))
+
+static const char *default_inputs[] = {
+    "9x9_easy", "9x9_medium", "9x9_hard", "16x16_easy", "16x16_medium",
+    "16x16_hard", "25x25_easy", "25x25_medium", "25x25_hard",
+};
+#define NUM_DEFAULT_INPUTS ((int)(sizeof(default_inputs) / sizeof(default_inputs[0])))
+
+typedef enum
+{
+    TRIAL_OK,
+    TRIAL_FAILED, // nonzero exit, killed, or no solution
+    TRIAL_TIMEOUT,
+    TRIAL_INVALID // the solution did not pass sudoku_verify.exe
+} trial_status_t;
+
+static const char *status_names[] = {"ok", "failed", "timeout", "invalid"};
+
+typedef struct
+{
+    int warmup;
+    int trials;
+    double timeout; // seconds per run
+    const char *bin_dir;
+    const char *input_dir;
+    char *mpirun[MAX_CHILD_ARGS / 2]; // launcher command, split at spaces
+    int procs;                        // MPI ranks
+    char *verify_output;              // solution file with --verify, NULL without
+} config_t;
+
+typedef struct
+{
+    const backend_t *backend;
+    int threads; // 0 if the backend is not threaded
+    const char *input;
+    trial_status_t status;
+    int count;
+    int reported; // 1 if times are what the solver reported
+    double times[MAX_TRIALS];
+    double wall[MAX_TRIALS];
+    double min, median, p95, mean, stddev, wall_median;
+} result_t;
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The timing line each solver prints, in seconds; -1 if there is none.
+// The MPI solver prints one line per rank, the largest is taken.
+static double parse_reported_time(FILE *output, int *no_solution)
+{
+    char line[512];
+    double best = -1;
+    *no_solution = 0;
+    rewind(output);
+    while (fgets(line, sizeof(line), output))
+    {
+        int hrs, mins, secs;
+        double value;
+        double seconds = -1;
+        if (sscanf(line, "Time taken to solve (%*[^)]): %dhr: %dmin: %dsec: %lfms", &hrs, &mins, &secs, &value) == 4)
+        {
+            seconds = hrs * 3600.0 + mins * 60.0 + secs + value / 1000.0;
+        }
+        else if (sscanf(line, "Time taken (%*[^)]): %lf ms", &value) == 1 ||
+                 sscanf(line, "Time taken: %lf milliseconds", &value) == 1)
+        {
+            seconds = value / 1000.0;
+        }
+        else if (sscanf(line, "elapsed time to solve %*d x %*d grid is : %lf", &value) == 1)
+        {
+            seconds = value;
+        }
+        else if (strncmp(line, "No solution exists", 18) == 0)
+        {
+            *no_solution = 1;
+        }
+        if (seconds > best)
+        {
+            best = seconds;
+        }
+    }
+    return best;
+}
+
+// Run argv once with OMP_NUM_THREADS=threads if threads > 0. Sets *wall and
+// *reported (-1 if the solver printed no time).
+static trial_status_t run_trial(char *const argv[], int threads, double timeout, double *wall, double *reported)
+{
+    FILE *output = tmpfile();
+    if (!output)
+    {
+        perror("Error creating temporary file");
+        exit(1);
+    }
+    sigset_t chld, old;
+    sigemptyset(&chld);
+    sigaddset(&chld, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld, &old);
+
+    double start = now_seconds();
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("fork failed");
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        // Own process group, so a timeout also kills what mpirun started
+        setpgid(0, 0);
+        sigprocmask(SIG_SETMASK, &old, NULL);
+        dup2(fileno(output), STDOUT_FILENO);
+        if (threads > 0)
+        {
+            char value[16];
+            sprintf(value, "%d", threads);
+            setenv("OMP_NUM_THREADS", value, 1);
+        }
+        execvp(argv[0], argv);
+        perror(argv[0]);
+        _exit(127);
+    }
+    setpgid(pid, pid);
+
+    int status = 0;
+    int timed_out = 0;
+    for (;;)
+    {
+        pid_t done = waitpid(pid, &status, WNOHANG);
+        if (done == pid)
+        {
+            break;
+        }
+        double left = start + timeout - now_seconds();
+        if (left <= 0)
+        {
+            kill(-pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            timed_out = 1;
+            break;
+        }
+        struct timespec wait_for = {(time_t)left, (long)((left - (time_t)left) * 1e9)};
+        if (sigtimedwait(&chld, NULL, &wait_for) < 0 && errno != EAGAIN && errno != EINTR)
+        {
+            perror("sigtimedwait failed");
+            exit(1);
+        }
+    }
+    *wall = now_seconds() - start;
+    sigprocmask(SIG_SETMASK, &old, NULL);
+
+    int no_solution;
+    *reported = parse_reported_time(output, &no_solution);
+    fclose(output);
+    if (timed_out)
+    {
+        return TRIAL_TIMEOUT;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || no_solution)
+    {
+        return TRIAL_FAILED;
+    }
+    return TRIAL_OK;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double median_of(double *sorted, int count)
+{
+    return count % 2 ? sorted[count / 2] : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+}
+
+static void compute_stats(result_t *r)
+{
+    double sorted[MAX_TRIALS];
+    int c = r->count;
+    memcpy(sorted, r->times, c * sizeof(double));
+    qsort(sorted, c, sizeof(double), compare_double);
+    r->min = sorted[0];
+    r->median = median_of(sorted, c);
+    long rank = (long)ceil(0.95 * c) - 1; // nearest-rank percentile
+    r->p95 = sorted[rank < 0 ? 0 : rank];
+
+    double sum = 0;
+    for (int i = 0; i < c; i++)
+    {
+        sum += r->times[i];
+    }
+    r->mean = sum / c;
+    double squares = 0;
+    for (int i = 0; i < c; i++)
+    {
+        squares += (r->times[i] - r->mean) * (r->times[i] - r->mean);
+    }
+    r->stddev = c > 1 ? sqrt(squares / (c - 1)) : 0;
+
+    memcpy(sorted, r->wall, c * sizeof(double));
+    qsort(sorted, c, sizeof(double), compare_double);
+    r->wall_median = median_of(sorted, c);
+}
+
+// Fill argv for one run of backend on input. path, input_path, procs and
+// output are buffers that argv points into.
+static void build_argv(const config_t *config, const backend_t *backend, const char *input, char *path,
+                       char *input_path, char *procs, char *output, char *argv[])
+{
+    int argc = 0;
+    if (backend->mpi)
+    {
+        for (int i = 0; config->mpirun[i]; i++)
+        {
+            argv[argc++] = config->mpirun[i];
+        }
+        argv[argc++] = "-np";
+        sprintf(procs, "%d", config->procs);
+        argv[argc++] = procs;
+    }
+    sprintf(path, "%s/%s", config->bin_dir, backend->program);
+    argv[argc++] = path;
+    for (int i = 0; backend->args[i]; i++)
+    {
+        argv[argc++] = (char *)backend->args[i];
+    }
+    argv[argc++] = "--quiet";
+    if (config->verify_output)
+    {
+        sprintf(output, "--output=%s", config->verify_output);
+        argv[argc++] = output;
+    }
+    if (backend->takes_input)
+    {
+        sprintf(input_path, "%s/%s.txt", config->input_dir, input);
+        argv[argc++] = input_path;
+    }
+    argv[argc] = NULL;
+}
+
+// Check the solution a run wrote to config->verify_output, against the
+// puzzle in input_path if the backend read one
+static trial_status_t verify_solution(const config_t *config, const backend_t *backend, const char *input_path)
+{
+    char path[4096], puzzle[4096 + 16];
+    char *argv[] = {path, puzzle, config->verify_output, NULL};
+    sprintf(path, "%s/sudoku_verify.exe", config->bin_dir);
+    if (backend->takes_input)
+    {
+        sprintf(puzzle, "--puzzle=%s", input_path);
+    }
+    else
+    {
+        argv[1] = config->verify_output;
+        argv[2] = NULL;
+    }
+    double wall, reported;
+    return run_trial(argv, 0, config->timeout, &wall, &reported) == TRIAL_OK ? TRIAL_OK : TRIAL_INVALID;
+}
+
+// Warm up, then time config->trials runs. A run that fails, times out or
+// (with --verify) solves wrong ends the configuration, since the rest would
+// do the same.
+static void run_benchmark(const config_t *config, result_t *r)
+{
+    char path[4096], input_path[4096], procs[16], output[4096 + 16];
+    char *argv[MAX_CHILD_ARGS];
+    build_argv(config, r->backend, r->input, path, input_path, procs, output, argv);
+
+    r->status = TRIAL_OK;
+    r->count = 0;
+    r->reported = 1;
+    for (int i = 0; i < config->warmup + config->trials; i++)
+    {
+        double wall, reported;
+        trial_status_t status = run_trial(argv, r->threads, config->timeout, &wall, &reported);
+        if (status == TRIAL_OK && config->verify_output)
+        {
+            status = verify_solution(config, r->backend, input_path);
+        }
+        if (status != TRIAL_OK)
+        {
+            r->status = status;
+            return;
+        }
+        if (i < config->warmup)
+        {
+            continue;
+        }
+        r->wall[r->count] = wall;
+        r->times[r->count] = reported;
+        r->reported &= reported >= 0;
+        r->count++;
+    }
+    if (!r->reported)
+    {
+        memcpy(r->times, r->wall, r->count * sizeof(double));
+    }
+    compute_stats(r);
+}
+
+static void write_csv_row(FILE *csv, const result_t *r, int procs)
+{
+    fprintf(csv, "%s,%d,%d,%s,%s,%d,", r->backend->name, r->threads, r->backend->mpi ? procs : 1, r->input,
+            status_names[r->status], r->count);
+    if (r->status == TRIAL_OK)
+    {
+        fprintf(csv, "%s,%.9f,%.9f,%.9f,%.9f,%.9f,%.9f\n", r->reported ? "solver" : "wall", r->min, r->median, r->p95,
+                r->mean, r->stddev, r->wall_median);
+    }
+    else
+    {
+        fprintf(csv, ",,,,,,\n");
+    }
+    fflush(csv);
+}
+
+static void write_json(FILE *json, const config_t *config, const result_t *results, int count)
+{
+    fprintf(json, "{\n  \"warmup\": %d,\n  \"trials\": %d,\n  \"timeout_s\": %g,\n  \"results\": [\n", config->warmup,
+            config->trials, config->timeout);
+    for (int i = 0; i < count; i++)
+    {
+        const result_t *r = &results[i];
+        fprintf(json,
+                "    {\"backend\": \"%s\", \"threads\": %d, \"procs\": %d, \"input\": \"%s\", \"status\": \"%s\", "
+                "\"trials\": %d",
+                r->backend->name, r->threads, r->backend->mpi ? config->procs : 1, r->input, status_names[r->status],
+                r->count);
+        if (r->status == TRIAL_OK)
+        {
+            fprintf(json,
+                    ", \"source\": \"%s\", \"min_s\": %.9f, \"median_s\": %.9f, \"p95_s\": %.9f, \"mean_s\": %.9f, "
+                    "\"stddev_s\": %.9f, \"wall_median_s\": %.9f, \"times_s\": [",
+                    r->reported ? "solver" : "wall", r->min, r->median, r->p95, r->mean, r->stddev, r->wall_median);
+            for (int t = 0; t < r->count; t++)
+            {
+                fprintf(json, "%s%.9f", t ? ", " : "", r->times[t]);
+            }
+            fprintf(json, "]");
+        }
+        fprintf(json, "}%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(json, "  ]\n}\n");
+}
+
+// Split list in place at any of the characters in separators. Returns the
+// number of items.
+static int split_list(char *list, const char *separators, char *items[], int max_items)
+{
+    int count = 0;
+    for (char *item = strtok(list, separators); item && count < max_items; item = strtok(NULL, separators))
+    {
+        items[count++] = item;
+    }
+    return count;
+}
+
+int main(int argc, char *argv[])
+{
+    config_t config = {1, 5, 600.0, ".", ".", {NULL}, 4, NULL};
+    char *backend_list = NULL;
+    char *input_list = NULL;
+    int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    const char *csv_file = "benchmark.csv";
+    const char *json_file = NULL;
+    char mpirun[256] = "mpirun";
+    int verify = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--backends=", 11) == 0)
+        {
+            backend_list = argv[i] + 11;
+        }
+        else if (strncmp(argv[i], "--inputs=", 9) == 0)
+        {
+            input_list = argv[i] + 9;
+        }
+        else if (strncmp(argv[i], "--threads=", 10) == 0 && atoi(argv[i] + 10) > 0)
+        {
+            max_threads = atoi(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "--procs=", 8) == 0 && atoi(argv[i] + 8) > 1)
+        {
+            config.procs = atoi(argv[i] + 8);
+        }
+        else if (strncmp(argv[i], "--warmup=", 9) == 0 && atoi(argv[i] + 9) >= 0)
+        {
+            config.warmup = atoi(argv[i] + 9);
+        }
+        else if (strncmp(argv[i], "--trials=", 9) == 0 && atoi(argv[i] + 9) > 0 && atoi(argv[i] + 9) <= MAX_TRIALS)
+        {
+            config.trials = atoi(argv[i] + 9);
+        }
+        else if (strncmp(argv[i], "--timeout=", 10) == 0 && atof(argv[i] + 10) > 0)
+        {
+            config.timeout = atof(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "--bin-dir=", 10) == 0)
+        {
+            config.bin_dir = argv[i] + 10;
+        }
+        else if (strncmp(argv[i], "--input-dir=", 12) == 0)
+        {
+            config.input_dir = argv[i] + 12;
+        }
+        else if (strncmp(argv[i], "--mpirun=", 9) == 0 && strlen(argv[i] + 9) < sizeof(mpirun))
+        {
+            strcpy(mpirun, argv[i] + 9);
+        }
+        else if (strncmp(argv[i], "--csv=", 6) == 0)
+        {
+            csv_file = argv[i] + 6;
+        }
+        else if (strncmp(argv[i], "--json=", 7) == 0)
+        {
+            json_file = argv[i] + 7;
+        }
+        else if (strcmp(argv[i], "--verify") == 0)
+        {
+            verify = 1;
+        }
+        else
+        {
+            fprintf(stderr,
+                    "Usage: %s [--backends=serial,omp,pthreads,mpi,sat,brute] [--inputs=9x9_easy,...] [--threads=T] "
+                    "[--procs=P] [--warmup=W] [--trials=R] [--timeout=S] [--bin-dir=dir] [--input-dir=dir] "
+                    "[--mpirun=cmd] [--csv=file] [--json=file] [--verify]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    split_list(mpirun, " ", config.mpirun, MAX_CHILD_ARGS / 2 - 1);
+
+    char verify_output[] = "/tmp/sudoku_benchmark_XXXXXX";
+    if (verify)
+    {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/sudoku_verify.exe", config.bin_dir);
+        if (access(path, X_OK) != 0)
+        {
+            fprintf(stderr, "--verify needs %s (make sudoku_verify.exe)\n", path);
+            return 1;
+        }
+        int fd = mkstemp(verify_output);
+        if (fd < 0)
+        {
+            perror("Error creating temporary file");
+            return 1;
+        }
+        close(fd);
+        config.verify_output = verify_output;
+    }
+
+    const backend_t *selected[NUM_BACKENDS];
+    int num_selected = 0;
+    char *names[NUM_BACKENDS * 2];
+    int num_names = backend_list ? split_list(backend_list, ",", names, NUM_BACKENDS * 2) : 0;
+    for (int b = 0; b < NUM_BACKENDS; b++)
+    {
+        int wanted = !backend_list;
+        for (int k = 0; k < num_names; k++)
+        {
+            wanted |= strcmp(names[k], backends[b].name) == 0;
+        }
+        if (!wanted)
+        {
+            continue;
+        }
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", config.bin_dir, backends[b].program);
+        if (access(path, X_OK) != 0)
+        {
+            fprintf(stderr, "Skipping %s: %s is not built (make solvers)\n", backends[b].name, path);
+            continue;
+        }
+        selected[num_selected++] = &backends[b];
+    }
+
+    const char *inputs[64];
+    int num_inputs = NUM_DEFAULT_INPUTS;
+    memcpy(inputs, default_inputs, sizeof(default_inputs));
+    if (input_list)
+    {
+        num_inputs = split_list(input_list, ",", (char **)inputs, 64);
+    }
+
+    // Every configuration: a threaded backend at 1..T threads on every input,
+    // a builtin-grid backend once
+    int capacity = 0;
+    for (int b = 0; b < num_selected; b++)
+    {
+        capacity += (selected[b]->takes_input ? num_inputs : 1) * (selected[b]->threaded ? max_threads : 1);
+    }
+    result_t *results = calloc(capacity > 0 ? capacity : 1, sizeof(result_t));
+    if (!results)
+    {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+
+    FILE *csv = fopen(csv_file, "w");
+    if (!csv)
+    {
+        perror("Error opening CSV file");
+        return 1;
+    }
+    fprintf(csv, "backend,threads,procs,input,status,trials,source,min_s,median_s,p95_s,mean_s,stddev_s,wall_median_s\n");
+
+    printf("%-8s %7s  %-14s %-7s %12s %12s %12s %12s\n", "backend", "threads", "input", "status", "min (s)",
+           "median (s)", "p95 (s)", "stddev (s)");
+    int count = 0;
+    for (int b = 0; b < num_selected; b++)
+    {
+        const backend_t *backend = selected[b];
+        int runs_inputs = backend->takes_input ? num_inputs : 1;
+        for (int k = 0; k < runs_inputs; k++)
+        {
+            for (int t = 1; t <= (backend->threaded ? max_threads : 1); t++)
+            {
+                result_t *r = &results[count++];
+                r->backend = backend;
+                r->threads = backend->threaded ? t : 0;
+                r->input = backend->takes_input ? inputs[k] : "builtin";
+                run_benchmark(&config, r);
+                write_csv_row(csv, r, config.procs);
+                if (r->status == TRIAL_OK)
+                {
+                    printf("%-8s %7d  %-14s %-7s %12.6f %12.6f %12.6f %12.6f\n", backend->name, r->threads, r->input,
+                           status_names[r->status], r->min, r->median, r->p95, r->stddev);
+                }
+                else
+                {
+                    printf("%-8s %7d  %-14s %-7s\n", backend->name, r->threads, r->input, status_names[r->status]);
+                }
+                fflush(stdout);
+            }
+        }
+    }
+    if (fclose(csv) != 0)
+    {
+        perror("Error writing CSV file");
+        return 1;
+    }
+
+    if (json_file)
+    {
+        FILE *json = fopen(json_file, "w");
+        if (!json)
+        {
+            perror("Error opening JSON file");
+            return 1;
+        }
+        write_json(json, &config, results, count);
+        if (fclose(json) != 0)
+        {
+            perror("Error writing JSON file");
+            return 1;
+        }
+    }
+    free(results);
+    if (config.verify_output)
+    {
+        unlink(config.verify_output);
+    }
+    return 0;
+}
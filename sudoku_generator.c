@@ -1,259 +1,1437 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <math.h>
 #include <time.h>
+#include <unistd.h>
+#include <omp.h>
+#include "sudoku_loader.h"
 
-void shuffle(int *array, int n)
+// PCG32 random number generator (pcg-random.org). Unlike rand() it keeps its
+// state in the caller's rng_t, so threads do not share anything. Every
+// stream number gives an independent sequence for the same seed: puzzle i of
+// a corpus uses stream i, so the output does not depend on which thread
+// made which puzzle.
+typedef struct
+{
+    uint64_t state;
+    uint64_t inc;
+} rng_t;
+
+// Solution counter used by --unique.
+//
+// Candidates are kept as one bit per digit in a 64-bit mask per cell, so
+// --unique handles sizes up to 64. Every placement removes the digit from
+// the peers. Propagation always uses the simplest rule that makes progress:
+// naked singles first, then hidden singles, then locked candidates (a digit
+// confined to one line of a box, or to one box of a line, is removed from
+// the rest of the other unit), and a search branch only when none of them
+// applies. Which of these were needed is what the difficulty rating is
+// based on.
+#define MAX_UNIQUE_SIZE 64
+
+typedef struct
+{
+    uint64_t *cand; // candidate digits per cell, bit d for digit d + 1
+    int *value;     // placed digit per cell, 0 if open
+    int open;       // cells still open
+} grid_state_t;
+
+typedef struct
+{
+    long nodes;          // search branches tried
+    long naked_singles;  // cells placed because only one digit fit
+    long hidden_singles; // cells placed because a digit fit nowhere else in a unit
+    long locked;         // cells that lost candidates to locked candidates
+} solve_stats_t;
+
+// Working memory of one counting thread
+typedef struct
+{
+    int n;
+    int base;
+    uint64_t all;         // mask with all n digits
+    int *units;           // units[u * n + k] = k-th cell of unit u: rows, columns, boxes
+    grid_state_t *levels; // one state per search depth, allocated on first use
+    int num_levels;
+    int *queue;           // cells that just dropped to one candidate
+    int queue_len;
+    long max_nodes;       // search budget per call, 0 for none
+    int gave_up;          // set when a call ran out of budget
+} counter_t;
+
+uint32_t rng_next(rng_t *rng)
+{
+    uint64_t old = rng->state;
+    rng->state = old * 6364136223846793005ULL + rng->inc;
+    uint32_t xorshifted = ((old >> 18) ^ old) >> 27;
+    uint32_t rot = old >> 59;
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+}
+
+void rng_seed(rng_t *rng, uint64_t seed, uint64_t stream)
+{
+    rng->state = 0;
+    rng->inc = (stream << 1) | 1;
+    rng_next(rng);
+    rng->state += seed;
+    rng_next(rng);
+}
+
+// Uniform in [0, bound), without the modulo bias of rand() % bound. Uses
+// Lemire's multiply-and-shift, which only divides in the rare case that a
+// draw may have to be rejected.
+uint32_t rng_below(rng_t *rng, uint32_t bound)
+{
+    uint64_t m = (uint64_t)rng_next(rng) * bound;
+    if ((uint32_t)m < bound)
+    {
+        uint32_t threshold = -bound % bound;
+        while ((uint32_t)m < threshold)
+        {
+            m = (uint64_t)rng_next(rng) * bound;
+        }
+    }
+    return m >> 32;
+}
+
+void shuffle(int *array, int n, rng_t *rng)
 {
     for (int i = n - 1; i > 0; i--)
     {
-        int j = rand() % (i + 1);
+        int j = rng_below(rng, i + 1);
         int temp = array[i];
         array[i] = array[j];
         array[j] = temp;
     }
 }
 
-int main(int argc, char *argv[])
+void *checked_malloc(size_t size)
 {
-    if (argc < 2)
+    void *p = malloc(size);
+    if (!p)
     {
-        fprintf(stderr, "Usage: %s <sudoku size> [<removal_rate: 0.5>]\n", argv[0]);
-        return 1;
+        fprintf(stderr, "Memory allocation error\n");
+        exit(1);
     }
+    return p;
+}
 
-    int n = atoi(argv[1]);
-    if (n <= 0)
+// A random valid grid, kept as the permutations applied to the base pattern:
+// shuffled bands, rows within bands, stacks, columns within stacks and
+// digits. This is O(n) memory however large the grid, and pattern_cell
+// gives any cell in closed form.
+typedef struct
+{
+    int n;
+    int base;
+    int *rows;
+    int *cols;
+    int *nums;
+} pattern_t;
+
+void pattern_init(pattern_t *pattern, int n, int base, rng_t *rng)
+{
+    int *band_rows = checked_malloc(base * sizeof(int));
+    int *band_cols = checked_malloc(base * sizeof(int));
+    int *inner = checked_malloc(base * sizeof(int));
+    int *rows = checked_malloc(n * sizeof(int));
+    int *cols = checked_malloc(n * sizeof(int));
+    int *nums = checked_malloc(n * sizeof(int));
+
+    for (int i = 0; i < base; i++)
     {
-        fprintf(stderr, "Error: sudoku size must be a positive integer.\n");
-        return 1;
+        band_rows[i] = i;
+        band_cols[i] = i;
     }
+    shuffle(band_rows, base, rng);
+    shuffle(band_cols, base, rng);
 
-    int base = (int)round(sqrt(n));
-    if (base * base != n)
+    int idx = 0;
+    for (int i = 0; i < base; i++)
     {
-        fprintf(stderr, "Error: The sudoku size must be a perfect square.\n");
-        return 1;
+        for (int j = 0; j < base; j++)
+        {
+            inner[j] = j;
+        }
+        shuffle(inner, base, rng);
+        for (int j = 0; j < base; j++)
+        {
+            rows[idx++] = band_rows[i] * base + inner[j];
+        }
     }
 
-    double removal_rate = 0.5; // Default removal rate
-    if (argc > 2)
+    idx = 0;
+    for (int i = 0; i < base; i++)
     {
-        removal_rate = atof(argv[2]);
-        if (removal_rate < 0 || removal_rate > 1)
+        for (int j = 0; j < base; j++)
         {
-            fprintf(stderr, "Error: removal rate must be between 0 and 1.\n");
-            return 1;
+            inner[j] = j;
+        }
+        shuffle(inner, base, rng);
+        for (int j = 0; j < base; j++)
+        {
+            cols[idx++] = band_cols[i] * base + inner[j];
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        nums[i] = i + 1;
+    }
+    shuffle(nums, n, rng);
+
+    free(band_rows);
+    free(band_cols);
+    free(inner);
+
+    pattern->n = n;
+    pattern->base = base;
+    pattern->rows = rows;
+    pattern->cols = cols;
+    pattern->nums = nums;
+}
+
+void pattern_free(pattern_t *pattern)
+{
+    free(pattern->rows);
+    free(pattern->cols);
+    free(pattern->nums);
+}
+
+int pattern_cell(const pattern_t *pattern, int i, int j)
+{
+    int n = pattern->n, base = pattern->base;
+    int r = pattern->rows[i];
+    int c = pattern->cols[j];
+    int pos = (base * (r % base) + (r / base) + c) % n;
+    return pattern->nums[pos];
+}
+
+// Fill board (n * n, row-major) with a random valid grid
+void fill_board(int *board, int n, int base, rng_t *rng)
+{
+    pattern_t pattern;
+    pattern_init(&pattern, n, base, rng);
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            board[i * n + j] = pattern_cell(&pattern, i, j);
         }
     }
+    pattern_free(&pattern);
+}
 
-    srand((unsigned)time(NULL));
+void state_alloc(grid_state_t *state, int n)
+{
+    state->cand = checked_malloc((size_t)n * n * sizeof(uint64_t));
+    state->value = checked_malloc((size_t)n * n * sizeof(int));
+}
+
+void state_free(grid_state_t *state)
+{
+    free(state->cand);
+    free(state->value);
+}
 
-    int *indices = malloc(base * sizeof(int));
-    if (!indices)
+void state_copy(grid_state_t *dst, const grid_state_t *src, int n)
+{
+    memcpy(dst->cand, src->cand, (size_t)n * n * sizeof(uint64_t));
+    memcpy(dst->value, src->value, (size_t)n * n * sizeof(int));
+    dst->open = src->open;
+}
+
+void counter_init(counter_t *counter, int n, int base)
+{
+    counter->n = n;
+    counter->base = base;
+    counter->all = n == 64 ? ~0ULL : (1ULL << n) - 1;
+    counter->units = checked_malloc((size_t)3 * n * n * sizeof(int));
+    for (int i = 0; i < n; i++)
+    {
+        for (int k = 0; k < n; k++)
+        {
+            counter->units[i * n + k] = i * n + k;
+            counter->units[(n + i) * n + k] = k * n + i;
+            counter->units[(2 * n + i) * n + k] = ((i / base) * base + k / base) * n + (i % base) * base + k % base;
+        }
+    }
+    counter->levels = NULL;
+    counter->num_levels = 0;
+    counter->queue = checked_malloc((size_t)n * n * sizeof(int));
+    counter->queue_len = 0;
+    counter->max_nodes = 0;
+    counter->gave_up = 0;
+}
+
+void counter_free(counter_t *counter)
+{
+    for (int i = 0; i < counter->num_levels; i++)
+    {
+        state_free(&counter->levels[i]);
+    }
+    free(counter->levels);
+    free(counter->units);
+    free(counter->queue);
+}
+
+grid_state_t *counter_level(counter_t *counter, int depth)
+{
+    if (depth >= counter->num_levels)
+    {
+        int num_levels = counter->num_levels ? 2 * counter->num_levels : 16;
+        while (num_levels <= depth)
+        {
+            num_levels *= 2;
+        }
+        counter->levels = realloc(counter->levels, num_levels * sizeof(grid_state_t));
+        if (!counter->levels)
+        {
+            fprintf(stderr, "Memory allocation error\n");
+            exit(1);
+        }
+        for (int i = counter->num_levels; i < num_levels; i++)
+        {
+            state_alloc(&counter->levels[i], counter->n);
+        }
+        counter->num_levels = num_levels;
+    }
+    return &counter->levels[depth];
+}
+
+// Remove the digits in mask from an open cell. Returns 0 if the cell has no
+// candidate left.
+int eliminate(counter_t *counter, grid_state_t *state, int cell, uint64_t mask)
+{
+    uint64_t cand = state->cand[cell];
+    if (!(cand & mask) || state->value[cell])
     {
-        fprintf(stderr, "Memory allocation error\n");
         return 1;
     }
-    for (int i = 0; i < base; i++)
+    cand &= ~mask;
+    state->cand[cell] = cand;
+    if (cand == 0)
+    {
+        return 0;
+    }
+    if ((cand & (cand - 1)) == 0)
     {
-        indices[i] = i;
+        counter->queue[counter->queue_len++] = cell;
     }
+    return 1;
+}
 
-    int *band_rows = malloc(base * sizeof(int));
-    int *band_cols = malloc(base * sizeof(int));
-    if (!band_rows || !band_cols)
+// Place digit d in cell and remove it from the peers. Returns 0 on a
+// contradiction.
+int assign(counter_t *counter, grid_state_t *state, int cell, int d)
+{
+    int n = counter->n, base = counter->base;
+    uint64_t bit = 1ULL << d;
+    if (state->value[cell] == d + 1)
     {
-        fprintf(stderr, "Memory allocation error\n");
-        free(indices);
         return 1;
     }
-    for (int i = 0; i < base; i++)
+    if (state->value[cell] || !(state->cand[cell] & bit))
     {
-        band_rows[i] = indices[i];
-        band_cols[i] = indices[i];
+        return 0;
     }
-    shuffle(band_rows, base);
-    shuffle(band_cols, base);
 
-    int *rows = malloc(n * sizeof(int));
-    int *cols = malloc(n * sizeof(int));
-    if (!rows || !cols)
+    state->value[cell] = d + 1;
+    state->open--;
+    state->cand[cell] = bit;
+
+    int r = cell / n, c = cell % n;
+    int box_r = r - r % base, box_c = c - c % base;
+    for (int i = 0; i < n; i++)
+    {
+        int peers[3] = {r * n + i, i * n + c, (box_r + i / base) * n + box_c + i % base};
+        for (int p = 0; p < 3; p++)
+        {
+            if (peers[p] == cell)
+            {
+                continue;
+            }
+            if (state->value[peers[p]] == d + 1 || !eliminate(counter, state, peers[p], bit))
+            {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// Remove mask from cell as a locked-candidate step, counting it in *removed
+// if anything went. Returns 0 on a contradiction.
+int remove_locked(counter_t *counter, grid_state_t *state, int cell, uint64_t mask, int *removed)
+{
+    if (state->value[cell] || !(state->cand[cell] & mask))
     {
-        fprintf(stderr, "Memory allocation error\n");
-        free(indices);
-        free(band_rows);
-        free(band_cols);
         return 1;
     }
+    (*removed)++;
+    return eliminate(counter, state, cell, mask);
+}
 
-    int idx = 0;
+// Digits of seg[0..base) that appear in exactly one of them
+uint64_t confined_digits(const uint64_t *seg, int base)
+{
+    uint64_t once = 0, twice = 0;
     for (int i = 0; i < base; i++)
     {
-        int br = band_rows[i];
-        int *inner = malloc(base * sizeof(int));
-        if (!inner)
+        twice |= once & seg[i];
+        once |= seg[i];
+    }
+    return once & ~twice;
+}
+
+// Locked candidates. A digit that fits only one row (column) of a box is
+// removed from the rest of that row (column), and a digit that fits only one
+// box of a row (column) is removed from the rest of that box. Returns the
+// number of cells that lost candidates, or -1 on a contradiction.
+int locked_candidates(counter_t *counter, grid_state_t *state)
+{
+    int n = counter->n, base = counter->base;
+    int removed = 0;
+    uint64_t rows[8], cols[8]; // base <= 8 since n <= MAX_UNIQUE_SIZE
+
+    // Pointing: per box, the open candidates of each of its rows and columns
+    for (int b = 0; b < n; b++)
+    {
+        int r0 = (b / base) * base, c0 = (b % base) * base;
+        memset(rows, 0, sizeof(rows));
+        memset(cols, 0, sizeof(cols));
+        for (int i = 0; i < base; i++)
         {
-            fprintf(stderr, "Memory allocation error\n");
-            return 1;
+            for (int j = 0; j < base; j++)
+            {
+                int cell = (r0 + i) * n + c0 + j;
+                if (!state->value[cell])
+                {
+                    rows[i] |= state->cand[cell];
+                    cols[j] |= state->cand[cell];
+                }
+            }
         }
-        for (int j = 0; j < base; j++)
+        uint64_t in_row = confined_digits(rows, base), in_col = confined_digits(cols, base);
+        for (int i = 0; i < base && (in_row | in_col); i++)
         {
-            inner[j] = indices[j];
+            uint64_t row_mask = rows[i] & in_row, col_mask = cols[i] & in_col;
+            for (int k = 0; k < n && (row_mask | col_mask); k++)
+            {
+                if (row_mask && k / base != c0 / base && !remove_locked(counter, state, (r0 + i) * n + k, row_mask, &removed))
+                {
+                    return -1;
+                }
+                if (col_mask && k / base != r0 / base && !remove_locked(counter, state, k * n + c0 + i, col_mask, &removed))
+                {
+                    return -1;
+                }
+            }
         }
-        shuffle(inner, base);
-        for (int j = 0; j < base; j++)
+    }
+
+    // Claiming: per row and column, the open candidates in each box it crosses
+    for (int line = 0; line < n; line++)
+    {
+        memset(rows, 0, sizeof(rows));
+        memset(cols, 0, sizeof(cols));
+        for (int k = 0; k < n; k++)
+        {
+            if (!state->value[line * n + k])
+            {
+                rows[k / base] |= state->cand[line * n + k];
+            }
+            if (!state->value[k * n + line])
+            {
+                cols[k / base] |= state->cand[k * n + line];
+            }
+        }
+        uint64_t in_row = confined_digits(rows, base), in_col = confined_digits(cols, base);
+        int band = line - line % base;
+        for (int s = 0; s < base && (in_row | in_col); s++)
         {
-            rows[idx++] = br * base + inner[j];
+            uint64_t row_mask = rows[s] & in_row, col_mask = cols[s] & in_col;
+            for (int i = 0; i < base && (row_mask | col_mask); i++)
+            {
+                if (band + i == line)
+                {
+                    continue;
+                }
+                for (int j = 0; j < base; j++)
+                {
+                    if (!remove_locked(counter, state, (band + i) * n + s * base + j, row_mask, &removed) ||
+                        !remove_locked(counter, state, (s * base + j) * n + band + i, col_mask, &removed))
+                    {
+                        return -1;
+                    }
+                }
+            }
         }
-        free(inner);
     }
+    return removed;
+}
 
-    idx = 0;
-    for (int i = 0; i < base; i++)
+// Apply naked singles until none are left, then one pass of hidden singles,
+// then locked candidates, and repeat until none of them makes progress.
+// Returns 0 on a contradiction.
+int propagate(counter_t *counter, grid_state_t *state, solve_stats_t *stats)
+{
+    int n = counter->n;
+
+    for (;;)
     {
-        int bc = band_cols[i];
-        int *inner = malloc(base * sizeof(int));
-        if (!inner)
+        while (counter->queue_len > 0)
+        {
+            int cell = counter->queue[--counter->queue_len];
+            if (state->value[cell])
+            {
+                continue;
+            }
+            stats->naked_singles++;
+            if (!assign(counter, state, cell, __builtin_ctzll(state->cand[cell])))
+            {
+                return 0;
+            }
+        }
+
+        // Per unit, the digits that fit exactly one open cell
+        int found = 0;
+        for (int u = 0; u < 3 * n; u++)
+        {
+            const int *unit = &counter->units[u * n];
+            uint64_t once = 0, twice = 0, placed = 0;
+            for (int k = 0; k < n; k++)
+            {
+                int cell = unit[k];
+                if (state->value[cell])
+                {
+                    placed |= 1ULL << (state->value[cell] - 1);
+                }
+                else
+                {
+                    twice |= once & state->cand[cell];
+                    once |= state->cand[cell];
+                }
+            }
+            if ((once | placed) != counter->all)
+            {
+                return 0;
+            }
+            uint64_t singles = once & ~twice & ~placed;
+            while (singles)
+            {
+                int d = __builtin_ctzll(singles);
+                singles &= singles - 1;
+                for (int k = 0; k < n; k++)
+                {
+                    int cell = unit[k];
+                    if (!state->value[cell] && (state->cand[cell] >> d & 1))
+                    {
+                        stats->hidden_singles++;
+                        if (!assign(counter, state, cell, d))
+                        {
+                            return 0;
+                        }
+                        found = 1;
+                        break;
+                    }
+                }
+            }
+        }
+        if (found || counter->queue_len > 0)
+        {
+            continue;
+        }
+
+        int locked = locked_candidates(counter, state);
+        if (locked < 0)
+        {
+            return 0;
+        }
+        if (locked == 0)
         {
-            fprintf(stderr, "Memory allocation error\n");
             return 1;
         }
-        for (int j = 0; j < base; j++)
+        stats->locked += locked;
+    }
+}
+
+// Depth-first search from levels[depth], which propagate has just run on.
+// Branches on the open cell with the fewest candidates, or on the places of
+// a digit in a unit if there are fewer of those. Stops once limit solutions
+// are found or the node budget is spent.
+void search(counter_t *counter, int depth, long limit, long *found, solve_stats_t *stats)
+{
+    int n = counter->n;
+    grid_state_t *state = counter_level(counter, depth);
+    if (state->open == 0)
+    {
+        (*found)++;
+        return;
+    }
+
+    int best_cell = -1, best_count = n + 1;
+    for (int cell = 0; cell < n * n && best_count > 2; cell++)
+    {
+        int count = __builtin_popcountll(state->cand[cell]);
+        if (!state->value[cell] && count < best_count)
         {
-            inner[j] = indices[j];
+            best_cell = cell;
+            best_count = count;
         }
-        shuffle(inner, base);
-        for (int j = 0; j < base; j++)
+    }
+
+    int best_unit = -1, best_digit = -1;
+    for (int u = 0; u < 3 * n && best_count > 2; u++)
+    {
+        const int *unit = &counter->units[u * n];
+        int places[MAX_UNIQUE_SIZE] = {0};
+        for (int k = 0; k < n; k++)
+        {
+            if (state->value[unit[k]])
+            {
+                continue;
+            }
+            for (uint64_t m = state->cand[unit[k]]; m; m &= m - 1)
+            {
+                places[__builtin_ctzll(m)]++;
+            }
+        }
+        for (int d = 0; d < n; d++)
         {
-            cols[idx++] = bc * base + inner[j];
+            if (places[d] > 0 && places[d] < best_count)
+            {
+                best_unit = u;
+                best_digit = d;
+                best_count = places[d];
+            }
         }
-        free(inner);
     }
 
-    int *nums = malloc(n * sizeof(int));
-    if (!nums)
+    // Branch k places (cell, digit): candidate k of best_cell, or place k of
+    // best_digit in best_unit
+    for (int k = 0; k < n && *found < limit && !counter->gave_up; k++)
     {
-        fprintf(stderr, "Memory allocation error\n");
-        return 1;
+        if (counter->max_nodes > 0 && stats->nodes >= counter->max_nodes)
+        {
+            counter->gave_up = 1;
+            break;
+        }
+        grid_state_t *next = counter_level(counter, depth + 1);
+        state = &counter->levels[depth]; // counter_level may have moved the levels
+        int cell = best_unit >= 0 ? counter->units[best_unit * n + k] : best_cell;
+        int d = best_unit >= 0 ? best_digit : k;
+        if (state->value[cell] || !(state->cand[cell] >> d & 1))
+        {
+            continue;
+        }
+        state_copy(next, state, n);
+        stats->nodes++;
+        counter->queue_len = 0;
+        if (assign(counter, next, cell, d) && propagate(counter, next, stats))
+        {
+            search(counter, depth + 1, limit, found, stats);
+        }
     }
-    for (int i = 0; i < n; i++)
+}
+
+// Set levels[0] to the givens of grid (n * n, 0 = empty), without
+// propagating. Returns 0 if two givens clash.
+int load_grid(counter_t *counter, const int *grid)
+{
+    int n = counter->n;
+    grid_state_t *state = counter_level(counter, 0);
+    counter->gave_up = 0;
+    for (int cell = 0; cell < n * n; cell++)
     {
-        nums[i] = i + 1;
+        state->cand[cell] = counter->all;
+        state->value[cell] = 0;
     }
-    shuffle(nums, n);
+    state->open = n * n;
 
-    int **board = malloc(n * sizeof(int *));
-    int **puzzle = malloc(n * sizeof(int *));
-    if (!board || !puzzle)
+    counter->queue_len = 0;
+    for (int cell = 0; cell < n * n; cell++)
     {
-        fprintf(stderr, "Memory allocation error\n");
-        return 1;
+        if (grid[cell] && !assign(counter, state, cell, grid[cell] - 1))
+        {
+            return 0;
+        }
     }
-    for (int i = 0; i < n; i++)
+    return 1;
+}
+
+// Number of solutions of grid, counting at most limit
+long count_solutions(counter_t *counter, const int *grid, long limit, solve_stats_t *stats)
+{
+    if (!load_grid(counter, grid) || !propagate(counter, &counter->levels[0], stats))
+    {
+        return 0;
+    }
+    long found = 0;
+    search(counter, 0, limit, &found, stats);
+    return found;
+}
+
+// Whether grid, with cell left empty, has a solution where cell is not d + 1.
+// If grid with d + 1 in cell has a unique solution, that is exactly the
+// question whether emptying cell loses uniqueness, and it is cheaper to
+// answer than counting to two: the search may stop at the first solution and
+// starts with one candidate fewer. Returns 1 or 0, or -1 if the node budget
+// ran out first.
+int has_other_solution(counter_t *counter, const int *grid, int cell, int d, solve_stats_t *stats)
+{
+    if (!load_grid(counter, grid))
+    {
+        return 0;
+    }
+    grid_state_t *state = &counter->levels[0];
+    if (!eliminate(counter, state, cell, 1ULL << d) || !propagate(counter, state, stats))
+    {
+        return 0;
+    }
+    long found = 0;
+    search(counter, 0, 1, &found, stats);
+    if (found == 0 && counter->gave_up)
+    {
+        return -1;
+    }
+    return found > 0;
+}
+
+// Remove up to target cells from puzzle, visiting them in the given order
+// and keeping a removal only if the puzzle still has exactly one solution.
+//
+// The next batch of candidate cells is checked in parallel, one per thread,
+// against the current puzzle. The first cell in the batch that passes is
+// removed; the cells before it are settled, and all cells after it are
+// checked again against the new puzzle. Even a cell that failed is: with a
+// node limit, the check against the sparser puzzle may run out instead, and
+// it must count as undecided then, as it would checking one cell at a time.
+// This gives the same puzzle and undecided count whatever the thread count.
+//
+// Proving uniqueness can take exponential search on large sparse grids, so
+// each check gets max_nodes search nodes (0 for no limit). A cell whose
+// check runs out is kept, which leaves the puzzle unique but maybe not as
+// sparse as it could be; undecided gets the number of such cells. With no
+// such cells and target >= total the result is minimal: every given left is
+// needed for uniqueness.
+//
+// Called from inside a parallel region (corpus generation, one puzzle per
+// thread) the checks run one at a time.
+int dig_unique(int *puzzle, int n, int base, int *order, int total, int target, long max_nodes,
+               int *undecided)
+{
+    int threads = omp_in_parallel() ? 1 : omp_get_max_threads();
+    counter_t *counters = checked_malloc(threads * sizeof(counter_t));
+    int *scratch = checked_malloc((size_t)threads * n * n * sizeof(int));
+    int *status = checked_malloc(threads * sizeof(int));
+    int *retry = checked_malloc(threads * sizeof(int));
+    for (int t = 0; t < threads; t++)
     {
-        board[i] = malloc(n * sizeof(int));
-        puzzle[i] = malloc(n * sizeof(int));
-        if (!board[i] || !puzzle[i])
+        counter_init(&counters[t], n, base);
+        counters[t].max_nodes = max_nodes;
+    }
+
+    int removed = 0, pos = 0;
+    *undecided = 0;
+    while (pos < total && removed < target)
+    {
+        int batch = total - pos < threads ? total - pos : threads;
+
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+        for (int k = 0; k < batch; k++)
         {
-            fprintf(stderr, "Memory allocation error\n");
-            return 1;
+            int t = omp_get_thread_num();
+            int *grid = &scratch[(size_t)t * n * n];
+            int cell = order[pos + k];
+            solve_stats_t stats = {0};
+            memcpy(grid, puzzle, (size_t)n * n * sizeof(int));
+            grid[cell] = 0;
+            status[k] = has_other_solution(&counters[t], grid, cell, puzzle[cell] - 1, &stats);
         }
+
+        int accepted = 0, num_retry = 0;
+        for (int k = 0; k < batch; k++)
+        {
+            if (accepted)
+            {
+                retry[num_retry++] = order[pos + k];
+            }
+            else if (status[k] < 0)
+            {
+                (*undecided)++;
+            }
+            else if (status[k] == 0)
+            {
+                puzzle[order[pos + k]] = 0;
+                removed++;
+                accepted = 1;
+            }
+        }
+
+        pos += batch - num_retry;
+        memcpy(&order[pos], retry, num_retry * sizeof(int));
+    }
+
+    for (int t = 0; t < threads; t++)
+    {
+        counter_free(&counters[t]);
     }
+    free(counters);
+    free(scratch);
+    free(status);
+    free(retry);
+    return removed;
+}
+
+// Rate a unique puzzle by the hardest step it takes to solve it and prove
+// uniqueness: naked singles only (easy), hidden singles (medium), locked
+// candidates (hard) or search (expert)
+const char *rate_puzzle(const int *puzzle, int n, int base, solve_stats_t *stats)
+{
+    counter_t counter;
+    counter_init(&counter, n, base);
+    memset(stats, 0, sizeof(*stats));
+    count_solutions(&counter, puzzle, 2, stats);
+    counter_free(&counter);
 
+    if (stats->nodes > 0)
+    {
+        return "expert";
+    }
+    if (stats->locked > 0)
+    {
+        return "hard";
+    }
+    return stats->hidden_singles > 0 ? "medium" : "easy";
+}
+
+void write_grid(FILE *file, const int *grid, int n)
+{
+    fprintf(file, "%d\n", n);
     for (int i = 0; i < n; i++)
     {
         for (int j = 0; j < n; j++)
         {
-            int r = rows[i];
-            int c = cols[j];
-            int pos = (base * (r % base) + (r / base) + c) % n;
-            board[i][j] = nums[pos];
+            fprintf(file, "%d ", grid[i * n + j]);
         }
+        fprintf(file, "\n");
     }
+}
 
-    for (int i = 0; i < n; i++)
+// Run dig_unique restarts times on copies of board, each visiting the cells
+// in its own random order, and put the one with the most cells removed (the
+// first on a tie) in puzzle. Greedy removal ends wherever its order leads
+// it, so different orders give minimal puzzles of different sizes. The
+// restarts run in parallel, one per thread, and each has its own random
+// stream, so the result does not depend on the thread count.
+int dig_restarts(const int *board, int *puzzle, int n, int base, int target, long max_nodes,
+                 int restarts, int *undecided, rng_t *rng)
+{
+    int total_cells = n * n;
+    uint64_t restart_seed = (uint64_t)rng_next(rng) << 32 | rng_next(rng);
+    int *trials = checked_malloc((size_t)restarts * total_cells * sizeof(int));
+    int *removed = checked_malloc(restarts * sizeof(int));
+    int *trial_undecided = checked_malloc(restarts * sizeof(int));
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int r = 0; r < restarts; r++)
     {
-        for (int j = 0; j < n; j++)
+        int *trial = &trials[(size_t)r * total_cells];
+        int *order = checked_malloc(total_cells * sizeof(int));
+        rng_t trial_rng;
+        rng_seed(&trial_rng, restart_seed, r);
+        memcpy(trial, board, total_cells * sizeof(int));
+        for (int i = 0; i < total_cells; i++)
+        {
+            order[i] = i;
+        }
+        shuffle(order, total_cells, &trial_rng);
+        removed[r] = dig_unique(trial, n, base, order, total_cells, target, max_nodes, &trial_undecided[r]);
+        free(order);
+    }
+
+    int best = 0;
+    for (int r = 1; r < restarts; r++)
+    {
+        if (removed[r] > removed[best])
         {
-            puzzle[i][j] = board[i][j];
+            best = r;
         }
     }
+    memcpy(puzzle, &trials[(size_t)best * total_cells], total_cells * sizeof(int));
+    *undecided = trial_undecided[best];
+    int result = removed[best];
+
+    free(trials);
+    free(removed);
+    free(trial_undecided);
+    return result;
+}
 
+// Fill board with a new grid and puzzle with it minus cells_to_remove cells,
+// using order (n * n) as scratch. With unique_mode only removals that keep
+// the solution unique are made, and restarts > 1 keeps the best of that many
+// tries (dig_restarts). Returns the number of cells removed. If undecided is
+// not NULL it gets the number of cells kept because their uniqueness check
+// ran out of search nodes.
+int make_puzzle(int *board, int *puzzle, int *order, int n, int base, int cells_to_remove,
+                int unique_mode, long max_nodes, int restarts, int *undecided, rng_t *rng)
+{
     int total_cells = n * n;
-    int cells_to_remove = (int)(removal_rate * total_cells);
+    int kept = 0;
+    fill_board(board, n, base, rng);
+    if (undecided)
+    {
+        *undecided = 0;
+    }
 
-    int *cell_indices = malloc(total_cells * sizeof(int));
-    if (!cell_indices)
+    if (unique_mode && restarts > 1)
     {
-        fprintf(stderr, "Memory allocation error\n");
-        return 1;
+        return dig_restarts(board, puzzle, n, base, cells_to_remove, max_nodes, restarts,
+                            undecided ? undecided : &kept, rng);
     }
+
+    memcpy(puzzle, board, total_cells * sizeof(int));
+
     for (int i = 0; i < total_cells; i++)
     {
-        cell_indices[i] = i;
+        order[i] = i;
     }
-    shuffle(cell_indices, total_cells);
+    shuffle(order, total_cells, rng);
 
+    if (unique_mode)
+    {
+        // With --unique the removal rate is a target: cells whose removal
+        // would allow a second solution are kept
+        return dig_unique(puzzle, n, base, order, total_cells, cells_to_remove, max_nodes,
+                          undecided ? undecided : &kept);
+    }
     for (int i = 0; i < cells_to_remove; i++)
     {
-        int index = cell_indices[i];
-        int r = index / n;
-        int c = index % n;
-        puzzle[r][c] = 0; // 0 represents an empty cell
+        puzzle[order[i]] = 0; // 0 represents an empty cell
     }
-    free(cell_indices);
+    return cells_to_remove;
+}
 
-    char puzzleFileName[64];
-    char solutionFileName[64];
-    sprintf(puzzleFileName, "sudoku_puzzle_%d_%03.0f.txt", n, removal_rate * 100);
-    sprintf(solutionFileName, "sudoku_solution_%d_%03.0f.txt", n, removal_rate * 100);
+// Decimal digits of v (>= 0), without the snprintf overhead
+char *format_number(char *p, int v)
+{
+    char tmp[12];
+    int len = 0;
+    do
+    {
+        tmp[len++] = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    while (len)
+    {
+        *p++ = tmp[--len];
+    }
+    return p;
+}
 
-    FILE *puzzleFile = fopen(puzzleFileName, "w");
-    FILE *solutionFile = fopen(solutionFileName, "w");
-    if (!puzzleFile || !solutionFile)
+// Cells of grid on one line: one character per cell for n <= 9 (the usual
+// 81-character layout), numbers separated by spaces for larger grids
+char *format_cells(char *p, const int *grid, int n)
+{
+    for (int i = 0; i < n * n; i++)
+    {
+        if (n <= 9)
+        {
+            *p++ = '0' + grid[i];
+            continue;
+        }
+        if (i > 0)
+        {
+            *p++ = ' ';
+        }
+        p = format_number(p, grid[i]);
+    }
+    return p;
+}
+
+// Longest line format_cells can produce for one grid
+size_t cells_size(int n)
+{
+    int digits = 1;
+    for (int v = n; v >= 10; v /= 10)
+    {
+        digits++;
+    }
+    return (size_t)n * n * (digits + 1);
+}
+
+#define CORPUS_CHUNK_PER_THREAD 16
+
+// Write count puzzles to filename, one per line as "puzzle,solution" (plus
+// ",rating" with unique_mode), in the layout of format_cells. With binary
+// the file is a puzzle set instead (sudoku_loader.h), each record a puzzle
+// and its solution; the rating is not kept.
+//
+// Puzzles are made in chunks of CORPUS_CHUNK_PER_THREAD per thread. While
+// the threads fill one chunk buffer, one of them writes out the previous
+// chunk from the other buffer, so only two chunks are ever in memory and
+// the lines come out in puzzle order.
+void generate_corpus(const char *filename, long count, uint64_t seed, int n, int base, int cells_to_remove,
+                     int unique_mode, long max_nodes, int restarts, int binary)
+{
+    FILE *file = fopen(filename, binary ? "wb" : "w");
+    if (!file)
+    {
+        fprintf(stderr, "Error opening output file.\n");
+        exit(1);
+    }
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+    if (binary)
+    {
+        puzzle_set_write_header(file, n, base, count, 1);
+    }
+
+    int threads = omp_get_max_threads();
+    long chunk = (long)threads * CORPUS_CHUNK_PER_THREAD;
+    long num_chunks = (count + chunk - 1) / chunk;
+    size_t record_size = binary ? 2 * (size_t)n * n * (n <= 255 ? 1 : 2) : 2 * cells_size(n) + 16;
+    char *records[2];
+    size_t *lengths[2];
+    for (int b = 0; b < 2; b++)
+    {
+        records[b] = checked_malloc(chunk * record_size);
+        lengths[b] = checked_malloc(chunk * sizeof(size_t));
+    }
+
+    double start = omp_get_wtime();
+    #pragma omp parallel num_threads(threads)
+    {
+        int *board = checked_malloc((size_t)n * n * sizeof(int));
+        int *puzzle = checked_malloc((size_t)n * n * sizeof(int));
+        int *order = checked_malloc((size_t)n * n * sizeof(int));
+
+        for (long c = 0; c <= num_chunks; c++)
+        {
+            #pragma omp single nowait
+            if (c > 0)
+            {
+                long done = (c - 1) * chunk;
+                long size = count - done < chunk ? count - done : chunk;
+                char *buf = records[(c - 1) & 1];
+                for (long k = 0; k < size; k++)
+                {
+                    fwrite(buf + k * record_size, 1, lengths[(c - 1) & 1][k], file);
+                }
+            }
+
+            if (c < num_chunks)
+            {
+                long first = c * chunk;
+                long size = count - first < chunk ? count - first : chunk;
+                #pragma omp for schedule(dynamic) nowait
+                for (long k = 0; k < size; k++)
+                {
+                    rng_t rng;
+                    rng_seed(&rng, seed, first + k);
+                    make_puzzle(board, puzzle, order, n, base, cells_to_remove, unique_mode, max_nodes, restarts, NULL,
+                                &rng);
+
+                    char *line = records[c & 1] + k * record_size;
+                    if (binary)
+                    {
+                        unsigned char *end = puzzle_set_pack((unsigned char *)line, puzzle, n);
+                        end = puzzle_set_pack(end, board, n);
+                        lengths[c & 1][k] = end - (unsigned char *)line;
+                        continue;
+                    }
+                    char *p = format_cells(line, puzzle, n);
+                    *p++ = ',';
+                    p = format_cells(p, board, n);
+                    if (unique_mode)
+                    {
+                        solve_stats_t stats;
+                        p += sprintf(p, ",%s", rate_puzzle(puzzle, n, base, &stats));
+                    }
+                    *p++ = '\n';
+                    lengths[c & 1][k] = p - line;
+                }
+            }
+
+            // The chunk just filled is complete and the other buffer written
+            #pragma omp barrier
+        }
+
+        free(board);
+        free(puzzle);
+        free(order);
+    }
+    double elapsed = omp_get_wtime() - start;
+
+    if (fclose(file) != 0)
+    {
+        perror("Error writing output file");
+        exit(1);
+    }
+    for (int b = 0; b < 2; b++)
+    {
+        free(records[b]);
+        free(lengths[b]);
+    }
+    printf("Wrote %ld puzzles to '%s' in %.3f s (%.0f puzzles/s) on %d threads, seed %llu\n",
+           count, filename, elapsed, count / elapsed, threads, (unsigned long long)seed);
+}
+
+#define STREAM_ROWS_PER_THREAD 8
+#define MAX_STREAM_SIZE 65535 // n * n must fit the 32-bit sampler
+
+// One row of a grid in the layout of write_grid. Cells whose bit is set in
+// removed (bit j for column j, may be NULL) are written as 0.
+char *format_pattern_row(char *p, const pattern_t *pattern, int i, const uint64_t *removed)
+{
+    for (int j = 0; j < pattern->n; j++)
+    {
+        int blank = removed && (removed[j >> 6] >> (j & 63) & 1);
+        p = format_number(p, blank ? 0 : pattern_cell(pattern, i, j));
+        *p++ = ' ';
+    }
+    *p++ = '\n';
+    return p;
+}
+
+// Write a puzzle and its solution for --stream without ever holding a grid.
+//
+// Cells come from pattern_cell and the removed cells are picked by selection
+// sampling (Knuth's Algorithm S): walking the cells in order, a cell is
+// removed with probability (removals still needed) / (cells still left), which
+// removes exactly cells_to_remove cells, each set equally likely. The rows
+// are handled in chunks: the sampler marks the chunk's removed cells in a
+// bitmap, then the threads format its rows while one of them writes the
+// previous chunk to both files. Memory is a few chunks of rows, O(n).
+void generate_stream(const char *puzzle_name, const char *solution_name, int n, int base,
+                     long cells_to_remove, rng_t *rng)
+{
+    FILE *puzzle_file = fopen(puzzle_name, "w");
+    FILE *solution_file = fopen(solution_name, "w");
+    if (!puzzle_file || !solution_file)
     {
         fprintf(stderr, "Error opening output files.\n");
+        exit(1);
+    }
+    fprintf(puzzle_file, "%d\n", n);
+    fprintf(solution_file, "%d\n", n);
+
+    pattern_t pattern;
+    pattern_init(&pattern, n, base, rng);
+
+    int threads = omp_get_max_threads();
+    int chunk = threads * STREAM_ROWS_PER_THREAD;
+    if (chunk > n)
+    {
+        chunk = n;
+    }
+    int num_chunks = (n + chunk - 1) / chunk;
+    int words = (n + 63) / 64;
+    size_t row_size = cells_size(n) / n + 1; // one row and its newline
+    uint64_t *removed = checked_malloc((size_t)chunk * words * sizeof(uint64_t));
+    char *rows[2][2];         // [buffer][puzzle, solution]
+    size_t *lengths[2][2];
+    for (int b = 0; b < 2; b++)
+    {
+        for (int f = 0; f < 2; f++)
+        {
+            rows[b][f] = checked_malloc(chunk * row_size);
+            lengths[b][f] = checked_malloc(chunk * sizeof(size_t));
+        }
+    }
+
+    long cells_left = (long)n * n;
+    long to_remove = cells_to_remove;
+    FILE *files[2] = {puzzle_file, solution_file};
+
+    #pragma omp parallel num_threads(threads)
+    for (int c = 0; c <= num_chunks; c++)
+    {
+        int first = c * chunk;
+        int size = n - first < chunk ? n - first : chunk;
+
+        #pragma omp single
+        if (c < num_chunks)
+        {
+            memset(removed, 0, (size_t)size * words * sizeof(uint64_t));
+            for (int k = 0; k < size; k++)
+            {
+                for (int j = 0; j < n && to_remove > 0; j++, cells_left--)
+                {
+                    if (rng_below(rng, cells_left) < to_remove)
+                    {
+                        removed[k * words + (j >> 6)] |= 1ULL << (j & 63);
+                        to_remove--;
+                    }
+                }
+                if (to_remove == 0)
+                {
+                    cells_left = 0; // nothing left to decide
+                }
+            }
+        }
+
+        #pragma omp single nowait
+        if (c > 0)
+        {
+            int done = (c - 1) * chunk;
+            int prev = n - done < chunk ? n - done : chunk;
+            for (int f = 0; f < 2; f++)
+            {
+                for (int k = 0; k < prev; k++)
+                {
+                    fwrite(rows[(c - 1) & 1][f] + k * row_size, 1, lengths[(c - 1) & 1][f][k], files[f]);
+                }
+            }
+        }
+
+        if (c < num_chunks)
+        {
+            #pragma omp for schedule(dynamic) nowait
+            for (int k = 0; k < size; k++)
+            {
+                char *line = rows[c & 1][0] + k * row_size;
+                lengths[c & 1][0][k] = format_pattern_row(line, &pattern, first + k, &removed[k * words]) - line;
+                line = rows[c & 1][1] + k * row_size;
+                lengths[c & 1][1][k] = format_pattern_row(line, &pattern, first + k, NULL) - line;
+            }
+        }
+
+        // The chunk just formatted is complete and the other buffer written
+        #pragma omp barrier
+    }
+
+    if (fclose(puzzle_file) != 0 || fclose(solution_file) != 0)
+    {
+        perror("Error writing output files");
+        exit(1);
+    }
+    for (int b = 0; b < 2; b++)
+    {
+        for (int f = 0; f < 2; f++)
+        {
+            free(rows[b][f]);
+            free(lengths[b][f]);
+        }
+    }
+    free(removed);
+    pattern_free(&pattern);
+}
+
+int main(int argc, char *argv[])
+{
+    int unique_mode = 0;
+    long max_nodes = 200;  // Search budget per uniqueness check, 0 for none
+    long count = 0;        // Set by --count, 0 writes a single puzzle
+    int stream_mode = 0;
+    int minimal_mode = 0;
+    int restarts = 1;      // Greedy removals to try with --unique, the sparsest is kept
+    int max_nodes_set = 0;
+    int binary = 0;        // --binary writes the corpus as a puzzle set
+    const char *output = NULL;
+
+    // Seeded from the clock and pid unless --seed is given, so runs started
+    // in the same second still differ
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t seed = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec + ((uint64_t)getpid() << 32);
+
+    const char *positional[2] = {NULL, NULL};
+    int num_positional = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--unique") == 0)
+        {
+            unique_mode = 1;
+        }
+        else if (strncmp(argv[i], "--max-nodes=", 12) == 0)
+        {
+            max_nodes = atol(argv[i] + 12);
+            max_nodes_set = 1;
+        }
+        else if (strcmp(argv[i], "--minimal") == 0)
+        {
+            minimal_mode = 1;
+            unique_mode = 1;
+        }
+        else if (strncmp(argv[i], "--restarts=", 11) == 0 && atoi(argv[i] + 11) > 0)
+        {
+            restarts = atoi(argv[i] + 11);
+        }
+        else if (strncmp(argv[i], "--seed=", 7) == 0)
+        {
+            seed = strtoull(argv[i] + 7, NULL, 10);
+        }
+        else if (strncmp(argv[i], "--count=", 8) == 0 && atol(argv[i] + 8) > 0)
+        {
+            count = atol(argv[i] + 8);
+        }
+        else if (strcmp(argv[i], "--binary") == 0)
+        {
+            binary = 1;
+        }
+        else if (strcmp(argv[i], "--stream") == 0)
+        {
+            stream_mode = 1;
+        }
+        else if (strncmp(argv[i], "--output=", 9) == 0)
+        {
+            output = argv[i] + 9;
+        }
+        else if (argv[i][0] != '-' && num_positional < 2)
+        {
+            positional[num_positional++] = argv[i];
+        }
+        else
+        {
+            num_positional = 0;
+            break;
+        }
+    }
+
+    if (num_positional < 1)
+    {
+        fprintf(stderr, "Usage: %s [--unique | --minimal] [--max-nodes=K] [--restarts=R] [--seed=S] [--count=K [--binary] [--output=file] | --stream] <sudoku size> [<removal_rate: 0.5>]\n", argv[0]);
         return 1;
     }
 
-    fprintf(puzzleFile, "%d\n", n);
-    fprintf(solutionFile, "%d\n", n);
+    int n = atoi(positional[0]);
+    if (n <= 0)
+    {
+        fprintf(stderr, "Error: sudoku size must be a positive integer.\n");
+        return 1;
+    }
 
-    for (int i = 0; i < n; i++)
+    int base = (int)round(sqrt(n));
+    if (base * base != n)
     {
-        for (int j = 0; j < n; j++)
+        fprintf(stderr, "Error: The sudoku size must be a perfect square.\n");
+        return 1;
+    }
+
+    if (unique_mode && n > MAX_UNIQUE_SIZE)
+    {
+        fprintf(stderr, "Error: --unique supports sizes up to %d.\n", MAX_UNIQUE_SIZE);
+        return 1;
+    }
+
+    double removal_rate = 0.5; // Default removal rate
+    if (num_positional > 1)
+    {
+        removal_rate = atof(positional[1]);
+        if (removal_rate < 0 || removal_rate > 1)
         {
-            fprintf(puzzleFile, "%d ", puzzle[i][j]);
+            fprintf(stderr, "Error: removal rate must be between 0 and 1.\n");
+            return 1;
         }
-        fprintf(puzzleFile, "\n");
     }
 
-    for (int i = 0; i < n; i++)
+    // A minimal puzzle removes every cell it can, and its checks get no node
+    // limit unless one is asked for, so that minimality is proven
+    if (minimal_mode)
     {
-        for (int j = 0; j < n; j++)
+        removal_rate = 1.0;
+        if (!max_nodes_set)
         {
-            fprintf(solutionFile, "%d ", board[i][j]);
+            max_nodes = 0;
         }
-        fprintf(solutionFile, "\n");
     }
 
+    char puzzleFileName[64];
+    char solutionFileName[64];
+    sprintf(puzzleFileName, "sudoku_puzzle_%d_%03.0f.txt", n, removal_rate * 100);
+    sprintf(solutionFileName, "sudoku_solution_%d_%03.0f.txt", n, removal_rate * 100);
+
+    if (stream_mode)
+    {
+        if (unique_mode || count > 0 || binary || n > MAX_STREAM_SIZE)
+        {
+            fprintf(stderr, "Error: --stream works alone and for sizes up to %d.\n", MAX_STREAM_SIZE);
+            return 1;
+        }
+        rng_t rng;
+        rng_seed(&rng, seed, 0);
+        double start = omp_get_wtime();
+        generate_stream(puzzleFileName, solutionFileName, n, base, (long)(removal_rate * ((long)n * n)), &rng);
+        printf("Seed: %llu\n", (unsigned long long)seed);
+        printf("Wrote '%s' and '%s' in %.3f s on %d threads.\n", puzzleFileName, solutionFileName,
+               omp_get_wtime() - start, omp_get_max_threads());
+        return 0;
+    }
+
+    int total_cells = n * n;
+    int cells_to_remove = (int)(removal_rate * total_cells);
+
+    if (binary && count == 0)
+    {
+        count = 1;
+    }
+    if (binary && n > MAX_LOADER_SIZE)
+    {
+        fprintf(stderr, "Error: --binary supports sizes up to %d.\n", MAX_LOADER_SIZE);
+        return 1;
+    }
+    if (count > 0)
+    {
+        char corpusFileName[64];
+        sprintf(corpusFileName, "sudoku_corpus_%d_%03.0f.%s", n, removal_rate * 100, binary ? "sdkb" : "txt");
+        generate_corpus(output ? output : corpusFileName, count, seed, n, base, cells_to_remove, unique_mode,
+                        max_nodes, restarts, binary);
+        return 0;
+    }
+
+    int *board = checked_malloc(total_cells * sizeof(int));
+    int *puzzle = checked_malloc(total_cells * sizeof(int));
+    int *cell_indices = checked_malloc(total_cells * sizeof(int));
+    rng_t rng;
+    rng_seed(&rng, seed, 0);
+
+    double start = omp_get_wtime();
+    int undecided;
+    int removed = make_puzzle(board, puzzle, cell_indices, n, base, cells_to_remove, unique_mode, max_nodes,
+                              restarts, &undecided, &rng);
+    double elapsed = omp_get_wtime() - start;
+    free(cell_indices);
+
+    printf("Seed: %llu\n", (unsigned long long)seed);
+    if (unique_mode)
+    {
+        solve_stats_t stats;
+        const char *rating = rate_puzzle(puzzle, n, base, &stats);
+        printf("Removed %d of %d cells (target %d) in %.3f s on %d threads\n",
+               removed, total_cells, cells_to_remove, elapsed, omp_get_max_threads());
+        printf("Difficulty: %s (naked singles %ld, hidden singles %ld, locked candidates %ld, search nodes %ld)\n",
+               rating, stats.naked_singles, stats.hidden_singles, stats.locked, stats.nodes);
+    }
+    if (minimal_mode && undecided == 0)
+    {
+        printf("Minimal puzzle with %d clues (best of %d restarts)\n", total_cells - removed, restarts);
+    }
+    else if (minimal_mode)
+    {
+        printf("Not proven minimal: %d clues kept because their check ran out of search nodes (raise --max-nodes)\n",
+               undecided);
+    }
+
+    FILE *puzzleFile = fopen(puzzleFileName, "w");
+    FILE *solutionFile = fopen(solutionFileName, "w");
+    if (!puzzleFile || !solutionFile)
+    {
+        fprintf(stderr, "Error opening output files.\n");
+        return 1;
+    }
+
+    write_grid(puzzleFile, puzzle, n);
+    write_grid(solutionFile, board, n);
+
     fclose(puzzleFile);
     fclose(solutionFile);
 
     printf("\nPuzzle and solution have been written to '%s' and '%s'.\n", puzzleFileName, solutionFileName);
 
-    free(indices);
-    free(band_rows);
-    free(band_cols);
-    free(rows);
-    free(cols);
-    free(nums);
-    for (int i = 0; i < n; i++)
-    {
-        free(board[i]);
-        free(puzzle[i]);
-    }
     free(board);
     free(puzzle);
 
@@ -0,0 +1,481 @@
+#ifndef SUDOKU_LOADER_H
+#define SUDOKU_LOADER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Puzzle file loader shared by the file-driven solvers.
+//
+// The format is the one sudoku_generator.c writes: the grid size n, then n
+// rows of n numbers with 0 for an empty cell. The file is mmapped and the
+// numbers are scanned straight out of the mapping instead of one fscanf call
+// per cell. The scanner reads eight bytes at a time: one word operation
+// finds where the number ends and three multiplications give its value
+// (the SWAR digit parsing simdjson uses), with a byte loop near the end of
+// the file and for numbers of eight digits or more.
+//
+// The grid is checked as it is read: n must be a perfect square, every cell
+// must be in 0..n, and no digit may be given twice in a row, column or box.
+// One bit per (unit, digit) is kept for the last check. Rows and boxes are
+// checked in the parsing pass, where their bits stay in cache. Columns are
+// checked afterwards, 64 columns at a time down the whole grid, since
+// checking them row by row touches n * n bits at random and was most of the
+// load time on large grids.
+//
+// Binary puzzle sets
+//
+// Many puzzles go in one container file (.sdkb) that needs no parsing:
+//
+//   header, 32 bytes, little-endian (puzzle_set_header_t)
+//     magic       "SUDOKUB1"
+//     grid_size   n
+//     block_size  sqrt(n)
+//     count       number of records
+//     cell_width  bytes per cell: 1 if n <= 255, else 2
+//     flags       PUZZLE_SET_SOLUTIONS if each record is a puzzle followed
+//                 by its solution, otherwise a record is just the puzzle
+//   count records of record_size bytes, cells row-major, 0 for empty
+//
+// Record i starts at sizeof(puzzle_set_header_t) + i * record_size, so a
+// mapped set is indexed in O(1). load_puzzle accepts a set as well as a
+// text file and takes the record it is asked for.
+
+#define MAX_LOADER_SIZE 46340 // n * n cells must fit an int
+
+#define PUZZLE_SET_MAGIC "SUDOKUB1"
+#define PUZZLE_SET_SOLUTIONS 1
+
+typedef struct
+{
+    char magic[8];
+    uint32_t grid_size;
+    uint32_t block_size;
+    uint64_t count;
+    uint32_t cell_width;
+    uint32_t flags;
+} puzzle_set_header_t;
+
+typedef struct
+{
+    const unsigned char *data; // the whole mapped file
+    size_t size;
+    int grid_size;
+    int block_size;
+    long count;
+    int cell_width;
+    int has_solutions;
+    size_t grid_bytes;  // one grid: n * n * cell_width
+    size_t record_size; // grid_bytes, twice with solutions
+} puzzle_set_t;
+
+typedef struct
+{
+    const char *p;
+    const char *end;
+} puzzle_scanner_t;
+
+// Next unsigned number in the mapping, skipping whitespace. Returns -1 at
+// the end of the file and -2 on any other character.
+static inline long scan_number(puzzle_scanner_t *s)
+{
+    const char *p = s->p, *end = s->end;
+    while (p < end && (*p == ' ' || *p == '\n' || *p == '\t' || *p == '\r'))
+    {
+        p++;
+    }
+    if (p == end)
+    {
+        s->p = p;
+        return -1;
+    }
+    if ((unsigned char)(*p - '0') > 9)
+    {
+        s->p = p;
+        return -2;
+    }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (end - p >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        word ^= 0x3030303030303030ULL; // digits become bytes 0..9
+        uint64_t non_digit = (((word & 0x7F7F7F7F7F7F7F7FULL) + 0x7676767676767676ULL) | word) & 0x8080808080808080ULL;
+        if (non_digit)
+        {
+            int len = __builtin_ctzll(non_digit) >> 3;
+            // Keep the len digits as the low end of an 8 digit number with
+            // leading zeros, then combine pairs, quads and the two halves
+            word <<= (8 - len) * 8;
+            word = (word & 0x0F0F0F0F0F0F0F0FULL) * 2561 >> 8;
+            word = (word & 0x00FF00FF00FF00FFULL) * 6553601 >> 16;
+            word = (word & 0x0000FFFF0000FFFFULL) * 42949672960001ULL >> 32;
+            s->p = p + len;
+            return (uint32_t)word;
+        }
+    }
+#endif
+    long v = 0;
+    while (p < end && (unsigned char)(*p - '0') <= 9 && v <= INT32_MAX)
+    {
+        v = v * 10 + (*p++ - '0');
+    }
+    s->p = p;
+    return v;
+}
+
+// Set bit digit of unit in seen; returns 1 if it was already set
+static inline int mark_seen(uint64_t *seen, size_t words, size_t unit, int digit)
+{
+    uint64_t *word = &seen[unit * words + (digit >> 6)];
+    uint64_t bit = 1ULL << (digit & 63);
+    int was_set = (*word & bit) != 0;
+    *word |= bit;
+    return was_set;
+}
+
+// Check the columns of sudoku, 64 at a time, with the column part of seen
+static inline int check_columns(const int *sudoku, int n, uint64_t *seen, size_t words, const char *filename)
+{
+    for (int first = 0; first < n; first += 64)
+    {
+        int last = first + 64 < n ? first + 64 : n;
+        for (int row = 0; row < n; row++)
+        {
+            for (int col = first; col < last; col++)
+            {
+                int v = sudoku[(size_t)row * n + col];
+                if (v > 0 && mark_seen(seen, words, n + col, v - 1))
+                {
+                    fprintf(stderr, "Error in %s: %d at cell (%d, %d) is already given in its column.\n",
+                            filename, v, row, col);
+                    return 0;
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+// Parse and check the puzzle text in data .. end, see load_puzzle
+static inline int *parse_puzzle(const char *data, const char *end, const char *filename, int *grid_size,
+                                int *block_size)
+{
+    puzzle_scanner_t scanner = {data, end};
+
+    long n = scan_number(&scanner);
+    if (n < 1 || n > MAX_LOADER_SIZE)
+    {
+        fprintf(stderr, "Error reading grid size from %s.\n", filename);
+        return NULL;
+    }
+    int block = 1;
+    while (block * block < n)
+    {
+        block++;
+    }
+    if (block * block != n)
+    {
+        fprintf(stderr, "Grid size must be a perfect square (e.g., 4, 9, 16, ...).\n");
+        return NULL;
+    }
+
+    size_t cells = (size_t)n * n;
+    size_t words = (n + 63) / 64;
+    int *sudoku = malloc(cells * sizeof(int));
+    uint64_t *seen = calloc(3 * n * words, sizeof(uint64_t)); // rows, then columns, then boxes
+    if (!sudoku || !seen)
+    {
+        perror("Memory allocation failed");
+        free(sudoku);
+        free(seen);
+        return NULL;
+    }
+
+    int ok = 1;
+    for (int row = 0; row < n && ok; row++)
+    {
+        for (int col = 0; col < n && ok; col++)
+        {
+            long v = scan_number(&scanner);
+            if (v == -1)
+            {
+                fprintf(stderr, "Error reading sudoku grid from %s: %zu of %zu cells present.\n",
+                        filename, (size_t)row * n + col, cells);
+                ok = 0;
+            }
+            else if (v < 0 || v > n)
+            {
+                fprintf(stderr, "Error in %s: cell (%d, %d) is not a number from 0 to %ld.\n", filename, row, col, n);
+                ok = 0;
+            }
+            else if (v > 0 && (mark_seen(seen, words, row, v - 1) ||
+                               mark_seen(seen, words, 2 * n + (row / block) * block + col / block, v - 1)))
+            {
+                fprintf(stderr, "Error in %s: %ld at cell (%d, %d) is already given in its row or box.\n",
+                        filename, v, row, col);
+                ok = 0;
+            }
+            else
+            {
+                sudoku[(size_t)row * n + col] = v;
+            }
+        }
+    }
+    ok = ok && check_columns(sudoku, n, seen, words, filename);
+
+    free(seen);
+    if (!ok)
+    {
+        free(sudoku);
+        return NULL;
+    }
+    *grid_size = n;
+    *block_size = block;
+    return sudoku;
+}
+
+// Read the header of a mapped puzzle set. Returns 0, after saying why, if it
+// is not a valid set or the file size does not match the header.
+static inline int puzzle_set_from_mapping(const unsigned char *data, size_t size, const char *filename,
+                                          puzzle_set_t *set)
+{
+    puzzle_set_header_t header;
+    if (size < sizeof(header))
+    {
+        fprintf(stderr, "Error in %s: too short for a puzzle set header.\n", filename);
+        return 0;
+    }
+    memcpy(&header, data, sizeof(header));
+    uint32_t n = header.grid_size, block = header.block_size;
+    if (memcmp(header.magic, PUZZLE_SET_MAGIC, 8) != 0 || n < 1 || n > MAX_LOADER_SIZE || block * block != n ||
+        header.cell_width != (n <= 255 ? 1u : 2u))
+    {
+        fprintf(stderr, "Error in %s: not a valid puzzle set header.\n", filename);
+        return 0;
+    }
+
+    set->data = data;
+    set->size = size;
+    set->grid_size = n;
+    set->block_size = block;
+    set->count = header.count;
+    set->cell_width = header.cell_width;
+    set->has_solutions = (header.flags & PUZZLE_SET_SOLUTIONS) != 0;
+    set->grid_bytes = (size_t)n * n * header.cell_width;
+    set->record_size = set->grid_bytes * (set->has_solutions ? 2 : 1);
+    if ((size - sizeof(header)) / set->record_size != header.count ||
+        (size - sizeof(header)) % set->record_size != 0)
+    {
+        fprintf(stderr, "Error in %s: %zu bytes do not hold the %llu records of the header.\n", filename, size,
+                (unsigned long long)header.count);
+        return 0;
+    }
+    return 1;
+}
+
+// Map the puzzle set in filename. Returns 0 after printing an error.
+static inline int open_puzzle_set(const char *filename, puzzle_set_t *set)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("Error opening file");
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        fprintf(stderr, "Error reading %s.\n", filename);
+        close(fd);
+        return 0;
+    }
+    const unsigned char *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror("Error mapping file");
+        return 0;
+    }
+    if (!puzzle_set_from_mapping(data, st.st_size, filename, set))
+    {
+        munmap((void *)data, st.st_size);
+        return 0;
+    }
+    return 1;
+}
+
+static inline void close_puzzle_set(puzzle_set_t *set)
+{
+    munmap((void *)set->data, set->size);
+}
+
+// Cells of record index into grid (n * n ints): its puzzle, or with
+// solution set, its solution (only for sets with PUZZLE_SET_SOLUTIONS)
+static inline void puzzle_set_get(const puzzle_set_t *set, long index, int solution, int *grid)
+{
+    const unsigned char *p = set->data + sizeof(puzzle_set_header_t) + index * set->record_size +
+                             (solution ? set->grid_bytes : 0);
+    size_t cells = (size_t)set->grid_size * set->grid_size;
+    if (set->cell_width == 1)
+    {
+        for (size_t i = 0; i < cells; i++)
+        {
+            grid[i] = p[i];
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < cells; i++)
+        {
+            grid[i] = p[2 * i] | p[2 * i + 1] << 8;
+        }
+    }
+}
+
+// Append grid to a record at p in the cell layout of a puzzle set
+static inline unsigned char *puzzle_set_pack(unsigned char *p, const int *grid, int n)
+{
+    size_t cells = (size_t)n * n;
+    if (n <= 255)
+    {
+        for (size_t i = 0; i < cells; i++)
+        {
+            *p++ = grid[i];
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < cells; i++)
+        {
+            *p++ = grid[i] & 0xFF;
+            *p++ = grid[i] >> 8;
+        }
+    }
+    return p;
+}
+
+static inline void puzzle_set_write_header(FILE *file, int n, int block, long count, int has_solutions)
+{
+    puzzle_set_header_t header = {{0}, n, block, count, n <= 255 ? 1 : 2, has_solutions ? PUZZLE_SET_SOLUTIONS : 0};
+    memcpy(header.magic, PUZZLE_SET_MAGIC, 8);
+    fwrite(&header, sizeof(header), 1, file);
+}
+
+// Puzzle index of a set, checked like a text puzzle
+static inline int *load_from_set(const puzzle_set_t *set, long index, const char *filename, int *grid_size,
+                                 int *block_size)
+{
+    int n = set->grid_size, block = set->block_size;
+    if (index < 0 || index >= set->count)
+    {
+        fprintf(stderr, "Error: %s holds %ld puzzles, there is no puzzle %ld.\n", filename, set->count, index);
+        return NULL;
+    }
+    size_t words = (n + 63) / 64;
+    int *sudoku = malloc((size_t)n * n * sizeof(int));
+    uint64_t *seen = calloc(3 * n * words, sizeof(uint64_t));
+    if (!sudoku || !seen)
+    {
+        perror("Memory allocation failed");
+        free(sudoku);
+        free(seen);
+        return NULL;
+    }
+    puzzle_set_get(set, index, 0, sudoku);
+
+    int ok = 1;
+    for (int row = 0; row < n && ok; row++)
+    {
+        for (int col = 0; col < n && ok; col++)
+        {
+            int v = sudoku[(size_t)row * n + col];
+            if (v > n)
+            {
+                fprintf(stderr, "Error in %s: cell (%d, %d) is not a number from 0 to %d.\n", filename, row, col, n);
+                ok = 0;
+            }
+            else if (v > 0 && (mark_seen(seen, words, row, v - 1) ||
+                               mark_seen(seen, words, 2 * n + (row / block) * block + col / block, v - 1)))
+            {
+                fprintf(stderr, "Error in %s: %d at cell (%d, %d) is already given in its row or box.\n",
+                        filename, v, row, col);
+                ok = 0;
+            }
+        }
+    }
+    ok = ok && check_columns(sudoku, n, seen, words, filename);
+
+    free(seen);
+    if (!ok)
+    {
+        free(sudoku);
+        return NULL;
+    }
+    *grid_size = n;
+    *block_size = block;
+    return sudoku;
+}
+
+// Load and check puzzle index of filename, a text puzzle (index 0 only) or
+// a puzzle set. Returns the grid row-major (free it when done) and sets
+// *grid_size and *block_size, or prints what is wrong and returns NULL.
+static inline int *load_puzzle(const char *filename, long index, int *grid_size, int *block_size)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        perror("Error opening file");
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        perror("Error reading file");
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size == 0)
+    {
+        fprintf(stderr, "Error reading grid size from %s: the file is empty.\n", filename);
+        close(fd);
+        return NULL;
+    }
+    // A text puzzle is read whole, a set only where the record is
+    char magic[8];
+    int is_set = pread(fd, magic, 8, 0) == 8 && memcmp(magic, PUZZLE_SET_MAGIC, 8) == 0;
+    const char *data = mmap(NULL, st.st_size, PROT_READ, is_set ? MAP_PRIVATE : MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror("Error mapping file");
+        return NULL;
+    }
+
+    int *sudoku = NULL;
+    if (is_set)
+    {
+        puzzle_set_t set;
+        if (puzzle_set_from_mapping((const unsigned char *)data, st.st_size, filename, &set))
+        {
+            sudoku = load_from_set(&set, index, filename, grid_size, block_size);
+        }
+    }
+    else if (index != 0)
+    {
+        fprintf(stderr, "Error: %s is a single puzzle, there is no puzzle %ld.\n", filename, index);
+    }
+    else
+    {
+        sudoku = parse_puzzle(data, data + st.st_size, filename, grid_size, block_size);
+    }
+    munmap((void *)data, st.st_size);
+    return sudoku;
+}
+
+#endif
@@ -0,0 +1,468 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+// Microbenchmarks of the kernels the solvers spend their time in, timed on
+// their own so a change to the grid layout or a vectorised kernel can be
+// measured without the noise of a whole search:
+//
+//   check_square     check_sudoku's box scan for one number
+//   check_sudoku     the row, column and box check of one number
+//   find_unassigned  the scan for the first empty cell
+//   candidates_scan  check_sudoku for every number of one cell, the loop
+//                    the backtracking solvers run at every node
+//   candidate_mask   the candidates of one cell as a bitset, in one pass
+//                    over its row, column and box
+//   propagate        load_grid and propagate of the --unique solution
+//                    counter, the propagation of a puzzle's givens (up to
+//                    64x64, the limit of its masks)
+//   grid_copy        the copy of a grid a solver task makes
+//
+// The kernels are the solvers' own: sudoku_solver_serial.c and
+// sudoku_generator.c are compiled into this file, so they are timed as
+// the solvers compile them, inlining included.
+//
+// For every size the inputs are NUM_STATES search states made from a
+// random grid with a fixed seed: the grid with cells removed at the removal
+// rate, like a generated puzzle, and then a prefix of random length filled
+// back in row-major order, like the backtracking solvers fill it. Each call
+// picks its state, cell and number from a precomputed list, so no call can
+// be hoisted out of the timing loop. A kernel runs until one repetition
+// takes --time seconds, and the best and median ns/op of --reps
+// repetitions are reported.
+
+#define main sudoku_solver_serial_main
+#include "sudoku_solver_serial.c"
+#undef main
+
+// sudoku_output.h has a write_grid of its own
+#define main sudoku_generator_main
+#define write_grid generator_write_grid
+#include "sudoku_generator.c"
+#undef write_grid
+#undef main
+
+#define NUM_STATES 64    // search states per size
+#define NUM_QUERIES 4096 // (state, cell, number) per call, a power of two
+#define MAX_SIZES 16
+#define MAX_SIZE 256
+#define MAX_REPS 100
+#define MASK_WORDS ((MAX_SIZE + 63) / 64)
+
+typedef struct
+{
+    int n;
+    int block;
+    int *states;  // NUM_STATES grids of n * n
+    int *scratch; // destination of grid_copy
+    int query_state[NUM_QUERIES];
+    int query_row[NUM_QUERIES]; // the first empty cell of the state
+    int query_col[NUM_QUERIES];
+    int query_num[NUM_QUERIES];
+    counter_t counter; // for propagate, n <= MAX_UNIQUE_SIZE
+    solve_stats_t stats;
+} workload_t;
+
+// Each kernel runs iterations calls and returns something that depends on
+// all of them
+typedef struct
+{
+    const char *name;
+    long (*run)(workload_t *w, long iterations);
+    int max_size;
+} kernel_t;
+
+static volatile long sink; // results of the timed loops, so they are not optimised away
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static long bench_check_square(workload_t *w, long iterations)
+{
+    size_t cells = (size_t)w->n * w->n;
+    long sum = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        int q = i & (NUM_QUERIES - 1);
+        sum += check_square(&w->states[w->query_state[q] * cells], w->n, w->block, w->query_num[q], w->query_row[q],
+                            w->query_col[q]);
+    }
+    return sum;
+}
+
+static long bench_check_sudoku(workload_t *w, long iterations)
+{
+    size_t cells = (size_t)w->n * w->n;
+    long sum = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        int q = i & (NUM_QUERIES - 1);
+        sum += check_sudoku(&w->states[w->query_state[q] * cells], w->n, w->block, w->query_num[q], w->query_row[q],
+                            w->query_col[q]);
+    }
+    return sum;
+}
+
+static long bench_find_unassigned(workload_t *w, long iterations)
+{
+    size_t cells = (size_t)w->n * w->n;
+    long sum = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        int row, col;
+        if (find_unassigned(&w->states[(i % NUM_STATES) * cells], w->n, &row, &col))
+        {
+            sum += row * w->n + col;
+        }
+    }
+    return sum;
+}
+
+static long bench_candidates_scan(workload_t *w, long iterations)
+{
+    size_t cells = (size_t)w->n * w->n;
+    long sum = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        int q = i & (NUM_QUERIES - 1);
+        int *grid = &w->states[w->query_state[q] * cells];
+        for (int num = 1; num <= w->n; num++)
+        {
+            sum += check_sudoku(grid, w->n, w->block, num, w->query_row[q], w->query_col[q]);
+        }
+    }
+    return sum;
+}
+
+// Candidates of (row, col) as a bitset, bit d - 1 for number d, in mask.
+// Returns how many there are.
+static int candidate_mask(const int *grid, int n, int block, int row, int col, uint64_t *mask)
+{
+    int words = (n + 63) / 64;
+    uint64_t used[MASK_WORDS] = {0};
+    int row_start = row - row % block, col_start = col - col % block;
+    for (int i = 0; i < n; i++)
+    {
+        int values[3] = {grid[row * n + i], grid[i * n + col],
+                         grid[(row_start + i / block) * n + col_start + i % block]};
+        for (int k = 0; k < 3; k++)
+        {
+            if (values[k])
+            {
+                used[(values[k] - 1) >> 6] |= 1ULL << ((values[k] - 1) & 63);
+            }
+        }
+    }
+    int count = 0;
+    for (int k = 0; k < words; k++)
+    {
+        int bits = n - 64 * k < 64 ? n - 64 * k : 64;
+        mask[k] = ~used[k] & (bits == 64 ? ~0ULL : (1ULL << bits) - 1);
+        count += __builtin_popcountll(mask[k]);
+    }
+    return count;
+}
+
+static long bench_candidate_mask(workload_t *w, long iterations)
+{
+    size_t cells = (size_t)w->n * w->n;
+    long sum = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        int q = i & (NUM_QUERIES - 1);
+        uint64_t mask[MASK_WORDS];
+        sum += candidate_mask(&w->states[w->query_state[q] * cells], w->n, w->block, w->query_row[q], w->query_col[q],
+                              mask);
+    }
+    return sum;
+}
+
+static long bench_propagate(workload_t *w, long iterations)
+{
+    size_t cells = (size_t)w->n * w->n;
+    long sum = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        if (load_grid(&w->counter, &w->states[(i % NUM_STATES) * cells]) &&
+            propagate(&w->counter, &w->counter.levels[0], &w->stats))
+        {
+            sum += w->counter.levels[0].open;
+        }
+    }
+    return sum;
+}
+
+static long bench_grid_copy(workload_t *w, long iterations)
+{
+    size_t cells = (size_t)w->n * w->n;
+    long sum = 0;
+    for (long i = 0; i < iterations; i++)
+    {
+        memcpy(w->scratch, &w->states[(i % NUM_STATES) * cells], cells * sizeof(int));
+        sum += w->scratch[i % cells];
+    }
+    return sum;
+}
+
+static const kernel_t kernels[] = {
+    {"check_square", bench_check_square, MAX_SIZE},
+    {"check_sudoku", bench_check_sudoku, MAX_SIZE},
+    {"find_unassigned", bench_find_unassigned, MAX_SIZE},
+    {"candidates_scan", bench_candidates_scan, MAX_SIZE},
+    {"candidate_mask", bench_candidate_mask, MAX_SIZE},
+    {"propagate", bench_propagate, MAX_UNIQUE_SIZE},
+    {"grid_copy", bench_grid_copy, MAX_SIZE},
+};
+#define NUM_KERNELS ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+static const int default_sizes[] = {9, 16, 25, 36, 49, 64, 81, 100, 121};
+#define NUM_DEFAULT_SIZES ((int)(sizeof(default_sizes) / sizeof(default_sizes[0])))
+
+// The search states of one size, see the top of the file
+static void workload_init(workload_t *w, int n, uint64_t seed, double removal)
+{
+    size_t cells = (size_t)n * n;
+    w->n = n;
+    w->block = (int)sqrt(n);
+    w->states = checked_malloc(NUM_STATES * cells * sizeof(int));
+    w->scratch = checked_malloc(cells * sizeof(int));
+
+    rng_t rng;
+    rng_seed(&rng, seed, n);
+    int *solution = checked_malloc(cells * sizeof(int));
+    fill_board(solution, n, w->block, &rng);
+    uint32_t threshold = (uint32_t)(removal * 4294967296.0 > 4294967295.0 ? 4294967295.0 : removal * 4294967296.0);
+    for (int s = 0; s < NUM_STATES; s++)
+    {
+        int *grid = &w->states[s * cells];
+        size_t prefix = rng_below(&rng, cells);
+        for (size_t c = 0; c < cells; c++)
+        {
+            grid[c] = c < prefix || rng_next(&rng) >= threshold ? solution[c] : 0;
+        }
+        grid[cells - 1] = 0; // at least one empty cell
+    }
+    free(solution);
+
+    for (int q = 0; q < NUM_QUERIES; q++)
+    {
+        int s = rng_below(&rng, NUM_STATES), row = 0, col = 0;
+        find_unassigned(&w->states[s * cells], n, &row, &col);
+        w->query_state[q] = s;
+        w->query_row[q] = row;
+        w->query_col[q] = col;
+        w->query_num[q] = rng_below(&rng, n) + 1;
+    }
+
+    if (n <= MAX_UNIQUE_SIZE)
+    {
+        counter_init(&w->counter, n, w->block);
+    }
+    memset(&w->stats, 0, sizeof(w->stats));
+}
+
+static void workload_free(workload_t *w)
+{
+    free(w->states);
+    free(w->scratch);
+    if (w->n <= MAX_UNIQUE_SIZE)
+    {
+        counter_free(&w->counter);
+    }
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Time kernel on w: grow the iteration count until one repetition takes
+// min_time (which also warms up caches and branch predictors), then run reps
+// repetitions. Sets *best and *median in ns per call; returns the count.
+static long measure(const kernel_t *kernel, workload_t *w, double min_time, int reps, double *best, double *median)
+{
+    long iterations = 1;
+    for (;;)
+    {
+        double start = now_seconds();
+        sink += kernel->run(w, iterations);
+        double elapsed = now_seconds() - start;
+        if (elapsed >= min_time)
+        {
+            break;
+        }
+        double factor = elapsed > 0 ? 1.2 * min_time / elapsed : 10;
+        iterations = (long)ceil(iterations * (factor < 10 ? factor : 10));
+    }
+
+    double times[MAX_REPS];
+    for (int r = 0; r < reps; r++)
+    {
+        double start = now_seconds();
+        sink += kernel->run(w, iterations);
+        times[r] = (now_seconds() - start) * 1e9 / iterations;
+    }
+    qsort(times, reps, sizeof(double), compare_double);
+    *best = times[0];
+    *median = reps % 2 ? times[reps / 2] : (times[reps / 2 - 1] + times[reps / 2]) / 2;
+    return iterations;
+}
+
+// Split list in place at commas. Returns the number of items.
+static int split_list(char *list, char *items[], int max_items)
+{
+    int count = 0;
+    for (char *item = strtok(list, ","); item && count < max_items; item = strtok(NULL, ","))
+    {
+        items[count++] = item;
+    }
+    return count;
+}
+
+int main(int argc, char *argv[])
+{
+    char *kernel_list = NULL;
+    char *size_list = NULL;
+    double min_time = 0.05;
+    int reps = 5;
+    uint64_t seed = 1;
+    double removal = 0.5;
+    const char *csv_file = "microbench.csv";
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "--kernels=", 10) == 0)
+        {
+            kernel_list = argv[i] + 10;
+        }
+        else if (strncmp(argv[i], "--sizes=", 8) == 0)
+        {
+            size_list = argv[i] + 8;
+        }
+        else if (strncmp(argv[i], "--time=", 7) == 0 && atof(argv[i] + 7) > 0)
+        {
+            min_time = atof(argv[i] + 7);
+        }
+        else if (strncmp(argv[i], "--reps=", 7) == 0 && atoi(argv[i] + 7) > 0 && atoi(argv[i] + 7) <= MAX_REPS)
+        {
+            reps = atoi(argv[i] + 7);
+        }
+        else if (strncmp(argv[i], "--seed=", 7) == 0)
+        {
+            seed = strtoull(argv[i] + 7, NULL, 10);
+        }
+        else if (strncmp(argv[i], "--removal=", 10) == 0 && atof(argv[i] + 10) >= 0 && atof(argv[i] + 10) <= 1)
+        {
+            removal = atof(argv[i] + 10);
+        }
+        else if (strncmp(argv[i], "--csv=", 6) == 0)
+        {
+            csv_file = argv[i] + 6;
+        }
+        else
+        {
+            fprintf(stderr,
+                    "Usage: %s [--kernels=check_square,check_sudoku,find_unassigned,candidates_scan,candidate_mask,"
+                    "propagate,grid_copy] [--sizes=9,16,...] [--time=S] [--reps=R] [--seed=S] [--removal=rate] "
+                    "[--csv=file]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    const kernel_t *selected[NUM_KERNELS];
+    int num_selected = 0;
+    char *names[NUM_KERNELS * 2];
+    int num_names = kernel_list ? split_list(kernel_list, names, NUM_KERNELS * 2) : 0;
+    for (int k = 0; k < num_names; k++)
+    {
+        int known = 0;
+        for (int b = 0; b < NUM_KERNELS; b++)
+        {
+            known |= strcmp(names[k], kernels[b].name) == 0;
+        }
+        if (!known)
+        {
+            fprintf(stderr, "Unknown kernel: %s\n", names[k]);
+            return 1;
+        }
+    }
+    for (int b = 0; b < NUM_KERNELS; b++)
+    {
+        int wanted = !kernel_list;
+        for (int k = 0; k < num_names; k++)
+        {
+            wanted |= strcmp(names[k], kernels[b].name) == 0;
+        }
+        if (wanted)
+        {
+            selected[num_selected++] = &kernels[b];
+        }
+    }
+
+    int sizes[MAX_SIZES];
+    int num_sizes = NUM_DEFAULT_SIZES;
+    memcpy(sizes, default_sizes, sizeof(default_sizes));
+    if (size_list)
+    {
+        char *items[MAX_SIZES];
+        num_sizes = split_list(size_list, items, MAX_SIZES);
+        for (int s = 0; s < num_sizes; s++)
+        {
+            sizes[s] = atoi(items[s]);
+            int block = (int)sqrt(sizes[s]);
+            if (sizes[s] < 4 || sizes[s] > MAX_SIZE || block * block != sizes[s])
+            {
+                fprintf(stderr, "Size %s is not a perfect square from 4 to %d\n", items[s], MAX_SIZE);
+                return 1;
+            }
+        }
+    }
+
+    FILE *csv = fopen(csv_file, "w");
+    if (!csv)
+    {
+        perror("Error opening CSV file");
+        return 1;
+    }
+    fprintf(csv, "kernel,size,iterations,best_ns,median_ns\n");
+
+    printf("Seed %llu, removal rate %.2f, %d states per size, best and median of %d repetitions of %.3f s\n",
+           (unsigned long long)seed, removal, NUM_STATES, reps, min_time);
+    printf("%-16s %5s %14s %14s\n", "kernel", "size", "best (ns/op)", "median (ns/op)");
+    for (int s = 0; s < num_sizes; s++)
+    {
+        workload_t w;
+        workload_init(&w, sizes[s], seed, removal);
+        for (int k = 0; k < num_selected; k++)
+        {
+            const kernel_t *kernel = selected[k];
+            if (sizes[s] > kernel->max_size)
+            {
+                printf("%-16s %5d %14s %14s\n", kernel->name, sizes[s], "n/a", "n/a");
+                continue;
+            }
+            double best, median;
+            long iterations = measure(kernel, &w, min_time, reps, &best, &median);
+            printf("%-16s %5d %14.2f %14.2f\n", kernel->name, sizes[s], best, median);
+            fprintf(csv, "%s,%d,%ld,%.3f,%.3f\n", kernel->name, sizes[s], iterations, best, median);
+            fflush(stdout);
+            fflush(csv);
+        }
+        workload_free(&w);
+    }
+    if (fclose(csv) != 0)
+    {
+        perror("Error writing CSV file");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,196 @@
+#ifndef SUDOKU_OUTPUT_H
+#define SUDOKU_OUTPUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sudoku_loader.h"
+
+// Grid and timing output shared by the solvers.
+//
+// A grid is formatted into one buffer and written with a single fwrite
+// instead of one printf per cell, which on 121x121 meant tens of thousands
+// of stdio calls into the SLURM log. Every cell is padded to the width of
+// the largest digit, so the columns line up for any n.
+//
+// The options come from the command line:
+//
+//   --quiet          print no grids, only the timing and result lines
+//   --output=FILE    write the solution to FILE: the n rows of the grid as
+//                    scripts/verify_sudoku_solution.py reads them
+//   --binary         write FILE as a puzzle set (sudoku_loader.h) with one
+//                    record holding the puzzle and its solution
+//
+// The solvers take their end timestamp before calling anything here, so
+// formatting is never part of a measured time.
+
+typedef struct
+{
+    int quiet;
+    const char *file; // NULL: solution only on stdout
+    int binary;
+} output_options_t;
+
+// Consume arg if it is one of the options above. Returns 1 if it was.
+static inline int output_parse_option(output_options_t *options, const char *arg)
+{
+    if (strcmp(arg, "--quiet") == 0)
+    {
+        options->quiet = 1;
+    }
+    else if (strncmp(arg, "--output=", 9) == 0 && arg[9] != '\0')
+    {
+        options->file = arg + 9;
+    }
+    else if (strcmp(arg, "--binary") == 0)
+    {
+        options->binary = 1;
+    }
+    else
+    {
+        return 0;
+    }
+    return 1;
+}
+
+#define OUTPUT_USAGE "[--quiet] [--output=file [--binary]]"
+
+// Digits in the decimal form of v >= 0
+static inline int output_digits(int v)
+{
+    int digits = 1;
+    while (v >= 10)
+    {
+        v /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+// Format grid as n rows of right-aligned cells into a new buffer and return
+// it; *length is set to the bytes used.
+static inline char *format_grid(const int *grid, int n, size_t *length)
+{
+    int width = output_digits(n);
+    size_t row_bytes = (size_t)n * (width + 1);
+    char *text = malloc(row_bytes * n + 1);
+    if (!text)
+    {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    char *p = text;
+    for (int i = 0; i < n; i++)
+    {
+        for (int j = 0; j < n; j++)
+        {
+            int v = grid[(size_t)i * n + j];
+            char *end = p + width;
+            do
+            {
+                *--end = '0' + v % 10;
+                v /= 10;
+            } while (v > 0 && end > p);
+            while (end > p)
+            {
+                *--end = ' ';
+            }
+            p += width;
+            *p++ = j + 1 < n ? ' ' : '\n';
+        }
+    }
+    *length = p - text;
+    return text;
+}
+
+// Write title and grid to out with one write call
+static inline void write_grid(FILE *out, const char *title, const int *grid, int n)
+{
+    size_t length;
+    char *text = format_grid(grid, n, &length);
+    if (title)
+    {
+        fputs(title, out);
+        fputc('\n', out);
+    }
+    fwrite(text, 1, length, out);
+    free(text);
+}
+
+// Print a grid on stdout unless the run is quiet
+static inline void output_grid(const output_options_t *options, const char *title, const int *grid, int n)
+{
+    if (!options->quiet)
+    {
+        write_grid(stdout, title, grid, n);
+    }
+}
+
+// Print the solution and write it to the output file if there is one.
+// puzzle is only needed for --binary. Returns 0 after printing an error.
+static inline int output_solution(const output_options_t *options, const char *title, const int *puzzle,
+                                  const int *solution, int n, int block)
+{
+    output_grid(options, title, solution, n);
+    if (!options->file)
+    {
+        return 1;
+    }
+
+    FILE *out = fopen(options->file, options->binary ? "wb" : "w");
+    if (!out)
+    {
+        perror("Error opening output file");
+        return 0;
+    }
+    if (options->binary)
+    {
+        unsigned char *record = malloc((size_t)n * n * (n > 255 ? 2 : 1) * 2);
+        if (!record)
+        {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+        puzzle_set_write_header(out, n, block, 1, 1);
+        unsigned char *end = puzzle_set_pack(puzzle_set_pack(record, puzzle, n), solution, n);
+        fwrite(record, 1, end - record, out);
+        free(record);
+    }
+    else
+    {
+        write_grid(out, NULL, solution, n);
+    }
+    if (fclose(out) != 0)
+    {
+        perror("Error writing output file");
+        return 0;
+    }
+    return 1;
+}
+
+static inline double elapsed_ms(const struct timespec *start, const struct timespec *end)
+{
+    long sec_diff = end->tv_sec - start->tv_sec;
+    long nsec_diff = end->tv_nsec - start->tv_nsec;
+    if (nsec_diff < 0)
+    {
+        sec_diff--;
+        nsec_diff += 1000000000;
+    }
+    return sec_diff * 1000.0 + nsec_diff / 1000000.0;
+}
+
+// Print "Time taken to solve (label): ..." split into hours down to ms
+static inline void print_elapsed(const char *label, double total_ms)
+{
+    int hrs = total_ms / (3600.0 * 1000.0);
+    double remainder = total_ms - hrs * 3600.0 * 1000.0;
+    int mins = remainder / (60.0 * 1000.0);
+    remainder -= mins * 60.0 * 1000.0;
+    int secs = remainder / 1000.0;
+    double ms = remainder - secs * 1000.0;
+    printf("Time taken to solve (%s): %02dhr: %02dmin: %02dsec: %06.2fms\n", label, hrs, mins, secs, ms);
+}
+
+#endif
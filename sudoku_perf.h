@@ -0,0 +1,256 @@
+#ifndef SUDOKU_PERF_H
+#define SUDOKU_PERF_H
+
+// Hardware counters around the solve, compiled in with -DSOLVER_PERF (Linux
+// only). Without it every PERF_* macro expands to nothing.
+//
+// Each thread that runs search work calls PERF_BEGIN when it starts and
+// PERF_END when it stops, which opens perf_event_open counters for that
+// thread alone, so parsing, printing and the other threads never show up
+// in them. PERF_PRINT then prints the sum and, for more than one thread, a
+// line per thread:
+//
+//   task-clock      CPU time of the thread (a software counter)
+//   cycles, instructions and IPC (instructions per cycle)
+//   L1D misses      L1 data cache read misses, and per 1000 instructions
+//   LLC misses      last level cache read misses, and per 1000 instructions
+//   branch misses   mispredicted branches, and per 1000 instructions
+//
+// A counter the machine or kernel does not offer (virtual machines often
+// have no PMU, and perf_event_paranoid can forbid them) prints as n/a, with
+// the reason once. Counts are scaled when the kernel had to multiplex them.
+
+#ifdef SOLVER_PERF
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PERF_NUM_EVENTS 6
+#define PERF_CACHE_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+enum
+{
+    PERF_TASK_CLOCK,
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_BRANCH_MISSES
+};
+
+static const struct
+{
+    const char *name;
+    unsigned type;
+    unsigned long long config;
+} perf_events[PERF_NUM_EVENTS] = {
+    {"task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"L1D misses", PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D)},
+    {"LLC misses", PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_LL)},
+    {"branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+typedef struct perf_thread
+{
+    int fd[PERF_NUM_EVENTS];
+    double value[PERF_NUM_EVENTS];
+    int counted[PERF_NUM_EVENTS]; // the counter could be opened
+    int index;
+    struct perf_thread *next; // all threads, for PERF_PRINT
+} perf_thread_t;
+
+static perf_thread_t *perf_threads = NULL;
+static int perf_num_threads = 0;
+static int perf_errors[PERF_NUM_EVENTS]; // errno of the first failed open
+static pthread_mutex_t perf_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread perf_thread_t *perf_local = NULL;
+
+static inline void perf_begin(void)
+{
+    perf_thread_t *t = perf_local;
+    if (!t)
+    {
+        t = calloc(1, sizeof(perf_thread_t));
+        if (!t)
+        {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+        pthread_mutex_lock(&perf_mutex);
+        t->index = perf_num_threads++;
+        t->next = perf_threads;
+        perf_threads = t;
+        pthread_mutex_unlock(&perf_mutex);
+        perf_local = t;
+    }
+    for (int i = 0; i < PERF_NUM_EVENTS; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_events[i].type;
+        attr.config = perf_events[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        t->fd[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0); // this thread, any CPU
+        if (t->fd[i] < 0)
+        {
+            __atomic_compare_exchange_n(&perf_errors[i], &(int){0}, errno, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        }
+    }
+    for (int i = 0; i < PERF_NUM_EVENTS; i++)
+    {
+        if (t->fd[i] >= 0)
+        {
+            ioctl(t->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(t->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+static inline void perf_end(void)
+{
+    perf_thread_t *t = perf_local;
+    for (int i = 0; i < PERF_NUM_EVENTS; i++)
+    {
+        if (t->fd[i] >= 0)
+        {
+            ioctl(t->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    for (int i = 0; i < PERF_NUM_EVENTS; i++)
+    {
+        unsigned long long data[3]; // value, time enabled, time running
+        if (t->fd[i] < 0)
+        {
+            continue;
+        }
+        if (read(t->fd[i], data, sizeof(data)) == sizeof(data) && data[2] > 0)
+        {
+            t->value[i] += (double)data[0] * data[1] / data[2];
+            t->counted[i] = 1;
+        }
+        close(t->fd[i]);
+    }
+}
+
+static inline void perf_print_line(const char *prefix, const double *value, const int *counted)
+{
+    printf("%s", prefix);
+    for (int i = 0; i < PERF_NUM_EVENTS; i++)
+    {
+        if (!counted[i])
+        {
+            printf("  %s n/a", perf_events[i].name);
+        }
+        else if (i == PERF_TASK_CLOCK)
+        {
+            printf("  %s %.3f ms", perf_events[i].name, value[i] / 1e6);
+        }
+        else
+        {
+            printf("  %s %.0f", perf_events[i].name, value[i]);
+            if (i != PERF_CYCLES && i != PERF_INSTRUCTIONS && counted[PERF_INSTRUCTIONS] && value[PERF_INSTRUCTIONS] > 0)
+            {
+                printf(" (%.2f/ki)", 1000 * value[i] / value[PERF_INSTRUCTIONS]);
+            }
+        }
+        if (i == PERF_INSTRUCTIONS)
+        {
+            if (counted[PERF_CYCLES] && counted[PERF_INSTRUCTIONS] && value[PERF_CYCLES] > 0)
+            {
+                printf("  IPC %.2f", value[PERF_INSTRUCTIONS] / value[PERF_CYCLES]);
+            }
+            else
+            {
+                printf("  IPC n/a");
+            }
+        }
+    }
+    printf("\n");
+}
+
+// Print the counters of all threads. The threads must have called PERF_END.
+static inline void perf_print(const char *label)
+{
+    double total[PERF_NUM_EVENTS] = {0};
+    int counted[PERF_NUM_EVENTS] = {0};
+    pthread_mutex_lock(&perf_mutex);
+    for (perf_thread_t *t = perf_threads; t; t = t->next)
+    {
+        for (int i = 0; i < PERF_NUM_EVENTS; i++)
+        {
+            total[i] += t->value[i];
+            counted[i] |= t->counted[i];
+        }
+    }
+    char prefix[128];
+    snprintf(prefix, sizeof(prefix), "Counters (%s, %d thread%s):", label, perf_num_threads,
+             perf_num_threads == 1 ? "" : "s");
+    perf_print_line(prefix, total, counted);
+    if (perf_num_threads > 1)
+    {
+        // The list is newest first, print in thread order
+        for (int index = 0; index < perf_num_threads; index++)
+        {
+            for (perf_thread_t *t = perf_threads; t; t = t->next)
+            {
+                if (t->index == index)
+                {
+                    snprintf(prefix, sizeof(prefix), "  thread %d:", index);
+                    perf_print_line(prefix, t->value, t->counted);
+                }
+            }
+        }
+    }
+    pthread_mutex_unlock(&perf_mutex);
+    // One line per reason a counter could not be opened
+    for (int i = 0; i < PERF_NUM_EVENTS; i++)
+    {
+        int error = perf_errors[i], first = 1;
+        for (int j = 0; j < i && !counted[i] && error; j++)
+        {
+            error = counted[j] || perf_errors[j] != error ? error : 0; // printed with j
+        }
+        if (counted[i] || !error)
+        {
+            continue;
+        }
+        printf("  Not available (%s):", strerror(error));
+        for (int j = i; j < PERF_NUM_EVENTS; j++)
+        {
+            if (!counted[j] && perf_errors[j] == error)
+            {
+                printf("%s %s", first ? "" : ",", perf_events[j].name);
+                first = 0;
+            }
+        }
+        printf("\n");
+    }
+}
+
+#define PERF_BEGIN() perf_begin()
+#define PERF_END() perf_end()
+#define PERF_PRINT(label) perf_print(label)
+
+#else
+
+#define PERF_BEGIN() ((void)0)
+#define PERF_END() ((void)0)
+#define PERF_PRINT(label) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,211 @@
+#ifndef SUDOKU_PROFILE_H
+#define SUDOKU_PROFILE_H
+
+// Load-balance profiling for the parallel solvers, compiled in with
+// -DSOLVER_PROFILE. Without it every PROFILE_* macro expands to nothing
+// (PROFILE_LOCK to a plain pthread_mutex_lock).
+//
+// Every worker slot (an OpenMP thread, or one of the MAX_THREADS + 1 places
+// a pthreads solver thread can run in) splits the profiled region into:
+//
+//   busy   running search work
+//   wait   blocked in a taskwait or pthread_join for its children
+//   lock   acquiring a mutex
+//   idle   the rest: no work to run (starvation), or scheduling overhead
+//
+// The times are exclusive: a task a thread runs while it waits in a
+// taskwait counts as busy, not wait. Slots also count tasks spawned and run,
+// and for OpenMP the tasks run by a thread other than the one that spawned
+// them (steals).
+//
+// PROFILE_PRINT shows one line per slot and the imbalance ratio, the
+// largest busy time over the mean. A high ratio with idle time means the
+// work is split unevenly (starvation, try a deeper PARALLEL_CUTOFF); wait
+// and lock time that grow with the thread count point to contention.
+
+#ifdef SOLVER_PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define PROFILE_CACHE_LINE 64
+
+typedef struct
+{
+    double busy, wait, lock;
+    unsigned long long spawned, executed, steals;
+    double open_since; // start of the running busy interval
+    int in_use;        // pthreads: slot taken by a running thread
+} __attribute__((aligned(PROFILE_CACHE_LINE))) profile_slot_t;
+
+typedef struct
+{
+    int slot; // -1 when the wait is not profiled
+    double start;
+    double accounted; // busy + wait + lock of the slot at the start
+} profile_wait_t;
+
+static profile_slot_t *profile_slots = NULL;
+static int profile_num_slots = 0;
+static double profile_region_start, profile_region_time;
+static pthread_mutex_t profile_mutex = PTHREAD_MUTEX_INITIALIZER;
+static __thread int profile_current_slot __attribute__((unused)) = 0;
+
+static inline double profile_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline void profile_init(int slots)
+{
+    free(profile_slots);
+    profile_slots = aligned_alloc(PROFILE_CACHE_LINE, slots * sizeof(profile_slot_t));
+    if (!profile_slots)
+    {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    memset(profile_slots, 0, slots * sizeof(profile_slot_t));
+    profile_num_slots = slots;
+    profile_slots[0].in_use = 1; // the calling thread
+}
+
+static inline void profile_task_begin(int slot)
+{
+    profile_slots[slot].executed++;
+    profile_slots[slot].open_since = profile_now();
+}
+
+static inline void profile_task_end(int slot)
+{
+    profile_slot_t *s = &profile_slots[slot];
+    s->busy += profile_now() - s->open_since;
+}
+
+static inline profile_wait_t profile_wait_begin(int slot)
+{
+    profile_wait_t w = {slot, 0, 0};
+    if (slot >= 0)
+    {
+        profile_slot_t *s = &profile_slots[slot];
+        w.start = profile_now();
+        s->busy += w.start - s->open_since;
+        w.accounted = s->busy + s->wait + s->lock;
+    }
+    return w;
+}
+
+static inline void profile_wait_end(profile_wait_t w)
+{
+    if (w.slot >= 0)
+    {
+        profile_slot_t *s = &profile_slots[w.slot];
+        double now = profile_now();
+        // Work and waits of nested tasks run meanwhile are already counted
+        s->wait += (now - w.start) - (s->busy + s->wait + s->lock - w.accounted);
+        s->open_since = now;
+    }
+}
+
+static inline void profile_lock(int slot, pthread_mutex_t *mutex)
+{
+    profile_slot_t *s = &profile_slots[slot];
+    double start = profile_now();
+    pthread_mutex_lock(mutex);
+    double now = profile_now();
+    s->busy += start - s->open_since;
+    s->lock += now - start;
+    s->open_since = now;
+}
+
+// pthreads: take a free slot for a new thread; it runs in it until
+// profile_release_slot
+static inline int profile_acquire_slot(void)
+{
+    pthread_mutex_lock(&profile_mutex);
+    int slot = 1;
+    while (slot < profile_num_slots - 1 && profile_slots[slot].in_use)
+    {
+        slot++;
+    }
+    profile_slots[slot].in_use = 1;
+    pthread_mutex_unlock(&profile_mutex);
+    return slot;
+}
+
+static inline void profile_release_slot(int slot)
+{
+    pthread_mutex_lock(&profile_mutex);
+    profile_slots[slot].in_use = 0;
+    pthread_mutex_unlock(&profile_mutex);
+}
+
+static inline void profile_print(const char *label)
+{
+    double total_busy = 0, max_busy = 0;
+    for (int i = 0; i < profile_num_slots; i++)
+    {
+        total_busy += profile_slots[i].busy;
+        if (profile_slots[i].busy > max_busy)
+        {
+            max_busy = profile_slots[i].busy;
+        }
+    }
+    double mean_busy = total_busy / profile_num_slots;
+
+    printf("Profile (%s, %d slots, region %.6f s):\n", label, profile_num_slots, profile_region_time);
+    printf("%6s %12s %12s %12s %12s %10s %10s %10s\n", "slot", "busy (s)", "wait (s)", "lock (s)", "idle (s)", "spawned",
+           "executed", "steals");
+    for (int i = 0; i < profile_num_slots; i++)
+    {
+        const profile_slot_t *s = &profile_slots[i];
+        double idle = profile_region_time - s->busy - s->wait - s->lock;
+        printf("%6d %12.6f %12.6f %12.6f %12.6f %10llu %10llu %10llu\n", i, s->busy, s->wait, s->lock,
+               idle > 0 ? idle : 0, s->spawned, s->executed, s->steals);
+    }
+    printf("Imbalance (max / mean busy): %.2f  busy %.1f%% of slot time\n", mean_busy > 0 ? max_busy / mean_busy : 0,
+           profile_region_time > 0 ? 100.0 * total_busy / (profile_region_time * profile_num_slots) : 0);
+}
+
+#define PROFILE_INIT(slots) profile_init(slots)
+#define PROFILE_REGION_BEGIN() (profile_region_start = profile_now())
+#define PROFILE_REGION_END() (profile_region_time = profile_now() - profile_region_start)
+#define PROFILE_TASK_BEGIN(slot) profile_task_begin(slot)
+#define PROFILE_TASK_END(slot) profile_task_end(slot)
+#define PROFILE_SPAWN(slot) (profile_slots[slot].spawned++)
+#define PROFILE_STEAL(slot, creator) ((slot) != (creator) ? profile_slots[slot].steals++ : 0)
+#define PROFILE_WAIT_BEGIN(w, slot) profile_wait_t w = profile_wait_begin(slot)
+#define PROFILE_WAIT_END(w) profile_wait_end(w)
+#define PROFILE_LOCK(slot, mutex) profile_lock(slot, mutex)
+#define PROFILE_ACQUIRE_SLOT() profile_acquire_slot()
+#define PROFILE_RELEASE_SLOT(slot) profile_release_slot(slot)
+#define PROFILE_SET_SLOT(slot) (profile_current_slot = (slot))
+#define PROFILE_SLOT() profile_current_slot
+#define PROFILE_PRINT(label) profile_print(label)
+
+#else
+
+#define PROFILE_INIT(slots) ((void)0)
+#define PROFILE_REGION_BEGIN() ((void)0)
+#define PROFILE_REGION_END() ((void)0)
+#define PROFILE_TASK_BEGIN(slot) ((void)0)
+#define PROFILE_TASK_END(slot) ((void)0)
+#define PROFILE_SPAWN(slot) ((void)0)
+#define PROFILE_STEAL(slot, creator) ((void)(creator))
+#define PROFILE_WAIT_BEGIN(w, slot) ((void)0)
+#define PROFILE_WAIT_END(w) ((void)0)
+#define PROFILE_LOCK(slot, mutex) pthread_mutex_lock(mutex)
+#define PROFILE_ACQUIRE_SLOT() 0
+#define PROFILE_RELEASE_SLOT(slot) ((void)(slot))
+#define PROFILE_SET_SLOT(slot) ((void)(slot))
+#define PROFILE_SLOT() 0
+#define PROFILE_PRINT(label) ((void)0)
+
+#endif
+
+#endif
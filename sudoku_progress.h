@@ -0,0 +1,362 @@
+#ifndef SUDOKU_PROGRESS_H
+#define SUDOKU_PROGRESS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+
+// How big the search of a puzzle is, and how far along a running solve is,
+// for sizing the walltime of long runs and killing hopeless ones early.
+//
+//   --estimate=K     before solving, estimate the number of search nodes
+//                    with K random probes (Knuth's estimator). A probe walks
+//                    from the root to a leaf, filling the first empty cell
+//                    with a random candidate each time, like the solvers fill
+//                    it in order. With d1, d2, ... candidates at each step,
+//                    1 + d1 + d1*d2 + ... is an unbiased estimate of the
+//                    number of nodes of the whole tree. The solve stops at the
+//                    first solution, so it visits at most that many. The
+//                    estimates are heavy-tailed: a relative error near or
+//                    above 100% means more probes are needed.
+//
+//   --heartbeat=S    while solving, a monitor thread prints a line to stderr
+//                    every S seconds: nodes searched, nodes per second over
+//                    the last S seconds, the depth of the node each worker
+//                    is at, and how many of the branches of the root are
+//                    done. The root is the first cell the search really
+//                    branches on: cells before it with one candidate are
+//                    forced and have a single branch. With --estimate it
+//                    also prints the share of the estimate searched and the
+//                    time left at the current rate, an upper bound only as
+//                    good as the estimate.
+//
+// The solvers count nodes into one slot per thread, on its own cache line,
+// which only that thread writes, so counting costs a store per node.
+
+typedef struct
+{
+    long probes;      // 0: no estimate
+    double heartbeat; // seconds, 0: no heartbeat
+} progress_options_t;
+
+// Consume arg if it is one of the options above. Returns 1 if it was.
+static inline int progress_parse_option(progress_options_t *options, const char *arg)
+{
+    if (strncmp(arg, "--estimate=", 11) == 0 && atol(arg + 11) > 0)
+    {
+        options->probes = atol(arg + 11);
+    }
+    else if (strncmp(arg, "--heartbeat=", 12) == 0 && atof(arg + 12) > 0)
+    {
+        options->heartbeat = atof(arg + 12);
+    }
+    else
+    {
+        return 0;
+    }
+    return 1;
+}
+
+#define PROGRESS_USAGE "[--estimate=probes] [--heartbeat=seconds]"
+
+#define PROGRESS_MAX_SLOTS 256
+#define PROGRESS_MAX_DEPTHS 16 // workers listed in a heartbeat line
+
+typedef struct
+{
+    unsigned long long nodes;
+    int depth; // of the node the thread is at
+} __attribute__((aligned(64))) progress_slot_t;
+
+static progress_slot_t progress_slots[PROGRESS_MAX_SLOTS];
+static int progress_num_slots = 0;
+static __thread progress_slot_t *progress_local = NULL;
+static int progress_root_total = 0, progress_root_done = 0;
+static int progress_root_depth = 0; // depth of the first cell with more than one candidate
+static double progress_estimated_nodes = 0; // 0: no estimate
+
+static inline double progress_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Called by the solvers for every node they visit
+static inline void progress_node(int depth)
+{
+    if (!progress_local)
+    {
+        int slot = __atomic_fetch_add(&progress_num_slots, 1, __ATOMIC_RELAXED);
+        // Threads past the last slot share it; their counts are then approximate
+        progress_local = &progress_slots[slot < PROGRESS_MAX_SLOTS ? slot : PROGRESS_MAX_SLOTS - 1];
+    }
+    __atomic_store_n(&progress_local->nodes, progress_local->nodes + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&progress_local->depth, depth, __ATOMIC_RELAXED);
+}
+
+// Called by the solvers when the search below a candidate of the cell at
+// depth is done; counts only for the root
+static inline void progress_root_branch_done(int depth)
+{
+    if (depth == progress_root_depth)
+    {
+        __atomic_add_fetch(&progress_root_done, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// First empty cell in row-major order, the cell the solvers branch on
+static inline int progress_first_empty(const int *grid, int n, int *row, int *col)
+{
+    for (int i = 0; i < n * n; i++)
+    {
+        if (grid[i] == 0)
+        {
+            *row = i / n;
+            *col = i % n;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Digits that fit in (row, col), stored in candidates; returns how many
+static inline int progress_candidates(const int *grid, int n, int block, int row, int col, int *candidates)
+{
+    unsigned char used[n + 1];
+    memset(used, 0, sizeof(used));
+    int row_start = row - row % block, col_start = col - col % block;
+    for (int i = 0; i < n; i++)
+    {
+        used[grid[row * n + i]] = 1;
+        used[grid[i * n + col]] = 1;
+        used[grid[(row_start + i / block) * n + col_start + i % block]] = 1;
+    }
+    int count = 0;
+    for (int num = 1; num <= n; num++)
+    {
+        if (!used[num])
+        {
+            candidates[count++] = num;
+        }
+    }
+    return count;
+}
+
+// Reset the counters before a solve of grid
+static inline void progress_reset(const int *grid, int n, int block)
+{
+    for (int i = 0; i < PROGRESS_MAX_SLOTS; i++)
+    {
+        progress_slots[i].nodes = 0;
+        progress_slots[i].depth = 0;
+    }
+    // Fill the forced cells in the order the solvers do to find the root
+    size_t cells = (size_t)n * n;
+    int *copy = malloc(cells * sizeof(int));
+    if (!copy)
+    {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    memcpy(copy, grid, cells * sizeof(int));
+    int row, col, candidates[n];
+    progress_root_total = 0;
+    progress_root_depth = 0;
+    while (progress_first_empty(copy, n, &row, &col))
+    {
+        progress_root_total = progress_candidates(copy, n, block, row, col, candidates);
+        if (progress_root_total != 1)
+        {
+            break;
+        }
+        copy[row * n + col] = candidates[0];
+        progress_root_depth++;
+    }
+    free(copy);
+    progress_root_done = 0;
+}
+
+// xorshift64*, enough for choosing probe branches
+static inline unsigned progress_random(unsigned long long *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return (*state * 2685821657736338717ULL) >> 32;
+}
+
+// Estimate the search tree of puzzle with probes random probes, print the
+// result and keep it for the heartbeat
+static inline void progress_estimate(const int *puzzle, int n, int block, long probes, unsigned long long seed)
+{
+    size_t cells = (size_t)n * n;
+    int *grid = malloc(cells * sizeof(int));
+    if (!grid)
+    {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    int candidates[n], empty = 0;
+    for (size_t i = 0; i < cells; i++)
+    {
+        empty += puzzle[i] == 0;
+    }
+
+    unsigned long long state = seed ? seed : 1;
+    double sum = 0, sum_sq = 0, depth_sum = 0;
+    long solutions = 0;
+    double start = progress_now();
+    for (long p = 0; p < probes; p++)
+    {
+        memcpy(grid, puzzle, cells * sizeof(int));
+        double product = 1, estimate = 1;
+        int depth = 0, row, col;
+        while (progress_first_empty(grid, n, &row, &col))
+        {
+            int count = progress_candidates(grid, n, block, row, col, candidates);
+            if (count == 0)
+            {
+                break; // dead end
+            }
+            product *= count;
+            estimate += product;
+            grid[row * n + col] = candidates[progress_random(&state) % count];
+            depth++;
+        }
+        solutions += depth == empty;
+        sum += estimate;
+        sum_sq += estimate * estimate;
+        depth_sum += depth;
+    }
+    double seconds = progress_now() - start;
+    free(grid);
+
+    double mean = sum / probes;
+    double variance = sum_sq / probes - mean * mean;
+    double relative_error = probes > 1 && variance > 0 ? sqrt(variance / (probes - 1)) / mean : 0;
+    progress_estimated_nodes = mean;
+    printf("Estimated search tree (%ld probes, %.3f s): %.3e nodes +- %.1f%%, probes reached depth %.1f of %d on "
+           "average, %ld reached a solution\n",
+           probes, seconds, mean, 100 * relative_error, depth_sum / probes, empty, solutions);
+    fflush(stdout);
+}
+
+static pthread_t progress_monitor;
+static pthread_mutex_t progress_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t progress_cond = PTHREAD_COND_INITIALIZER;
+static int progress_running = 0;
+
+// "1h 02m 03.4s"
+static inline void progress_format_duration(char *text, size_t size, double seconds)
+{
+    long s = seconds;
+    snprintf(text, size, "%ldh %02ldm %04.1fs", s / 3600, s / 60 % 60, seconds - s / 60 * 60);
+}
+
+static inline void progress_report(double elapsed, double rate, unsigned long long nodes)
+{
+    char line[1024], duration[64];
+    int length = 0;
+    progress_format_duration(duration, sizeof(duration), elapsed);
+    length += snprintf(line + length, sizeof(line) - length, "Heartbeat %s: %.3e nodes, %.3e nodes/s, depth [",
+                       duration, (double)nodes, rate);
+    int slots = __atomic_load_n(&progress_num_slots, __ATOMIC_RELAXED);
+    slots = slots < PROGRESS_MAX_SLOTS ? slots : PROGRESS_MAX_SLOTS;
+    for (int i = 0; i < slots && i < PROGRESS_MAX_DEPTHS; i++)
+    {
+        length += snprintf(line + length, sizeof(line) - length, i ? " %d" : "%d",
+                           __atomic_load_n(&progress_slots[i].depth, __ATOMIC_RELAXED));
+    }
+    int done = __atomic_load_n(&progress_root_done, __ATOMIC_RELAXED);
+    length += snprintf(line + length, sizeof(line) - length, "%s], root branches %d/%d done",
+                       slots > PROGRESS_MAX_DEPTHS ? " ..." : "", done, progress_root_total);
+    if (progress_estimated_nodes > 0 && nodes < progress_estimated_nodes)
+    {
+        progress_format_duration(duration, sizeof(duration), rate > 0 ? (progress_estimated_nodes - nodes) / rate : 0);
+        length += snprintf(line + length, sizeof(line) - length, ", %.1f%% of estimate, about %s left",
+                           100.0 * nodes / progress_estimated_nodes, duration);
+    }
+    else if (progress_estimated_nodes > 0)
+    {
+        length += snprintf(line + length, sizeof(line) - length, ", past the estimate");
+    }
+    fprintf(stderr, "%s\n", line);
+    fflush(stderr);
+}
+
+static inline unsigned long long progress_total_nodes(void)
+{
+    unsigned long long nodes = 0;
+    for (int i = 0; i < PROGRESS_MAX_SLOTS; i++)
+    {
+        nodes += __atomic_load_n(&progress_slots[i].nodes, __ATOMIC_RELAXED);
+    }
+    return nodes;
+}
+
+static void *progress_monitor_func(void *arg)
+{
+    double interval = *(double *)arg;
+    double start = progress_now(), last = start;
+    unsigned long long last_nodes = 0;
+    pthread_mutex_lock(&progress_mutex);
+    while (progress_running)
+    {
+        // Wake up after interval, or at once when progress_stop signals
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        double wake = deadline.tv_sec + deadline.tv_nsec / 1e9 + interval;
+        deadline.tv_sec = (time_t)wake;
+        deadline.tv_nsec = (long)((wake - deadline.tv_sec) * 1e9);
+        pthread_cond_timedwait(&progress_cond, &progress_mutex, &deadline);
+        if (!progress_running)
+        {
+            break;
+        }
+        pthread_mutex_unlock(&progress_mutex);
+        double now = progress_now();
+        unsigned long long nodes = progress_total_nodes();
+        progress_report(now - start, (nodes - last_nodes) / (now - last), nodes);
+        last = now;
+        last_nodes = nodes;
+        pthread_mutex_lock(&progress_mutex);
+    }
+    pthread_mutex_unlock(&progress_mutex);
+    return NULL;
+}
+
+// Start the heartbeat if options ask for one. Call progress_reset first.
+static inline void progress_start(const progress_options_t *options)
+{
+    static double interval;
+    if (options->heartbeat <= 0)
+    {
+        return;
+    }
+    interval = options->heartbeat;
+    progress_running = 1;
+    if (pthread_create(&progress_monitor, NULL, progress_monitor_func, &interval) != 0)
+    {
+        perror("pthread_create failed");
+        exit(1);
+    }
+}
+
+static inline void progress_stop(void)
+{
+    pthread_mutex_lock(&progress_mutex);
+    int running = progress_running;
+    progress_running = 0;
+    pthread_cond_signal(&progress_cond);
+    pthread_mutex_unlock(&progress_mutex);
+    if (running)
+    {
+        pthread_join(progress_monitor, NULL);
+    }
+}
+
+#endif
@@ -1,6 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <mpi.h>
+#include "sudoku_output.h"
+#include "sudoku_stats.h"
+#include "sudoku_trace.h"
 
 #define N 9
 #define SUBGRID 3
@@ -19,8 +22,10 @@ int is_valid(int grid[N][N], int row, int col, int num) {
     return 1;
 }
 
-// Backtracking Sudoku Solver (used by workers)
-int solve_sudoku(int grid[N][N]) {
+// Backtracking Sudoku Solver (used by workers).
+// depth is the number of placements above this call.
+int solve_sudoku(int grid[N][N], int depth) {
+    STATS_NODE(depth);
     int row = -1, col = -1, is_empty = 0;
     for (int i = 0; i < N; i++) {
         for (int j = 0; j < N; j++) {
@@ -33,13 +38,18 @@ int solve_sudoku(int grid[N][N]) {
         }
         if (is_empty) break;
     }
-    if (!is_empty) return 1;
+    if (!is_empty) {
+        STATS_SOLUTION();
+        return 1;
+    }
 
     for (int num = 1; num <= N; num++) {
+        STATS_CHECK();
         if (is_valid(grid, row, col, num)) {
             grid[row][col] = num;
-            if (solve_sudoku(grid)) return 1;
+            if (solve_sudoku(grid, depth + 1)) return 1;
             grid[row][col] = 0; // Backtrack
+            STATS_BACKTRACK();
         }
     }
     return 0;
@@ -51,15 +61,6 @@ int generate_subproblems(int grid[N][N], int subproblems[MAX_JOBS][N][N]) {
     int row = -1, col = -1;
 
 
-printf("grid being passed to subproblem: \n");
-     for (int i = 0; i < N; i++) {
-                for (int j = 0; j < N; j++) {
-                    printf("%d ", grid[i][j]);
-                }
-                printf("\n");
-            }
-            printf("\n");
-
     // Find the first empty cell
     for (int i = 0; i < N; i++) {
         for (int j = 0; j < N; j++) {
@@ -88,64 +89,60 @@ printf("grid being passed to subproblem: \n");
     return count;
 }
 
-// Master: Distributes subproblems and collects results
-void master(int grid[N][N], int num_procs) {
+// Master: Distributes subproblems and collects the solution into solved_grid.
+// Returns the number of subproblems; the caller prints after the timing.
+int master(int grid[N][N], int num_procs, int solved_grid[N][N]) {
     int subproblems[MAX_JOBS][N][N];
     int num_jobs = generate_subproblems(grid, subproblems);
-    int solved_grid[N][N];
-    int solved = 0;
     
     // Distribute subproblems to workers
     for (int i = 0; i < num_jobs; i++) {
-        MPI_Send(subproblems[i], N * N, MPI_INT, (i % (num_procs - 1)) + 1, 1, MPI_COMM_WORLD);
-   
-	int worker_rank = (i % (num_procs - 1)) + 1;
-
-	printf("Master assigned board to Worker %d:\n", worker_rank);
-        for (int r = 0; r < N; r++) {
-            for (int c = 0; c < N; c++) {
-                printf("%d ", subproblems[i][r][c]);
-            }
-            printf("\n");
-        }
-        printf("\n");
+        int dest = (i % (num_procs - 1)) + 1;
+        TRACE_SEND_BEGIN(dest, 1, N * N);
+        MPI_Send(subproblems[i], N * N, MPI_INT, dest, 1, MPI_COMM_WORLD);
+        TRACE_SEND_END(dest, 1, N * N);
     }
 
     // Receive solution from workers
     MPI_Status status;
+    TRACE_RECV_BEGIN(MPI_ANY_SOURCE, 2, N * N);
     MPI_Recv(solved_grid, N * N, MPI_INT, MPI_ANY_SOURCE, 2, MPI_COMM_WORLD, &status);
-    solved = 1;
+    TRACE_RECV_END(status.MPI_SOURCE, 2, N * N);
 
     // Broadcast termination signal
     for (int i = 1; i < num_procs; i++) {
+        TRACE_SEND_BEGIN(i, 3, 0);
         MPI_Send(NULL, 0, MPI_INT, i, 3, MPI_COMM_WORLD);
+        TRACE_SEND_END(i, 3, 0);
     }
 
-    // Print solved Sudoku
-    printf("Solved Sudoku:\n");
-    for (int i = 0; i < N; i++) {
-        for (int j = 0; j < N; j++) {
-            printf("%d ", solved_grid[i][j]);
-        }
-        printf("\n");
-    }
+    return num_jobs;
 }
 
 // Worker: Solves assigned Sudoku puzzle
 void worker(int rank) {
     int grid[N][N];
     MPI_Status status;
+    unsigned job = 0;
 
     while (1) {
         // Receive job from master
+        TRACE_RECV_BEGIN(MASTER, MPI_ANY_TAG, N * N);
         MPI_Recv(grid, N * N, MPI_INT, MASTER, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        TRACE_RECV_END(MASTER, status.MPI_TAG, N * N);
 
         if (status.MPI_TAG == 3) break; // Termination signal
 
 	
 	// Solve the Sudoku
-        if (solve_sudoku(grid)) {
+        job++;
+        TRACE_START(job, 1, -1, -1, -1);
+        int solved = solve_sudoku(grid, 0);
+        TRACE_FINISH(job, 1, -1, -1, -1);
+        if (solved) {
+            TRACE_SEND_BEGIN(MASTER, 2, N * N);
             MPI_Send(grid, N * N, MPI_INT, MASTER, 2, MPI_COMM_WORLD);
+            TRACE_SEND_END(MASTER, 2, N * N);
         }
     }
 }
@@ -161,6 +158,16 @@ int main(int argc, char *argv[]) {
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
 
+    output_options_t options = {0};
+    for (int i = 1; i < argc; i++) {
+        if (!output_parse_option(&options, argv[i])) {
+            if (rank == MASTER)
+                fprintf(stderr, "Usage: %s " OUTPUT_USAGE "\n", argv[0]);
+            MPI_Finalize();
+            return 1;
+        }
+    }
+
     /*
     int grid[N][N] = {
         {5, 3, 0, 0, 7, 0, 0, 0, 0},
@@ -356,13 +363,40 @@ int grid[N][N] = {
 //double start_time, end_time, elapsed_time;
 
     //start_time = MPI_Wtime();
+    int solved_grid[N][N];
+    int num_jobs = 0;
+    STATS_START();
+    TRACE_INIT(rank);
     if (rank == MASTER) {
-        master(grid, num_procs);
+        num_jobs = master(grid, num_procs, solved_grid);
     } else {
         worker(rank);
     }
     end_time = MPI_Wtime();
 
+    if (rank == MASTER) {
+        printf("Master distributed %d subproblems to %d workers\n", num_jobs, num_procs - 1);
+        output_solution(&options, "Solved Sudoku:", &grid[0][0], &solved_grid[0][0], N, SUBGRID);
+    }
+
+#ifdef SOLVER_STATS
+    // Every rank counted its own search; add them up on the master
+    int threads;
+    solver_stats_t local = stats_total(&threads), total = {0};
+    unsigned long long counts[4] = {local.nodes, local.checks, local.backtracks, local.propagations};
+    unsigned long long sums[4];
+    double first = stats_first_solution >= 0 ? stats_first_solution : 1e300, first_min;
+    MPI_Reduce(counts, sums, 4, MPI_UNSIGNED_LONG_LONG, MPI_SUM, MASTER, MPI_COMM_WORLD);
+    MPI_Reduce(&local.max_depth, &total.max_depth, 1, MPI_LONG, MPI_MAX, MASTER, MPI_COMM_WORLD);
+    MPI_Reduce(&first, &first_min, 1, MPI_DOUBLE, MPI_MIN, MASTER, MPI_COMM_WORLD);
+    if (rank == MASTER) {
+        total.nodes = sums[0];
+        total.checks = sums[1];
+        total.backtracks = sums[2];
+        total.propagations = sums[3];
+        stats_print_total("MPI", &total, num_procs, "rank", first_min < 1e300 ? first_min : -1);
+    }
+#endif
 
     MPI_Finalize();
     printf("elapsed time to solve %d x %d grid is : %f\n", N, N, end_time - start_time);
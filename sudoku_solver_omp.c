@@ -4,6 +4,13 @@
 #include <string.h>
 #include <time.h>
 #include <omp.h>
+#include "sudoku_batch.h"
+#include "sudoku_output.h"
+#include "sudoku_stats.h"
+#include "sudoku_profile.h"
+#include "sudoku_trace.h"
+#include "sudoku_progress.h"
+#include "sudoku_perf.h"
 
 #define PARALLEL_CUTOFF 2 // Only create tasks for recursion levels < this cutoff
 
@@ -20,48 +27,25 @@ void print_time()
     printf("%s\n", buffer);
 }
 
-void print_sudoku(int *sudoku, int grid_size)
+// Set once a task has found a solution, so the other tasks stop searching
+int solution_found = 0;
+
+// Keep the first solution found: copy it to solution and take the end
+// timestamp there, before any output. Nothing is printed inside the search.
+void record_solution(int *sudoku, int grid_size, int *solution, struct timespec *end)
 {
-    printf("The Sudoku contains:\n");
-    for (int i = 0; i < grid_size; i++)
+#pragma omp critical
     {
-        for (int j = 0; j < grid_size; j++)
+        if (!solution_found)
         {
-            printf("%d  ", sudoku[i * grid_size + j]);
+            clock_gettime(CLOCK_MONOTONIC, end);
+            memcpy(solution, sudoku, grid_size * grid_size * sizeof(int));
+#pragma omp atomic write
+            solution_found = 1;
         }
-        printf("\n");
     }
 }
 
-void print_solution_and_time(int *sudoku, int grid_size, struct timespec *start, struct timespec *end)
-{
-    clock_gettime(CLOCK_MONOTONIC, end);
-
-    printf("Solution is:\n");
-    print_time();
-    print_sudoku(sudoku, grid_size);
-
-    long sec_diff = end->tv_sec - start->tv_sec;
-    long nsec_diff = end->tv_nsec - start->tv_nsec;
-    if (nsec_diff < 0)
-    {
-        sec_diff--;
-        nsec_diff += 1000000000;
-    }
-
-    double total_ms = sec_diff * 1000.0 + nsec_diff / 1000000.0;
-    int hrs = total_ms / (3600.0 * 1000.0);
-    double remainder = total_ms - hrs * 3600.0 * 1000.0;
-    int mins = remainder / (60.0 * 1000.0);
-    remainder -= mins * 60.0 * 1000.0;
-    int secs = remainder / 1000.0;
-    double ms = remainder - secs * 1000.0;
-
-    // double time_taken = ((double)(end - start)) / CLOCKS_PER_SEC * 1000.0;
-    printf("Time taken to solve (parallel): %02dhr: %02dmin: %02dsec: %06.2fms\n", hrs, mins, secs, ms);
-    exit(0);
-}
-
 int check_square(int *sudoku, int grid_size, int block_size, int num, int row, int col)
 {
     int row_start = row - row % block_size;
@@ -109,16 +93,30 @@ int find_unassigned(int *sudoku, int grid_size, int *row, int *col)
 }
 
 // Parallel backtracking solver using OpenMP tasks.
-// The extra "depth" parameter is used to limit task creation.
-int sudoku_solver_parallel(int *sudoku, int grid_size, int block_size, int depth, struct timespec *start, struct timespec *end)
+// The extra "depth" parameter is used to limit task creation. The first
+// solution found is recorded into solution (see record_solution).
+int sudoku_solver_parallel(int *sudoku, int grid_size, int block_size, int depth, int *solution, struct timespec *end)
 {
+    int found;
+#pragma omp atomic read
+    found = solution_found;
+    if (found)
+        return 0; // Another task already has the solution
+
+    STATS_NODE(depth);
+    progress_node(depth);
     int row, col;
     if (!find_unassigned(sudoku, grid_size, &row, &col))
+    {
+        STATS_SOLUTION();
+        record_solution(sudoku, grid_size, solution, end);
         return 1; // Puzzle solved
+    }
 
     int solved = 0;
     for (int num = 1; num <= grid_size && !solved; num++)
     {
+        STATS_CHECK();
         if (check_sudoku(sudoku, grid_size, block_size, num, row, col))
         {
             if (depth < PARALLEL_CUTOFF)
@@ -132,45 +130,73 @@ int sudoku_solver_parallel(int *sudoku, int grid_size, int block_size, int depth
                 }
                 memcpy(sudoku_copy, sudoku, grid_size * grid_size * sizeof(int));
                 sudoku_copy[row * grid_size + col] = num;
+                int creator = omp_get_thread_num();
+                unsigned task = TRACE_NEW_ID();
+                PROFILE_SPAWN(creator);
+                TRACE_SPAWN(task, depth + 1, row, col, num);
 
-#pragma omp task shared(solved) firstprivate(sudoku_copy, grid_size, block_size, depth, row, col)
+#pragma omp task shared(solved) firstprivate(sudoku_copy, grid_size, block_size, depth, row, col, num, creator, task)
                 {
-                    if (sudoku_solver_parallel(sudoku_copy, grid_size, block_size, depth + 1, start, end))
+                    PROFILE_TASK_BEGIN(omp_get_thread_num());
+                    PROFILE_STEAL(omp_get_thread_num(), creator);
+                    TRACE_START(task, depth + 1, row, col, num);
+                    if (sudoku_solver_parallel(sudoku_copy, grid_size, block_size, depth + 1, solution, end))
                     {
-#pragma omp critical
+#pragma omp atomic write
+                        solved = 1;
+                    }
+                    else
+                    {
+                        // A task that gave up because another one found the
+                        // solution neither backtracked nor finished its branch
+                        int cancelled;
+#pragma omp atomic read
+                        cancelled = solution_found;
+                        if (cancelled)
                         {
-                            if (!solved)
-                            {
-                                solved = 1;
-                                print_time();
-                                print_solution_and_time(sudoku_copy, grid_size, start, end);
-                                // Copy found solution back to original sudoku
-                                // memcpy(sudoku, sudoku_copy, grid_size * grid_size * sizeof(int));
-                            }
+                            TRACE_CANCEL(task, depth + 1, row, col, num);
+                        }
+                        else
+                        {
+                            STATS_BACKTRACK(); // The copy with this candidate is dropped
+                            progress_root_branch_done(depth);
                         }
                     }
                     free(sudoku_copy);
+                    TRACE_FINISH(task, depth + 1, row, col, num);
+                    PROFILE_TASK_END(omp_get_thread_num());
                 }
             }
             else
             {
                 // For deeper recursion levels, proceed serially.
                 sudoku[row * grid_size + col] = num;
-                if (sudoku_solver_parallel(sudoku, grid_size, block_size, depth + 1, start, end))
+                if (sudoku_solver_parallel(sudoku, grid_size, block_size, depth + 1, solution, end))
                 {
-                    print_time();
-                    print_solution_and_time(sudoku, grid_size, start, end);
                     return 1;
                 }
                 sudoku[row * grid_size + col] = 0; // Backtrack
+                int cancelled;
+#pragma omp atomic read
+                cancelled = solution_found;
+                if (!cancelled)
+                {
+                    STATS_BACKTRACK();
+                    progress_root_branch_done(depth);
+                }
             }
         }
     }
+    // Only levels above the cutoff can have tasks to wait for
+    PROFILE_WAIT_BEGIN(wait, depth < PARALLEL_CUTOFF ? omp_get_thread_num() : -1);
 #pragma omp taskwait
+    PROFILE_WAIT_END(wait);
     return solved;
 }
 
-void solve_sudoku_parallel(int *sudoku, int grid_size, int block_size, struct timespec *start, struct timespec *end)
+// Returns 1 and leaves the solution in solution and its time in end if the
+// puzzle has one.
+int solve_sudoku_parallel(int *sudoku, int grid_size, int block_size, int *solution, struct timespec *end)
 {
     // Start the parallel region
     // Use OpenMP to create a single task for the initial call
@@ -178,104 +204,274 @@ void solve_sudoku_parallel(int *sudoku, int grid_size, int block_size, struct ti
     // while other threads can help with the search.
     // The "nowait" clause allows other threads to continue working without waiting for this task to finish.
     // This is important for performance in parallel backtracking.
+    solution_found = 0;
+    PROFILE_INIT(omp_get_max_threads());
+    PROFILE_REGION_BEGIN();
     {
 #pragma omp parallel
         {
+            PERF_BEGIN();
 #pragma omp single nowait
             {
-                sudoku_solver_parallel(sudoku, grid_size, block_size, 0, start, end);
+                PROFILE_TASK_BEGIN(omp_get_thread_num());
+                TRACE_START(0, 0, -1, -1, -1);
+                sudoku_solver_parallel(sudoku, grid_size, block_size, 0, solution, end);
+                TRACE_FINISH(0, 0, -1, -1, -1);
+                PROFILE_TASK_END(omp_get_thread_num());
             }
+#ifdef SOLVER_PERF
+#pragma omp barrier // The tasks run here, count them too
+#endif
+            PERF_END();
         }
     }
+    PROFILE_REGION_END();
+    return solution_found;
 }
 
-int main(int argc, char *argv[])
+#define BATCH_CHUNK_PER_THREAD 64
+
+// Serial backtracking, used for the puzzles of a batch
+int sudoku_solver_serial(int *sudoku, int grid_size, int block_size, int depth)
 {
-    if (argc < 2)
+    STATS_NODE(depth);
+    int row, col;
+    if (!find_unassigned(sudoku, grid_size, &row, &col))
     {
-        fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
-        return 1;
+        STATS_SOLUTION();
+        return 1; // Puzzle solved
     }
 
-    FILE *fp = fopen(argv[1], "r");
-    if (!fp)
+    for (int num = 1; num <= grid_size; num++)
     {
-        perror("Error opening file");
-        return 1;
+        STATS_CHECK();
+        if (check_sudoku(sudoku, grid_size, block_size, num, row, col))
+        {
+            sudoku[row * grid_size + col] = num;
+            if (sudoku_solver_serial(sudoku, grid_size, block_size, depth + 1))
+                return 1;
+            sudoku[row * grid_size + col] = 0;
+            STATS_BACKTRACK();
+        }
     }
+    return 0;
+}
 
-    int grid_size;
-    // Read grid size from file (e.g., 9 for a 9x9 sudoku)
-    if (fscanf(fp, "%d", &grid_size) != 1)
+// Solve every puzzle of a batch file (see sudoku_batch.h) and report
+// throughput and latency. Solutions go to output if it is set.
+//
+// The parallelism is across puzzles: a chunk of puzzles is read in order,
+// each thread solves whole puzzles from it with the serial backtracker, and
+// the results are written in order. A 9x9 search takes microseconds, less
+// than creating the tasks of sudoku_solver_parallel would.
+int solve_batch(const char *filename, const char *output)
+{
+    batch_reader_t reader;
+    if (!batch_open(&reader, filename))
     {
-        fprintf(stderr, "Error reading grid size from file.\n");
-        fclose(fp);
         return 1;
     }
-
-    int block_size = sqrt(grid_size);
-    if (block_size * block_size != grid_size)
+    FILE *out = NULL;
+    if (output)
     {
-        fprintf(stderr, "Grid size must be a perfect square (e.g., 4, 9, 16, ...).\n");
-        fclose(fp);
-        return 1;
+        out = fopen(output, "wb");
+        if (!out)
+        {
+            perror("Error opening output file");
+            batch_close(&reader);
+            return 1;
+        }
+        batch_begin_output(out, &reader);
     }
 
-    int *sudoku = malloc(grid_size * grid_size * sizeof(int));
-    if (!sudoku)
+    int threads = omp_get_max_threads();
+    long chunk = (long)threads * BATCH_CHUNK_PER_THREAD;
+    size_t cells = batch_max_cells(&reader);
+    int *puzzles = malloc(chunk * cells * sizeof(int));
+    int *grids = malloc(chunk * cells * sizeof(int));
+    int *status = malloc(chunk * sizeof(int));
+    int *solved = malloc(chunk * sizeof(int));
+    double *latency = malloc(chunk * sizeof(double));
+    const char **lines = malloc(chunk * sizeof(char *));
+    size_t *line_lens = malloc(chunk * sizeof(size_t));
+    if (!puzzles || !grids || !status || !solved || !latency || !lines || !line_lens)
     {
         perror("Memory allocation failed");
-        fclose(fp);
+        exit(1);
+    }
+
+    batch_stats_t stats = {0};
+    double start = batch_now();
+    STATS_START();
+    PROFILE_INIT(threads);
+    PROFILE_REGION_BEGIN();
+    for (;;)
+    {
+        long size = 0;
+        while (size < chunk && (status[size] = batch_next(&reader, &puzzles[size * cells])) != 0)
+        {
+            lines[size] = reader.line;
+            line_lens[size] = reader.line_len;
+            size++;
+        }
+        if (size == 0)
+        {
+            break;
+        }
+
+        int n = reader.grid_size, block = reader.block_size;
+#pragma omp parallel for schedule(dynamic)
+        for (long k = 0; k < size; k++)
+        {
+            if (status[k] < 0)
+            {
+                continue;
+            }
+            PROFILE_TASK_BEGIN(omp_get_thread_num());
+            memcpy(&grids[k * cells], &puzzles[k * cells], n * n * sizeof(int));
+            double t = batch_now();
+            solved[k] = sudoku_solver_serial(&grids[k * cells], n, block, 0);
+            latency[k] = batch_now() - t;
+            PROFILE_TASK_END(omp_get_thread_num());
+        }
+
+        for (long k = 0; k < size; k++)
+        {
+            int ok = status[k] > 0;
+            if (ok)
+            {
+                batch_record(&stats, latency[k], solved[k]);
+            }
+            else
+            {
+                stats.invalid++;
+            }
+            if (out)
+            {
+                batch_write_result(out, &reader, &puzzles[k * cells], ok && solved[k] ? &grids[k * cells] : NULL,
+                                   lines[k], line_lens[k]);
+            }
+        }
+    }
+    double elapsed = batch_now() - start;
+    PROFILE_REGION_END();
+
+    if (out && fclose(out) != 0)
+    {
+        perror("Error writing output file");
         return 1;
     }
+    batch_close(&reader);
+    free(puzzles);
+    free(grids);
+    free(status);
+    free(solved);
+    free(latency);
+    free(lines);
+    free(line_lens);
+    char label[32];
+    sprintf(label, "%d threads", threads);
+    batch_report(&stats, elapsed, label);
+    STATS_PRINT("batch");
+    PROFILE_PRINT("batch");
+    return 0;
+}
 
-    // Read the sudoku grid from the file.
-    for (int i = 0; i < grid_size * grid_size; i++)
+int main(int argc, char *argv[])
+{
+    int batch = 0;
+    output_options_t options = {0};
+    progress_options_t progress = {0};
+    const char *positional[2] = {NULL, NULL};
+    int num_positional = 0;
+    for (int i = 1; i < argc; i++)
     {
-        if (fscanf(fp, "%d", &sudoku[i]) != 1)
+        if (strcmp(argv[i], "--batch") == 0)
         {
-            fprintf(stderr, "Error reading sudoku grid from file.\n");
-            free(sudoku);
-            fclose(fp);
-            return 1;
+            batch = 1;
+        }
+        else if (output_parse_option(&options, argv[i]) || progress_parse_option(&progress, argv[i]))
+        {
+            continue;
+        }
+        else if (argv[i][0] != '-' && num_positional < 2)
+        {
+            positional[num_positional++] = argv[i];
+        }
+        else
+        {
+            num_positional = 0;
+            break;
         }
     }
-    fclose(fp);
+    if (num_positional < 1)
+    {
+        fprintf(stderr, "Usage: %s " OUTPUT_USAGE " " PROGRESS_USAGE " <input_file> [<puzzle_index>]\n", argv[0]);
+        fprintf(stderr, "       %s --batch [--output=file] <batch_file>\n", argv[0]);
+        return 1;
+    }
+    if (batch)
+    {
+        return solve_batch(positional[0], options.file);
+    }
+
+    // A puzzle set (see sudoku_loader.h) holds many puzzles, pick one by index
+    long puzzle_index = positional[1] ? atol(positional[1]) : 0;
+    int grid_size, block_size;
+    int *sudoku = load_puzzle(positional[0], puzzle_index, &grid_size, &block_size);
+    if (!sudoku)
+    {
+        return 1;
+    }
+    int *solution = malloc((size_t)grid_size * grid_size * sizeof(int));
+    if (!solution)
+    {
+        perror("Memory allocation failed");
+        exit(1);
+    }
 
-    printf("Input puzzle is:\n");
-    print_sudoku(sudoku, grid_size);
+    output_grid(&options, "Input puzzle is:", sudoku, grid_size);
+    if (progress.probes)
+    {
+        progress_estimate(sudoku, grid_size, block_size, progress.probes, 1);
+    }
+    progress_reset(sudoku, grid_size, block_size);
+    progress_start(&progress);
+    TRACE_INIT(-1);
     struct timespec start, end;
 
     // clock_t start = clock();
     clock_gettime(CLOCK_MONOTONIC, &start);
-    solve_sudoku_parallel(sudoku, grid_size, block_size, &start, &end);
-    clock_gettime(CLOCK_MONOTONIC, &end);
+    STATS_START();
+    int solved = solve_sudoku_parallel(sudoku, grid_size, block_size, solution, &end);
+    if (!solved)
+    {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+    }
+    progress_stop();
 
     // clock_t end = clock();
 
-    printf("Solution is:\n");
-    print_time();
-    print_sudoku(sudoku, grid_size);
-
-    long sec_diff = end.tv_sec - start.tv_sec;
-    long nsec_diff = end.tv_nsec - start.tv_nsec;
-    if (nsec_diff < 0)
+    int status = 0;
+    if (solved)
     {
-        sec_diff--;
-        nsec_diff += 1000000000;
+        if (!options.quiet)
+        {
+            print_time();
+        }
+        status = !output_solution(&options, "Solution is:", sudoku, solution, grid_size, block_size);
     }
+    else
+    {
+        printf("No solution exists.\n");
+        status = 1;
+    }
+    print_elapsed("parallel", elapsed_ms(&start, &end));
+    STATS_PRINT("parallel");
+    PERF_PRINT("parallel");
+    PROFILE_PRINT("parallel");
 
-    double total_ms = sec_diff * 1000.0 + nsec_diff / 1000000.0;
-    int hrs = total_ms / (3600.0 * 1000.0);
-    double remainder = total_ms - hrs * 3600.0 * 1000.0;
-    int mins = remainder / (60.0 * 1000.0);
-    remainder -= mins * 60.0 * 1000.0;
-    int secs = remainder / 1000.0;
-    double ms = remainder - secs * 1000.0;
-
-    // double time_taken = ((double)(end - start)) / CLOCKS_PER_SEC * 1000.0;
-    printf("Time taken to solve (parallel): %02dhr: %02dmin: %02dsec: %06.2fms\n", hrs, mins, secs, ms);
-
+    free(solution);
     free(sudoku);
-    return 0;
+    return status;
 }
@@ -5,6 +5,11 @@
 #include <math.h>
 #include <pthread.h>
 #include <stdint.h>
+#include "sudoku_output.h"
+#include "sudoku_stats.h"
+#include "sudoku_profile.h"
+#include "sudoku_trace.h"
+#include "sudoku_perf.h"
 
 #define N 36               // Fix grid size
 #define SUBGRID 6          // sqrt(N)
@@ -30,16 +35,6 @@ void print_time() {
     printf("%s\n", buffer);
 }
 
-void print_sudoku(int *sudoku, int grid_size) {
-    printf("The Sudoku contains:\n");
-    for (int i = 0; i < grid_size; i++) {
-        for (int j = 0; j < grid_size; j++) {
-            printf("%2d ", sudoku[i * grid_size + j]);
-        }
-        printf("\n");
-    }
-}
-
 int check_square(int *sudoku, int grid_size, int block_size, int num, int row, int col) {
     int row_start = row - row % block_size;
     int col_start = col - col % block_size;
@@ -80,6 +75,8 @@ typedef struct {
     int grid_size;
     int block_size;
     int depth;
+    unsigned task;     // trace id
+    int row, col, num; // the candidate this thread tries
 } solver_args_t;
 
 // Forward declaration
@@ -88,7 +85,20 @@ int sudoku_solver_parallel_pthread(int *sudoku, int grid_size, int block_size, i
 // Thread wrapper function
 void* solver_thread_func(void* arg) {
     solver_args_t* args = (solver_args_t*) arg;
+    PERF_BEGIN();
+    int slot = PROFILE_ACQUIRE_SLOT();
+    PROFILE_SET_SLOT(slot);
+    PROFILE_TASK_BEGIN(slot);
+    TRACE_START(args->task, args->depth, args->row, args->col, args->num);
     int result = sudoku_solver_parallel_pthread(args->sudoku, args->grid_size, args->block_size, args->depth);
+#ifdef SOLVER_TRACE
+    if (!result && __atomic_load_n(&solved, __ATOMIC_RELAXED)) {
+        TRACE_CANCEL(args->task, args->depth, args->row, args->col, args->num);
+    }
+#endif
+    TRACE_FINISH(args->task, args->depth, args->row, args->col, args->num);
+    PROFILE_TASK_END(slot);
+    PROFILE_RELEASE_SLOT(slot);
     
     // Decrement the active thread count
     pthread_mutex_lock(&thread_count_mutex);
@@ -96,25 +106,25 @@ void* solver_thread_func(void* arg) {
     pthread_mutex_unlock(&thread_count_mutex);
     
     free(args); // Free the allocated arguments wrapper.
+    PERF_END();
     return (void*)(intptr_t) result;
 }
 
 int sudoku_solver_parallel_pthread(int *sudoku, int grid_size, int block_size, int depth) {
     // Check if a solution is already found
-    pthread_mutex_lock(&solved_mutex);
+    PROFILE_LOCK(PROFILE_SLOT(), &solved_mutex);
     int local_solved = solved;
     pthread_mutex_unlock(&solved_mutex);
     if (local_solved)
         return 0;
 
+    STATS_NODE(depth);
     int row, col;
     if (!find_unassigned(sudoku, grid_size, &row, &col)) {
         // Puzzle solved.
-        pthread_mutex_lock(&solved_mutex);
-        if (!solved) {
-            solved = 1;
-            print_time();  
-        }
+        STATS_SOLUTION();
+        PROFILE_LOCK(PROFILE_SLOT(), &solved_mutex);
+        solved = 1;
         pthread_mutex_unlock(&solved_mutex);
         return 1;
     }
@@ -126,10 +136,11 @@ int sudoku_solver_parallel_pthread(int *sudoku, int grid_size, int block_size, i
     int *thread_sudokus[grid_size];
 
     for (int num = 1; num <= grid_size && !found_solution; num++) {
+        STATS_CHECK();
         if (check_sudoku(sudoku, grid_size, block_size, num, row, col)) {
             if (depth < PARALLEL_CUTOFF) {
                 // Check if we can spawn a new thread.
-                pthread_mutex_lock(&thread_count_mutex);
+                PROFILE_LOCK(PROFILE_SLOT(), &thread_count_mutex);
                 if (active_threads < MAX_THREADS) {
                     active_threads++;
                     pthread_mutex_unlock(&thread_count_mutex);
@@ -153,6 +164,11 @@ int sudoku_solver_parallel_pthread(int *sudoku, int grid_size, int block_size, i
                     args->grid_size = grid_size;
                     args->block_size = block_size;
                     args->depth = depth + 1;
+                    args->task = TRACE_NEW_ID();
+                    args->row = row;
+                    args->col = col;
+                    args->num = num;
+                    TRACE_SPAWN(args->task, depth + 1, row, col, num);
                     
                     // Create the new thread
                     int rc = pthread_create(&threads[thread_count], NULL, solver_thread_func, (void*) args);
@@ -160,6 +176,7 @@ int sudoku_solver_parallel_pthread(int *sudoku, int grid_size, int block_size, i
                         perror("pthread_create failed");
                         exit(1);
                     }
+                    PROFILE_SPAWN(PROFILE_SLOT());
                     thread_sudokus[thread_count] = sudoku_copy;
                     thread_count++;
                 } else {
@@ -169,6 +186,7 @@ int sudoku_solver_parallel_pthread(int *sudoku, int grid_size, int block_size, i
                     if (sudoku_solver_parallel_pthread(sudoku, grid_size, block_size, depth + 1))
                         return 1;
                     sudoku[row * grid_size + col] = 0; // Backtrack
+                    STATS_BACKTRACK();
                 }
             } else {
                 // Deeper recursion: continue serially
@@ -176,11 +194,13 @@ int sudoku_solver_parallel_pthread(int *sudoku, int grid_size, int block_size, i
                 if (sudoku_solver_parallel_pthread(sudoku, grid_size, block_size, depth + 1))
                     return 1;
                 sudoku[row * grid_size + col] = 0;
+                STATS_BACKTRACK();
             }
         }
     }
 
     // Wait for all spawned threads
+    PROFILE_WAIT_BEGIN(wait, thread_count > 0 ? PROFILE_SLOT() : -1);
     for (int i = 0; i < thread_count; i++) {
         void* thread_result;
         pthread_join(threads[i], &thread_result);
@@ -191,13 +211,23 @@ int sudoku_solver_parallel_pthread(int *sudoku, int grid_size, int block_size, i
             found_solution = 1;
         } else {
             free(thread_sudokus[i]);
+            STATS_BACKTRACK(); // The copy with this candidate is dropped
         }
     }
+    PROFILE_WAIT_END(wait);
     return found_solution;
 }
 
 
-int main() {
+int main(int argc, char *argv[]) {
+    output_options_t options = {0};
+    for (int i = 1; i < argc; i++) {
+        if (!output_parse_option(&options, argv[i])) {
+            fprintf(stderr, "Usage: %s " OUTPUT_USAGE "\n", argv[0]);
+            return 1;
+        }
+    }
+
     // The sudoku puzzle is hard-coded here
     int static_grid[N][N] = {
         {  0,  0,  0, 16,  0, 20, 19, 33,  0, 35, 24, 12,  0,  0,  0,  4,  0, 27,  0,  0, 30,  0, 14, 34, 25, 36,  0, 10, 18,  0, 32, 15, 28,  5,  1,  8 },
@@ -248,29 +278,51 @@ int main() {
         for (int j = 0; j < N; j++)
             sudoku[i * N + j] = static_grid[i][j];
 
-    printf("Original Sudoku:\n");
-    print_sudoku(sudoku, N);
+    int *puzzle = malloc(N * N * sizeof(int));
+    if (!puzzle) {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    memcpy(puzzle, sudoku, N * N * sizeof(int));
+    output_grid(&options, "Original Sudoku:", sudoku, N);
 
+    TRACE_INIT(-1);
     struct timespec start, end;
+    PERF_BEGIN();
     clock_gettime(CLOCK_MONOTONIC, &start);
-    sudoku_solver_parallel_pthread(sudoku, N, SUBGRID, 0);
+    STATS_START();
+    PROFILE_INIT(MAX_THREADS + 1); // slot 0 is this thread
+    PROFILE_REGION_BEGIN();
+    PROFILE_TASK_BEGIN(0);
+    TRACE_START(0, 0, -1, -1, -1);
+    int found = sudoku_solver_parallel_pthread(sudoku, N, SUBGRID, 0);
+    TRACE_FINISH(0, 0, -1, -1, -1);
+    PROFILE_TASK_END(0);
+    PROFILE_REGION_END();
     clock_gettime(CLOCK_MONOTONIC, &end);
+    PERF_END();
 
-    long sec_diff = end.tv_sec - start.tv_sec;
-    long nsec_diff = end.tv_nsec - start.tv_nsec;
-    if (nsec_diff < 0) {
-        sec_diff--;
-        nsec_diff += 1000000000;
-    }
-    double total_ms = sec_diff * 1000.0 + nsec_diff / 1000000.0;
+    double total_ms = elapsed_ms(&start, &end);
 
-    printf("\nSolved Sudoku:\n");
-    print_time();
-    print_sudoku(sudoku, N);
+    int status = 0;
+    if (found) {
+        if (!options.quiet) {
+            printf("\n");
+            print_time();
+        }
+        status = !output_solution(&options, "Solved Sudoku:", puzzle, sudoku, N, SUBGRID);
+    } else {
+        printf("\nNo solution exists.\n");
+        status = 1;
+    }
     printf("\nTime taken (pthread with max threads): %.2f ms\n", total_ms);
+    STATS_PRINT("pthread");
+    PROFILE_PRINT("pthread");
+    PERF_PRINT("pthread");
 
+    free(puzzle);
     free(sudoku);
-    return 0;
+    return status;
 }
 
 
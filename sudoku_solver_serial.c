@@ -1,20 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include <time.h>
-
-void print_sudoku(int *sudoku, int grid_size)
-{
-    printf("The Sudoku contains:\n");
-    for (int i = 0; i < grid_size; i++)
-    {
-        for (int j = 0; j < grid_size; j++)
-        {
-            printf("%d  ", sudoku[i * grid_size + j]);
-        }
-        printf("\n");
-    }
-}
+#include "sudoku_batch.h"
+#include "sudoku_output.h"
+#include "sudoku_stats.h"
+#include "sudoku_progress.h"
+#include "sudoku_perf.h"
 
 int check_square(int *sudoku, int grid_size, int block_size, int num, int row, int col)
 {
@@ -62,115 +55,199 @@ int find_unassigned(int *sudoku, int grid_size, int *row, int *col)
     return 0;
 }
 
-int sudoku_solver_serial(int *sudoku, int grid_size, int block_size)
+// depth is the number of placements above this call, for the search stats
+int sudoku_solver_serial(int *sudoku, int grid_size, int block_size, int depth)
 {
+    STATS_NODE(depth);
+    progress_node(depth);
     int row, col;
     if (!find_unassigned(sudoku, grid_size, &row, &col))
+    {
+        STATS_SOLUTION();
         return 1; // Puzzle solved
+    }
 
     for (int num = 1; num <= grid_size; num++)
     {
+        STATS_CHECK();
         if (check_sudoku(sudoku, grid_size, block_size, num, row, col))
         {
             sudoku[row * grid_size + col] = num;
-            if (sudoku_solver_serial(sudoku, grid_size, block_size))
+            if (sudoku_solver_serial(sudoku, grid_size, block_size, depth + 1))
                 return 1;
             sudoku[row * grid_size + col] = 0;
+            STATS_BACKTRACK();
+            progress_root_branch_done(depth);
         }
     }
     return 0;
 }
 
-void solve_sudoku_serial(int *sudoku, int grid_size, int block_size)
+int solve_sudoku_serial(int *sudoku, int grid_size, int block_size)
 {
-    sudoku_solver_serial(sudoku, grid_size, block_size);
+    return sudoku_solver_serial(sudoku, grid_size, block_size, 0);
 }
 
-int main(int argc, char *argv[])
+// Solve every puzzle of a batch file (see sudoku_batch.h) in turn and
+// report throughput and latency. Solutions go to output if it is set.
+int solve_batch(const char *filename, const char *output)
 {
-    if (argc < 2)
+    batch_reader_t reader;
+    if (!batch_open(&reader, filename))
     {
-        fprintf(stderr, "Usage: %s <input_file>\n", argv[0]);
         return 1;
     }
+    FILE *out = NULL;
+    if (output)
+    {
+        out = fopen(output, "wb");
+        if (!out)
+        {
+            perror("Error opening output file");
+            batch_close(&reader);
+            return 1;
+        }
+        batch_begin_output(out, &reader);
+    }
 
-    FILE *fp = fopen(argv[1], "r");
-    if (!fp)
+    size_t cells = batch_max_cells(&reader);
+    int *puzzle = malloc(cells * sizeof(int));
+    int *sudoku = malloc(cells * sizeof(int));
+    if (!puzzle || !sudoku)
     {
-        perror("Error opening file");
-        return 1;
+        perror("Memory allocation failed");
+        exit(1);
+    }
+
+    batch_stats_t stats = {0};
+    double start = batch_now();
+    STATS_START();
+    int status;
+    while ((status = batch_next(&reader, puzzle)) != 0)
+    {
+        if (status < 0)
+        {
+            stats.invalid++;
+            if (out)
+            {
+                batch_write_result(out, &reader, puzzle, NULL, reader.line, reader.line_len);
+            }
+            continue;
+        }
+        int n = reader.grid_size;
+        memcpy(sudoku, puzzle, n * n * sizeof(int));
+        double t = batch_now();
+        int solved = sudoku_solver_serial(sudoku, n, reader.block_size, 0);
+        batch_record(&stats, batch_now() - t, solved);
+        if (out)
+        {
+            batch_write_result(out, &reader, puzzle, solved ? sudoku : NULL, reader.line, reader.line_len);
+        }
     }
+    double elapsed = batch_now() - start;
 
-    int grid_size;
-    // File format: first integer is grid size (e.g., 9 for a 9x9 sudoku)
-    if (fscanf(fp, "%d", &grid_size) != 1)
+    if (out && fclose(out) != 0)
     {
-        fprintf(stderr, "Error reading grid size from file.\n");
-        fclose(fp);
+        perror("Error writing output file");
         return 1;
     }
+    batch_close(&reader);
+    free(puzzle);
+    free(sudoku);
+    batch_report(&stats, elapsed, "serial");
+    STATS_PRINT("batch");
+    return 0;
+}
 
-    int block_size = sqrt(grid_size);
-    if (block_size * block_size != grid_size)
+int main(int argc, char *argv[])
+{
+    int batch = 0;
+    output_options_t options = {0};
+    progress_options_t progress = {0};
+    const char *positional[2] = {NULL, NULL};
+    int num_positional = 0;
+    for (int i = 1; i < argc; i++)
     {
-        fprintf(stderr, "Grid size must be a perfect square (e.g., 4, 9, 16, ...).\n");
-        fclose(fp);
+        if (strcmp(argv[i], "--batch") == 0)
+        {
+            batch = 1;
+        }
+        else if (output_parse_option(&options, argv[i]) || progress_parse_option(&progress, argv[i]))
+        {
+            continue;
+        }
+        else if (argv[i][0] != '-' && num_positional < 2)
+        {
+            positional[num_positional++] = argv[i];
+        }
+        else
+        {
+            num_positional = 0;
+            break;
+        }
+    }
+    if (num_positional < 1)
+    {
+        fprintf(stderr, "Usage: %s " OUTPUT_USAGE " " PROGRESS_USAGE " <input_file> [<puzzle_index>]\n", argv[0]);
+        fprintf(stderr, "       %s --batch [--output=file] <batch_file>\n", argv[0]);
         return 1;
     }
+    if (batch)
+    {
+        return solve_batch(positional[0], options.file);
+    }
 
-    int *sudoku = malloc(grid_size * grid_size * sizeof(int));
+    // A puzzle set (see sudoku_loader.h) holds many puzzles, pick one by index
+    long puzzle_index = positional[1] ? atol(positional[1]) : 0;
+    int grid_size, block_size;
+    int *sudoku = load_puzzle(positional[0], puzzle_index, &grid_size, &block_size);
     if (!sudoku)
     {
-        perror("Memory allocation failed");
-        fclose(fp);
         return 1;
     }
-
-    // Read the sudoku grid from the file.
-    for (int i = 0; i < grid_size * grid_size; i++)
+    int *puzzle = malloc((size_t)grid_size * grid_size * sizeof(int));
+    if (!puzzle)
     {
-        if (fscanf(fp, "%d", &sudoku[i]) != 1)
-        {
-            fprintf(stderr, "Error reading sudoku grid from file.\n");
-            free(sudoku);
-            fclose(fp);
-            return 1;
-        }
+        perror("Memory allocation failed");
+        exit(1);
     }
-    fclose(fp);
+    memcpy(puzzle, sudoku, (size_t)grid_size * grid_size * sizeof(int));
 
-    printf("Input puzzle is:\n");
-    print_sudoku(sudoku, grid_size);
+    output_grid(&options, "Input puzzle is:", sudoku, grid_size);
+    if (progress.probes)
+    {
+        progress_estimate(sudoku, grid_size, block_size, progress.probes, 1);
+    }
+    progress_reset(sudoku, grid_size, block_size);
+    progress_start(&progress);
 
     struct timespec start, end;
 
     // clock_t start = clock();
+    PERF_BEGIN();
     clock_gettime(CLOCK_MONOTONIC, &start);
-    solve_sudoku_serial(sudoku, grid_size, block_size);
+    STATS_START();
+    int solved = solve_sudoku_serial(sudoku, grid_size, block_size);
     clock_gettime(CLOCK_MONOTONIC, &end);
+    PERF_END();
+    progress_stop();
     // clock_t end = clock();
 
-    printf("Solution is:\n");
-    print_sudoku(sudoku, grid_size);
-
-    long sec_diff = end.tv_sec - start.tv_sec;
-    long nsec_diff = end.tv_nsec - start.tv_nsec;
-    if (nsec_diff < 0)
+    int status = 0;
+    if (solved)
     {
-        sec_diff--;
-        nsec_diff += 1000000000;
+        status = !output_solution(&options, "Solution is:", puzzle, sudoku, grid_size, block_size);
     }
+    else
+    {
+        printf("No solution exists.\n");
+        status = 1;
+    }
+    print_elapsed("serial", elapsed_ms(&start, &end));
+    STATS_PRINT("serial");
+    PERF_PRINT("serial");
 
-    double total_ms = sec_diff * 1000.0 + nsec_diff / 1000000.0;
-    int hrs = total_ms / (3600.0 * 1000.0);
-    double remainder = total_ms - hrs * 3600.0 * 1000.0;
-    int mins = remainder / (60.0 * 1000.0);
-    remainder -= mins * 60.0 * 1000.0;
-    int secs = remainder / 1000.0;
-    double ms = remainder - secs * 1000.0;
-    // double time_taken = ((double)(end - start)) / CLOCKS_PER_SEC * 1000.0;
-    printf("Time taken to solve (serial): %02dhr: %02dmin: %02dsec: %06.2fms\n", hrs, mins, secs, ms);
-
+    free(puzzle);
     free(sudoku);
-    return 0;
+    return status;
 }
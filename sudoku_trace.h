@@ -0,0 +1,280 @@
+#ifndef SUDOKU_TRACE_H
+#define SUDOKU_TRACE_H
+
+// Scheduling timeline for the parallel solvers, compiled in with
+// -DSOLVER_TRACE. Without it every TRACE_* macro expands to nothing.
+//
+// The solvers record task spawn, start, finish and cancel (a task cut short
+// because another one found the solution) with the depth and the candidate
+// the task tries, and the MPI solver records every send and receive. At exit
+// the events are written as Chrome trace JSON, which chrome://tracing and
+// https://ui.perfetto.dev open as one timeline row per thread: the gaps in a
+// row are where that worker sat idle. Arrows join each spawn to the start of
+// its task, so a task started on another thread shows where work moved.
+//
+// The file is trace.json, or the path in the SOLVER_TRACE_FILE environment
+// variable. MPI ranks write one file each, trace.<rank>.json; the timestamps
+// are CLOCK_MONOTONIC, so the files of ranks on one node line up and
+// scripts/merge_traces.py joins them.
+//
+// Each thread records into its own ring of TRACE_RING_EVENTS events, which
+// only that thread writes, so recording takes no lock; a new ring is pushed
+// on the list of rings with a compare-and-swap. A full ring drops its oldest
+// events; the number dropped is printed at exit.
+
+#ifdef SOLVER_TRACE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef TRACE_RING_EVENTS
+#define TRACE_RING_EVENTS (1 << 16) // per thread, a power of two
+#endif
+
+enum
+{
+    TRACE_EV_SPAWN,
+    TRACE_EV_START,
+    TRACE_EV_FINISH,
+    TRACE_EV_CANCEL,
+    TRACE_EV_SEND_BEGIN,
+    TRACE_EV_SEND_END,
+    TRACE_EV_RECV_BEGIN,
+    TRACE_EV_RECV_END
+};
+
+// Tasks: a = depth, b = row, c = col, d = candidate (-1 when unknown).
+// Messages: a = peer rank, b = tag, c = count.
+typedef struct
+{
+    double ts; // microseconds
+    unsigned id;
+    int kind;
+    int a, b, c, d;
+} trace_event_t;
+
+typedef struct trace_ring
+{
+    trace_event_t events[TRACE_RING_EVENTS];
+    unsigned long long head; // events ever recorded
+    int thread;
+    struct trace_ring *next;
+} trace_ring_t;
+
+static trace_ring_t *trace_rings = NULL;
+static int trace_num_threads = 0;
+static unsigned trace_next_id = 0;
+static int trace_process = -1; // MPI rank, -1 for a single process
+static __thread trace_ring_t *trace_local = NULL;
+
+static inline double trace_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static inline trace_ring_t *trace_thread(void)
+{
+    if (!trace_local)
+    {
+        trace_ring_t *ring = malloc(sizeof(trace_ring_t));
+        if (!ring)
+        {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+        ring->head = 0;
+        ring->thread = __atomic_fetch_add(&trace_num_threads, 1, __ATOMIC_RELAXED);
+        ring->next = __atomic_load_n(&trace_rings, __ATOMIC_RELAXED);
+        while (!__atomic_compare_exchange_n(&trace_rings, &ring->next, ring, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+        {
+        }
+        trace_local = ring;
+    }
+    return trace_local;
+}
+
+static inline void trace_record(int kind, unsigned id, int a, int b, int c, int d)
+{
+    trace_ring_t *ring = trace_thread();
+    trace_event_t *e = &ring->events[ring->head & (TRACE_RING_EVENTS - 1)];
+    e->ts = trace_now_us();
+    e->id = id;
+    e->kind = kind;
+    e->a = a;
+    e->b = b;
+    e->c = c;
+    e->d = d;
+    __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELEASE);
+}
+
+static inline unsigned trace_new_id(void)
+{
+    return __atomic_add_fetch(&trace_next_id, 1, __ATOMIC_RELAXED);
+}
+
+// "d2 r0c3=7": a task at depth 2 trying 7 in row 0, column 3
+static inline void trace_task_name(char *name, size_t size, const trace_event_t *e)
+{
+    if (e->b >= 0)
+    {
+        snprintf(name, size, "d%d r%dc%d=%d", e->a, e->b, e->c, e->d);
+    }
+    else
+    {
+        snprintf(name, size, "d%d task %u", e->a, e->id);
+    }
+}
+
+static inline void trace_write_event(FILE *out, int pid, int tid, const trace_event_t *e)
+{
+    char name[64];
+    const char *task_args = "{\"depth\":%d,\"row\":%d,\"col\":%d,\"candidate\":%d,\"task\":%u}";
+    switch (e->kind)
+    {
+    case TRACE_EV_SPAWN:
+    case TRACE_EV_CANCEL:
+    case TRACE_EV_START:
+    case TRACE_EV_FINISH:
+        trace_task_name(name, sizeof(name), e);
+        if (e->kind == TRACE_EV_SPAWN || e->kind == TRACE_EV_CANCEL)
+        {
+            fprintf(out, ",\n{\"name\":\"%s %s\",\"cat\":\"task\",\"ph\":\"i\",\"s\":\"t\"",
+                    e->kind == TRACE_EV_SPAWN ? "spawn" : "cancel", name);
+        }
+        else
+        {
+            fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"task\",\"ph\":\"%s\"", name,
+                    e->kind == TRACE_EV_START ? "B" : "E");
+        }
+        fprintf(out, ",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":", pid, tid, e->ts);
+        fprintf(out, task_args, e->a, e->b, e->c, e->d, e->id);
+        fputs("}", out);
+        // Flow arrow from the spawn to the start of the task; only spawned
+        // tasks have a candidate
+        if ((e->kind == TRACE_EV_SPAWN || e->kind == TRACE_EV_START) && e->b >= 0)
+        {
+            fprintf(out, ",\n{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"%s\",%s\"id\":%u,\"pid\":%d,\"tid\":%d,\"ts\":%.3f}",
+                    e->kind == TRACE_EV_SPAWN ? "s" : "f", e->kind == TRACE_EV_START ? "\"bp\":\"e\"," : "", e->id,
+                    pid, tid, e->ts);
+        }
+        break;
+    default:
+    {
+        int send = e->kind == TRACE_EV_SEND_BEGIN || e->kind == TRACE_EV_SEND_END;
+        int begin = e->kind == TRACE_EV_SEND_BEGIN || e->kind == TRACE_EV_RECV_BEGIN;
+        fprintf(out,
+                ",\n{\"name\":\"%s\",\"cat\":\"mpi\",\"ph\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,"
+                "\"args\":{\"%s\":%d,\"tag\":%d,\"count\":%d}}",
+                send ? "MPI_Send" : "MPI_Recv", begin ? "B" : "E", pid, tid, e->ts, send ? "dest" : "source", e->a,
+                e->b, e->c);
+        break;
+    }
+    }
+}
+
+// Write every ring to the trace file. Registered with atexit by TRACE_INIT;
+// the other threads have stopped recording by then.
+static inline void trace_dump(void)
+{
+    const char *path = getenv("SOLVER_TRACE_FILE");
+    char file[4096];
+    if (!path || !*path)
+    {
+        path = "trace.json";
+    }
+    if (trace_process >= 0)
+    {
+        size_t length = strlen(path);
+        if (length > 5 && strcmp(path + length - 5, ".json") == 0)
+        {
+            length -= 5;
+        }
+        snprintf(file, sizeof(file), "%.*s.%d.json", (int)length, path, trace_process);
+    }
+    else
+    {
+        snprintf(file, sizeof(file), "%s", path);
+    }
+
+    FILE *out = fopen(file, "w");
+    if (!out)
+    {
+        perror("Error opening trace file");
+        return;
+    }
+    int pid = trace_process >= 0 ? trace_process : 0;
+    unsigned long long recorded = 0, dropped = 0;
+    fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    if (trace_process >= 0)
+    {
+        fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"rank %d\"}}", pid, pid);
+    }
+    else
+    {
+        fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":\"solver\"}}");
+    }
+    trace_ring_t *ring = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE);
+    for (; ring; ring = ring->next)
+    {
+        unsigned long long head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        unsigned long long first = head > TRACE_RING_EVENTS ? head - TRACE_RING_EVENTS : 0;
+        fprintf(out, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"worker %d\"}}",
+                pid, ring->thread, ring->thread);
+        for (unsigned long long i = first; i < head; i++)
+        {
+            trace_write_event(out, pid, ring->thread, &ring->events[i & (TRACE_RING_EVENTS - 1)]);
+        }
+        recorded += head - first;
+        dropped += first;
+    }
+    fprintf(out, "\n],\"otherData\":{\"dropped\":%llu}}\n", dropped);
+    if (fclose(out) != 0)
+    {
+        perror("Error writing trace file");
+        return;
+    }
+    fprintf(stderr, "Trace: %llu events written to %s", recorded, file);
+    if (dropped)
+    {
+        fprintf(stderr, " (%llu oldest dropped, raise TRACE_RING_EVENTS)", dropped);
+    }
+    fprintf(stderr, "\n");
+}
+
+static inline void trace_init(int process)
+{
+    trace_process = process;
+    atexit(trace_dump);
+}
+
+#define TRACE_INIT(process) trace_init(process)
+#define TRACE_NEW_ID() trace_new_id()
+#define TRACE_SPAWN(id, depth, row, col, num) trace_record(TRACE_EV_SPAWN, id, depth, row, col, num)
+#define TRACE_START(id, depth, row, col, num) trace_record(TRACE_EV_START, id, depth, row, col, num)
+#define TRACE_FINISH(id, depth, row, col, num) trace_record(TRACE_EV_FINISH, id, depth, row, col, num)
+#define TRACE_CANCEL(id, depth, row, col, num) trace_record(TRACE_EV_CANCEL, id, depth, row, col, num)
+#define TRACE_SEND_BEGIN(dest, tag, count) trace_record(TRACE_EV_SEND_BEGIN, 0, dest, tag, count, 0)
+#define TRACE_SEND_END(dest, tag, count) trace_record(TRACE_EV_SEND_END, 0, dest, tag, count, 0)
+#define TRACE_RECV_BEGIN(source, tag, count) trace_record(TRACE_EV_RECV_BEGIN, 0, source, tag, count, 0)
+#define TRACE_RECV_END(source, tag, count) trace_record(TRACE_EV_RECV_END, 0, source, tag, count, 0)
+
+#else
+
+#define TRACE_INIT(process) ((void)0)
+#define TRACE_NEW_ID() 0u
+#define TRACE_SPAWN(id, depth, row, col, num) ((void)(id))
+#define TRACE_START(id, depth, row, col, num) ((void)(id))
+#define TRACE_FINISH(id, depth, row, col, num) ((void)(id))
+#define TRACE_CANCEL(id, depth, row, col, num) ((void)(id))
+#define TRACE_SEND_BEGIN(dest, tag, count) ((void)0)
+#define TRACE_SEND_END(dest, tag, count) ((void)0)
+#define TRACE_RECV_BEGIN(source, tag, count) ((void)0)
+#define TRACE_RECV_END(source, tag, count) ((void)0)
+
+#endif
+
+#endif
@@ -0,0 +1,642 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <omp.h>
+#include "sudoku_batch.h"
+
+// Checks solutions the way scripts/verify_sudoku_solution.py does, for
+// grids and batches too large for it, and also checks that each solution
+// keeps the givens of its puzzle.
+//
+// A solution file is one of:
+//
+//   a text grid      n rows of n numbers, as the solvers write with --output
+//                    (a first line holding n, as in puzzle files, is skipped)
+//   a puzzle set     every record; with solutions, the solution is checked
+//                    against the puzzle of its record (sudoku_loader.h)
+//   a line batch     with --batch, one grid per line (sudoku_batch.h); a
+//                    "puzzle,solution" line is checked against its puzzle
+//
+// --puzzle=FILE gives the puzzles instead: a puzzle file (--index picks the
+// record of a set) for a text grid, or a batch in the same order for a set
+// or line batch, like the input of a solver run with --batch.
+//
+// Every cell must hold a number from 1 to n (0 means unsolved), and every
+// row, column and box must hold each number once, which is checked with one
+// bit per number. Records are checked in parallel, and a single grid by
+// splitting its rows, columns and boxes between threads. The exit status is
+// 0 only if everything is valid.
+//
+// The solvers write an unsolved puzzle of a batch back as it was read, so
+// check their batch output with --puzzle=<their input>: a corpus line left
+// as "puzzle,solution" would otherwise pass on the solution it carries.
+
+#define VERIFY_CHUNK 4096     // records read per parallel pass over a batch
+#define VERIFY_MAX_REPORTS 10 // invalid records described one by one
+
+// What is wrong with a grid, in the order it is looked for
+enum
+{
+    VERIFY_OK,
+    VERIFY_EMPTY, // a cell is 0: the puzzle was not solved
+    VERIFY_RANGE, // a cell is not a number from 1 to n
+    VERIFY_GIVEN, // a cell differs from the given of the puzzle
+    VERIFY_ROW,
+    VERIFY_COLUMN,
+    VERIFY_BOX,
+    VERIFY_NOT_GRID, // a batch line that is not a grid of the batch's size
+    VERIFY_PROBLEMS
+};
+
+typedef struct
+{
+    int problem;
+    long where; // cell index, or the row, column or box
+} verify_result_t;
+
+// First cell of begin .. end - 1 that is empty, out of range or against a
+// given of puzzle (if not NULL), or n * n if there is none
+static long verify_cells(const int *grid, const int *puzzle, int n, long begin, long end, int *problem)
+{
+    for (long i = begin; i < end; i++)
+    {
+        int v = grid[i];
+        if (v == 0)
+        {
+            *problem = VERIFY_EMPTY;
+            return i;
+        }
+        if (v < 0 || v > n)
+        {
+            *problem = VERIFY_RANGE;
+            return i;
+        }
+        if (puzzle && puzzle[i] != 0 && puzzle[i] != v)
+        {
+            *problem = VERIFY_GIVEN;
+            return i;
+        }
+    }
+    return (long)n * n;
+}
+
+// First of rows begin .. end - 1 that repeats a number, or n. The cells
+// must have passed verify_cells. seen has words words.
+static int verify_rows(const int *grid, int n, int begin, int end, uint64_t *seen, size_t words)
+{
+    for (int row = begin; row < end; row++)
+    {
+        memset(seen, 0, words * sizeof(uint64_t));
+        for (int col = 0; col < n; col++)
+        {
+            if (mark_seen(seen, words, 0, grid[(size_t)row * n + col] - 1))
+            {
+                return row;
+            }
+        }
+    }
+    return n;
+}
+
+// First of columns begin .. end - 1 that repeats a number, or n. Columns are
+// walked 64 at a time down the grid, so each row is read in one run. seen
+// has 64 * words words.
+static int verify_columns(const int *grid, int n, int begin, int end, uint64_t *seen, size_t words)
+{
+    for (int first = begin; first < end; first += 64)
+    {
+        int last = first + 64 < end ? first + 64 : end;
+        int bad = n;
+        memset(seen, 0, 64 * words * sizeof(uint64_t));
+        for (int row = 0; row < n; row++)
+        {
+            for (int col = first; col < last; col++)
+            {
+                if (mark_seen(seen, words, col - first, grid[(size_t)row * n + col] - 1) && col < bad)
+                {
+                    bad = col;
+                }
+            }
+        }
+        if (bad < n)
+        {
+            return bad;
+        }
+    }
+    return n;
+}
+
+// First of boxes begin .. end - 1 (numbered row-major) that repeats a
+// number, or n
+static int verify_boxes(const int *grid, int n, int block, int begin, int end, uint64_t *seen, size_t words)
+{
+    for (int box = begin; box < end; box++)
+    {
+        int row_start = box / block * block, col_start = box % block * block;
+        memset(seen, 0, words * sizeof(uint64_t));
+        for (int i = 0; i < n; i++)
+        {
+            if (mark_seen(seen, words, 0, grid[(size_t)(row_start + i / block) * n + col_start + i % block] - 1))
+            {
+                return box;
+            }
+        }
+    }
+    return n;
+}
+
+// Check one grid on the calling thread. seen has 64 * words words.
+static verify_result_t verify_grid(const int *grid, const int *puzzle, int n, int block, uint64_t *seen,
+                                   size_t words)
+{
+    verify_result_t result = {VERIFY_OK, 0};
+    int unit;
+    if ((result.where = verify_cells(grid, puzzle, n, 0, (long)n * n, &result.problem)) < (long)n * n)
+    {
+        return result;
+    }
+    if ((unit = verify_rows(grid, n, 0, n, seen, words)) < n)
+    {
+        result.problem = VERIFY_ROW;
+    }
+    else if ((unit = verify_columns(grid, n, 0, n, seen, words)) < n)
+    {
+        result.problem = VERIFY_COLUMN;
+    }
+    else if ((unit = verify_boxes(grid, n, block, 0, n, seen, words)) < n)
+    {
+        result.problem = VERIFY_BOX;
+    }
+    result.where = unit;
+    return result;
+}
+
+// Check one large grid with all threads: each phase finds the first bad
+// cell or unit with a min reduction. The private copies of a reduction
+// start at the largest value, so each test is against "none found" first.
+static verify_result_t verify_grid_parallel(const int *grid, const int *puzzle, int n, int block)
+{
+    size_t words = (n + 63) / 64;
+    long cells = (long)n * n, first_cell = cells;
+    int first_row = n, first_column = n, first_box = n;
+#pragma omp parallel
+    {
+        uint64_t *seen = malloc(64 * words * sizeof(uint64_t));
+        if (!seen)
+        {
+            perror("Memory allocation failed");
+            exit(1);
+        }
+        int problem;
+#pragma omp for schedule(static) reduction(min : first_cell)
+        for (int row = 0; row < n; row++)
+        {
+            long bad = verify_cells(grid, puzzle, n, (long)row * n, (long)(row + 1) * n, &problem);
+            if (bad < (long)(row + 1) * n && bad < first_cell)
+            {
+                first_cell = bad;
+            }
+        }
+        // Units only hold numbers from 1 to n once the cells passed
+        if (first_cell == cells)
+        {
+#pragma omp for schedule(static) reduction(min : first_row) nowait
+            for (int row = 0; row < n; row++)
+            {
+                if (verify_rows(grid, n, row, row + 1, seen, words) < n && row < first_row)
+                {
+                    first_row = row;
+                }
+            }
+#pragma omp for schedule(static) reduction(min : first_column) nowait
+            for (int band = 0; band < (n + 63) / 64; band++)
+            {
+                int end = band * 64 + 64 < n ? band * 64 + 64 : n;
+                int bad = verify_columns(grid, n, band * 64, end, seen, words);
+                if (bad < n && bad < first_column)
+                {
+                    first_column = bad;
+                }
+            }
+#pragma omp for schedule(static) reduction(min : first_box)
+            for (int box = 0; box < n; box++)
+            {
+                if (verify_boxes(grid, n, block, box, box + 1, seen, words) < n && box < first_box)
+                {
+                    first_box = box;
+                }
+            }
+        }
+        free(seen);
+    }
+
+    verify_result_t result = {VERIFY_OK, 0};
+    if (first_cell < cells)
+    {
+        verify_cells(grid, puzzle, n, first_cell, first_cell + 1, &result.problem);
+        result.where = first_cell;
+    }
+    else if (first_row < n)
+    {
+        result = (verify_result_t){VERIFY_ROW, first_row};
+    }
+    else if (first_column < n)
+    {
+        result = (verify_result_t){VERIFY_COLUMN, first_column};
+    }
+    else if (first_box < n)
+    {
+        result = (verify_result_t){VERIFY_BOX, first_box};
+    }
+    return result;
+}
+
+// Describe result for a grid of n cells a side
+static void verify_describe(char *text, size_t size, verify_result_t result, const int *grid, const int *puzzle, int n,
+                            int block)
+{
+    int row = n ? result.where / n : 0, col = n ? result.where % n : 0;
+    switch (result.problem)
+    {
+    case VERIFY_EMPTY:
+        snprintf(text, size, "cell (%d, %d) is empty", row, col);
+        break;
+    case VERIFY_RANGE:
+        snprintf(text, size, "cell (%d, %d) holds %d, not a number from 1 to %d", row, col, grid[result.where], n);
+        break;
+    case VERIFY_GIVEN:
+        snprintf(text, size, "cell (%d, %d) holds %d but the puzzle gives %d", row, col, grid[result.where],
+                 puzzle[result.where]);
+        break;
+    case VERIFY_ROW:
+        snprintf(text, size, "row %ld repeats a number", result.where);
+        break;
+    case VERIFY_COLUMN:
+        snprintf(text, size, "column %ld repeats a number", result.where);
+        break;
+    case VERIFY_BOX:
+        snprintf(text, size, "box starting at (%ld, %ld) repeats a number", result.where / block * block,
+                 result.where % block * block);
+        break;
+    case VERIFY_NOT_GRID:
+        snprintf(text, size, "not a grid of the batch's size");
+        break;
+    default:
+        snprintf(text, size, "valid");
+    }
+}
+
+// Read the numbers of a text grid. Returns them (free when done) and sets
+// *grid_size and *block_size, or prints what is wrong and returns NULL.
+static int *verify_read_text_grid(const char *data, size_t size, const char *filename, int *grid_size,
+                                  int *block_size)
+{
+    puzzle_scanner_t scanner = {data, data + size};
+    size_t count = 0, capacity = 1024;
+    int *numbers = malloc(capacity * sizeof(int));
+    long v;
+    while (numbers && (v = scan_number(&scanner)) >= 0)
+    {
+        if (count == capacity)
+        {
+            capacity *= 2;
+            int *grown = realloc(numbers, capacity * sizeof(int));
+            if (!grown)
+            {
+                free(numbers);
+            }
+            numbers = grown;
+        }
+        if (numbers)
+        {
+            numbers[count++] = v > INT_MAX ? INT_MAX : (int)v;
+        }
+    }
+    if (!numbers)
+    {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+    if (v == -2)
+    {
+        fprintf(stderr, "Error in %s: only numbers and whitespace may follow.\n", filename);
+        free(numbers);
+        return NULL;
+    }
+
+    // n * n numbers, or n and then n * n numbers as in a puzzle file
+    size_t skip = 0, n = (size_t)sqrt((double)count);
+    while (n * n > count)
+    {
+        n--;
+    }
+    while ((n + 1) * (n + 1) <= count)
+    {
+        n++;
+    }
+    if (n * n != count && count > 0)
+    {
+        size_t m = (size_t)numbers[0];
+        if (m * m == count - 1)
+        {
+            skip = 1;
+            n = m;
+        }
+    }
+    size_t block = (size_t)sqrt((double)n);
+    while (block * block < n)
+    {
+        block++;
+    }
+    if (n == 0 || n * n != count - skip || block * block != n || n > MAX_LOADER_SIZE)
+    {
+        fprintf(stderr, "Error in %s: %zu numbers are not an n x n grid with n a perfect square.\n", filename,
+                count);
+        free(numbers);
+        return NULL;
+    }
+    memmove(numbers, numbers + skip, n * n * sizeof(int));
+    *grid_size = n;
+    *block_size = block;
+    return numbers;
+}
+
+static int verify_text_grid(const batch_reader_t *reader, const char *puzzle_file, long index)
+{
+    int n, block;
+    int *grid = verify_read_text_grid(reader->data, reader->size, reader->filename, &n, &block);
+    if (!grid)
+    {
+        return 1;
+    }
+    int *puzzle = NULL;
+    if (puzzle_file)
+    {
+        int pn, pblock;
+        puzzle = load_puzzle(puzzle_file, index, &pn, &pblock);
+        if (!puzzle)
+        {
+            free(grid);
+            return 1;
+        }
+        if (pn != n)
+        {
+            fprintf(stderr, "Error: the puzzle is %dx%d but the solution is %dx%d.\n", pn, pn, n, n);
+            free(grid);
+            free(puzzle);
+            return 1;
+        }
+    }
+
+    double start = batch_now();
+    verify_result_t result = verify_grid_parallel(grid, puzzle, n, block);
+    double elapsed = batch_now() - start;
+
+    if (result.problem == VERIFY_OK)
+    {
+        printf("The %dx%d sudoku grid is valid%s.\n", n, n, puzzle ? " and keeps the givens of the puzzle" : "");
+    }
+    else
+    {
+        char text[256];
+        verify_describe(text, sizeof(text), result, grid, puzzle, n, block);
+        printf("The %dx%d sudoku grid is not valid: %s.\n", n, n, text);
+    }
+    printf("Checked in %.3f ms on %d thread%s\n", elapsed * 1000, omp_get_max_threads(),
+           omp_get_max_threads() == 1 ? "" : "s");
+    free(grid);
+    free(puzzle);
+    return result.problem != VERIFY_OK;
+}
+
+// Check every record of solutions (a set or, with --batch, a line batch)
+// against its puzzle, from puzzles if it is open
+static int verify_batch(batch_reader_t *solutions, batch_reader_t *puzzles)
+{
+    int threads = omp_get_max_threads();
+    size_t cells = batch_max_cells(solutions);
+    if (puzzles && batch_max_cells(puzzles) > cells)
+    {
+        cells = batch_max_cells(puzzles);
+    }
+    int *grids = malloc(VERIFY_CHUNK * cells * sizeof(int));
+    int *givens = malloc(VERIFY_CHUNK * cells * sizeof(int));
+    int *has_givens = malloc(VERIFY_CHUNK * sizeof(int));
+    verify_result_t *results = malloc(VERIFY_CHUNK * sizeof(verify_result_t));
+    if (!grids || !givens || !has_givens || !results)
+    {
+        perror("Memory allocation failed");
+        exit(1);
+    }
+
+    long total = 0, counts[VERIFY_PROBLEMS] = {0}, reported = 0;
+    int mismatch = 0;
+    double start = batch_now();
+    for (;;)
+    {
+        // Read a chunk: line batches one line after another, sets are
+        // unpacked by the threads below straight from the mapping
+        long size = 0;
+        while (size < VERIFY_CHUNK)
+        {
+            int *grid = &grids[size * cells], *given = &givens[size * cells];
+            int status = 1;
+            if (solutions->is_set)
+            {
+                if (solutions->next_record >= solutions->set.count)
+                {
+                    break;
+                }
+                solutions->next_record++;
+                has_givens[size] = solutions->set.has_solutions;
+            }
+            else
+            {
+                status = batch_next(solutions, grid);
+                if (status == 0)
+                {
+                    break;
+                }
+                // "puzzle,solution": check the solution against its puzzle
+                const char *comma = status > 0 ? memchr(solutions->line, ',', solutions->line_len) : NULL;
+                has_givens[size] = 0;
+                if (comma && !puzzles)
+                {
+                    batch_reader_t field = *solutions;
+                    field.line = comma + 1;
+                    field.line_len = solutions->line_len - (comma + 1 - solutions->line);
+                    memcpy(given, grid, cells * sizeof(int));
+                    status = batch_parse_line(&field, grid) ? 1 : -1;
+                    has_givens[size] = 1;
+                }
+            }
+            if (puzzles)
+            {
+                int puzzle_status = puzzles->is_set ? (puzzles->next_record < puzzles->set.count ? 2 : 0)
+                                                    : batch_next(puzzles, given);
+                if (puzzle_status == 2)
+                {
+                    puzzles->next_record++; // unpacked below
+                }
+                if (puzzle_status == 0)
+                {
+                    mismatch = 1;
+                }
+                if (puzzle_status < 0)
+                {
+                    status = -1; // the puzzle line is not a grid
+                }
+                has_givens[size] = puzzle_status;
+            }
+            results[size].problem = status < 0 ? VERIFY_NOT_GRID : VERIFY_OK;
+            size++;
+        }
+        if (size == 0)
+        {
+            break;
+        }
+
+        int n = solutions->grid_size, block = solutions->block_size;
+        if (puzzles && puzzles->grid_size != n && puzzles->grid_size != 0)
+        {
+            fprintf(stderr, "Error: the puzzles are %dx%d but the solutions are %dx%d.\n", puzzles->grid_size,
+                    puzzles->grid_size, n, n);
+            return 1;
+        }
+        size_t words = (n + 63) / 64;
+#pragma omp parallel
+        {
+            uint64_t *seen = malloc(64 * words * sizeof(uint64_t));
+            if (!seen)
+            {
+                perror("Memory allocation failed");
+                exit(1);
+            }
+#pragma omp for schedule(dynamic, 64)
+            for (long k = 0; k < size; k++)
+            {
+                int *grid = &grids[k * cells], *given = &givens[k * cells];
+                long record = total + k;
+                if (solutions->is_set)
+                {
+                    puzzle_set_get(&solutions->set, record, solutions->set.has_solutions, grid);
+                    if (solutions->set.has_solutions && !puzzles)
+                    {
+                        puzzle_set_get(&solutions->set, record, 0, given);
+                    }
+                }
+                if (puzzles && puzzles->is_set && has_givens[k] == 2)
+                {
+                    puzzle_set_get(&puzzles->set, record, 0, given);
+                }
+                if (results[k].problem == VERIFY_OK)
+                {
+                    results[k] = verify_grid(grid, has_givens[k] > 0 ? given : NULL, n, block, seen, words);
+                }
+            }
+            free(seen);
+        }
+
+        for (long k = 0; k < size; k++)
+        {
+            counts[results[k].problem]++;
+            if (results[k].problem != VERIFY_OK && reported++ < VERIFY_MAX_REPORTS)
+            {
+                char text[256];
+                verify_describe(text, sizeof(text), results[k], &grids[k * cells], &givens[k * cells], n, block);
+                printf("Record %ld: %s.\n", total + k, text);
+            }
+        }
+        total += size;
+    }
+    double elapsed = batch_now() - start;
+
+    if (puzzles && (mismatch || (puzzles->is_set ? puzzles->next_record < puzzles->set.count
+                                                 : batch_next(puzzles, givens) != 0)))
+    {
+        printf("Warning: %s and %s do not hold the same number of puzzles.\n", puzzles->filename,
+               solutions->filename);
+    }
+    if (reported > VERIFY_MAX_REPORTS)
+    {
+        printf("... and %ld more invalid records.\n", reported - VERIFY_MAX_REPORTS);
+    }
+    printf("%ld of %ld records are valid (%ld unsolved, %ld out of range, %ld against their givens, %ld repeat a "
+           "number, %ld not a grid), checked in %.3f ms on %d thread%s\n",
+           counts[VERIFY_OK], total, counts[VERIFY_EMPTY], counts[VERIFY_RANGE], counts[VERIFY_GIVEN],
+           counts[VERIFY_ROW] + counts[VERIFY_COLUMN] + counts[VERIFY_BOX], counts[VERIFY_NOT_GRID],
+           elapsed * 1000, threads, threads == 1 ? "" : "s");
+
+    free(grids);
+    free(givens);
+    free(has_givens);
+    free(results);
+    return counts[VERIFY_OK] != total || mismatch;
+}
+
+int main(int argc, char *argv[])
+{
+    int batch = 0;
+    const char *puzzle_file = NULL, *solution_file = NULL;
+    long index = 0;
+    int usage = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--batch") == 0)
+        {
+            batch = 1;
+        }
+        else if (strncmp(argv[i], "--puzzle=", 9) == 0 && argv[i][9] != '\0')
+        {
+            puzzle_file = argv[i] + 9;
+        }
+        else if (strncmp(argv[i], "--index=", 8) == 0)
+        {
+            index = atol(argv[i] + 8);
+        }
+        else if (argv[i][0] != '-' && !solution_file)
+        {
+            solution_file = argv[i];
+        }
+        else
+        {
+            usage = 1;
+        }
+    }
+    if (usage || !solution_file)
+    {
+        fprintf(stderr, "Usage: %s [--puzzle=puzzle_file [--index=K]] <solution_file>\n", argv[0]);
+        fprintf(stderr, "       %s [--batch] [--puzzle=batch_file] <solution_batch>\n", argv[0]);
+        return 1;
+    }
+
+    batch_reader_t solutions;
+    if (!batch_open(&solutions, solution_file))
+    {
+        return 1;
+    }
+    int status;
+    if (!solutions.is_set && !batch)
+    {
+        status = verify_text_grid(&solutions, puzzle_file, index);
+    }
+    else
+    {
+        batch_reader_t puzzles;
+        if (puzzle_file && !batch_open(&puzzles, puzzle_file))
+        {
+            batch_close(&solutions);
+            return 1;
+        }
+        status = verify_batch(&solutions, puzzle_file ? &puzzles : NULL);
+        if (puzzle_file)
+        {
+            batch_close(&puzzles);
+        }
+    }
+    batch_close(&solutions);
+    return status;
+}